@@ -34,6 +34,13 @@
 #include <pthread.h>
 #include <sched.h>
 
+/*
+ * Wait while the lock is taken; "fails" counts the failed checks. A harness
+ * may define CF_WAIT before including this file.
+ */
+#ifndef CF_WAIT
+#define CF_WAIT(fails) ((void)(fails), sched_yield())  // or thrd_yield() with <threads.h>
+#endif
 
 typedef struct clh_mutex_node_ clh_mutex_node_t;
 
@@ -105,8 +112,9 @@ static inline void clh_mutex_lock(clh_mutex_t * self)
     // This thread's node is now in the queue, so wait until it is its turn
     char prev_islocked = atomic_load_explicit(&prev->succ_must_wait, memory_order_relaxed);
     if (prev_islocked) {
+        unsigned fails = 0;
         while (prev_islocked) {
-            sched_yield();  // Replace this with thrd_yield() if you use <threads.h>
+            CF_WAIT(fails);
             prev_islocked = atomic_load(&prev->succ_must_wait);
         }
     }
@@ -34,6 +34,14 @@
 #include <pthread.h>
 #include <sched.h>
 
+/*
+ * Wait while the lock is taken; "fails" counts the failed checks. A harness
+ * may define CF_WAIT before including this file.
+ */
+#ifndef CF_WAIT
+#define CF_WAIT(fails) ((void)(fails), sched_yield())  // or thrd_yield() with <threads.h>
+#endif
+
 typedef struct mpsc_mutex_node_ mpsc_mutex_node_t;
 
 struct mpsc_mutex_node_
@@ -95,8 +103,9 @@ static inline void mpsc_mutex_lock(mpsc_mutex_t * self)
 
     // This thread's node is now in the queue, so wait until it is its turn
     mpsc_mutex_node_t * lhead = atomic_load(&self->head);
+    unsigned fails = 0;
     while (lhead != prev) {
-        sched_yield();  // Replace this with thrd_yield() if you use <threads.h>
+        CF_WAIT(fails);
         lhead = atomic_load(&self->head);
     }
     // This thread has acquired the lock on the mutex
@@ -35,6 +35,14 @@
 #include <sched.h>
 #include <errno.h>
 
+/*
+ * Wait while the lock is taken; "fails" counts the failed checks. A harness
+ * may define CF_WAIT before including this file.
+ */
+#ifndef CF_WAIT
+#define CF_WAIT(fails) ((void)(fails), sched_yield())  // or thrd_yield() with <threads.h>
+#endif
+
 typedef struct
 {
     _Atomic long ingress;
@@ -70,8 +78,9 @@ static inline void ticket_mutex_destroy(ticket_mutex_t * self)
 static inline void ticket_mutex_lock(ticket_mutex_t * self)
 {
     long lingress = atomic_fetch_add(&self->ingress, 1);
+    unsigned fails = 0;
     while (lingress != atomic_load(&self->egress)) {
-        sched_yield();  // Replace this with thrd_yield() if you use <threads.h>
+        CF_WAIT(fails);
     }
     // This thread has acquired the lock on the mutex
 }
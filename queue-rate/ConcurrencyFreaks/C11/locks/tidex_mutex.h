@@ -34,6 +34,14 @@
 #include <pthread.h>
 #include <sched.h>
 
+/*
+ * Wait while the lock is taken; "fails" counts the failed checks. A harness
+ * may define CF_WAIT before including this file.
+ */
+#ifndef CF_WAIT
+#define CF_WAIT(fails) ((void)(fails), sched_yield())  // or thrd_yield() with <threads.h>
+#endif
+
 #define INVALID_TID  0
 #define MAX_SPIN (1 << 10)
 
@@ -88,6 +96,7 @@ static inline void tidex_mutex_lock(tidex_mutex_t * self)
     long long mytid = (long long)pthread_self();
     if (atomic_load_explicit(&self->egress, memory_order_relaxed) == mytid) mytid = -mytid;
     long long prevtid = atomic_exchange(&self->ingress, mytid);
+    unsigned fails = 0;
     while (atomic_load(&self->egress) != prevtid) {
         // Spin for a while and then yield
         for (int k = MAX_SPIN; k > 0; k--) {
@@ -97,7 +106,7 @@ static inline void tidex_mutex_lock(tidex_mutex_t * self)
                 return;
             }
         }
-        sched_yield();  // Replace this with thrd_yield() if you use <threads.h>
+        CF_WAIT(fails);
     }
     // Lock has been acquired
     self->nextEgress = mytid;
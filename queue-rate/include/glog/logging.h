@@ -0,0 +1,45 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __GLOG_LOGGING_H__
+#define __GLOG_LOGGING_H__
+
+/* Just enough of glog for folly/experimental/EventCount.h, which only */
+/* uses DCHECK_NE, and folly/MPMCPipeline.h, whose tickets CHECK that  */
+/* they are used exactly once.  glog itself is not vendored.           */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DCHECK_NE(a, b) assert((a) != (b))
+
+namespace glog_shim {
+
+/* Aborts at the end of the statement if the condition failed; the */
+/* message streamed into it is dropped                             */
+struct check_t {
+    bool        ok;
+    const char *cond;
+    const char *file;
+    int         line;
+
+    check_t(bool c, const char *s, const char *f, int l)
+        : ok(c), cond(s), file(f), line(l) { }
+
+    ~check_t()
+    {
+        if(!ok) {
+            fprintf(stderr, "%s:%d: Check failed: %s\n", file, line, cond);
+            abort();
+        }
+    }
+
+    template<class T>
+    check_t &operator<<(const T &) { return *this; }
+};
+
+}
+
+#define CHECK(c)        glog_shim::check_t(!!(c), #c, __FILE__, __LINE__)
+#define CHECK_EQ(a, b)  CHECK((a) == (b))
+#define CHECK_GT(a, b)  CHECK((a) > (b))
+
+#endif /* __GLOG_LOGGING_H__ */
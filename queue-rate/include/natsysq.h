@@ -25,6 +25,22 @@
 #include <immintrin.h>
 #include <algorithm>
 
+/*
+ * Wait in the full and empty ring loops.  A harness may define it before
+ * including this file; @fails counts the consecutive failed checks.
+ */
+#ifndef NATSYS_WAIT
+#define NATSYS_WAIT(fails)	((void)(fails), _mm_pause())
+#endif
+
+/*
+ * Count an event of the queue (deq_races, a lost CAS on tail_); a
+ * harness may define it to collect them.
+ */
+#ifndef NATSYS_STAT
+#define NATSYS_STAT(event)	((void)0)
+#endif
+
 static size_t __thread __thr_id;
 
 /**
@@ -113,6 +129,7 @@ public:
 		 * We do not know when a consumer uses the pop()'ed pointer,
 		 * se we can not overwrite it and have to wait the lowest tail.
 		 */
+		unsigned fails = 0;
 		while (__builtin_expect(thr_pos().head >= last_tail_ + Q_SIZE, 0))
 		{
 			auto min = tail_;
@@ -131,7 +148,7 @@ public:
 
 			if (thr_pos().head < last_tail_ + Q_SIZE)
 				break;
-			_mm_pause();
+			NATSYS_WAIT(fails);
 		}
 
 		ptr_array_[thr_pos().head & Q_MASK] = ptr;
@@ -140,6 +157,49 @@ public:
 		thr_pos().head = ULONG_MAX;
 	}
 
+	/**
+	 * Batched push: reserve @n consecutive slots with a single
+	 * fetch-and-add and fill them.  @n must not exceed Q_SIZE.
+	 * See comments for push().
+	 */
+	void
+	push_bulk(T **ptrs, size_t n)
+	{
+		thr_pos().head = head_;
+		thr_pos().head = __sync_fetch_and_add(&head_, n);
+
+		unsigned fails = 0;
+
+		// Wait until the last reserved slot is free.
+		while (__builtin_expect(thr_pos().head + n - 1
+					>= last_tail_ + Q_SIZE, 0))
+		{
+			auto min = tail_;
+
+			// Update the last_tail_.
+			for (size_t i = 0; i < n_consumers_; ++i) {
+				auto tmp_t = thr_p_[i].tail;
+
+				// Force compiler to use tmp_h exactly once.
+				asm volatile("" ::: "memory");
+
+				if (tmp_t < min)
+					min = tmp_t;
+			}
+			last_tail_ = min;
+
+			if (thr_pos().head + n - 1 < last_tail_ + Q_SIZE)
+				break;
+			NATSYS_WAIT(fails);
+		}
+
+		for (size_t i = 0; i < n; ++i)
+			ptr_array_[(thr_pos().head + i) & Q_MASK] = ptrs[i];
+
+		// Allow consumers eat the items.
+		thr_pos().head = ULONG_MAX;
+	}
+
 	T *
 	pop()
 	{
@@ -160,6 +220,7 @@ public:
 		 * last_head_ guaraties that no any consumer eats the item
 		 * before producer reserved the position writes to it.
 		 */
+		unsigned fails = 0;
 		while (__builtin_expect(thr_pos().tail >= last_head_, 0))
 		{
 			auto min = head_;
@@ -178,7 +239,7 @@ public:
 
 			if (thr_pos().tail < last_head_)
 				break;
-			_mm_pause();
+			NATSYS_WAIT(fails);
 		}
 
 		T *ret = ptr_array_[thr_pos().tail & Q_MASK];
@@ -187,6 +248,66 @@ public:
 		return ret;
 	}
 
+	/**
+	 * Non-blocking batched pop: claim up to @n consecutive slots
+	 * which producers have already filled and copy them to @out.
+	 *
+	 * pop() reserves its slot with fetch-and-add and then waits for a
+	 * producer to fill it.  Here the claim is a CAS on tail_ bounded
+	 * by last_head_, so a consumer never reserves an empty slot and
+	 * one locked instruction covers the whole batch.
+	 *
+	 * @return the number of pointers stored to @out.
+	 */
+	size_t
+	pop_bulk(T **out, size_t n)
+	{
+		unsigned long tail, avail;
+
+		do {
+			/*
+			 * Publish the position before claiming it, so that
+			 * push() can not compute last_tail_ beyond it.
+			 * See comments for pop().
+			 */
+			tail = tail_;
+			thr_pos().tail = tail;
+
+			if (tail >= last_head_) {
+				auto min = head_;
+
+				// Update the last_head_.
+				for (size_t i = 0; i < n_producers_; ++i) {
+					auto tmp_h = thr_p_[i].head;
+
+					// Force compiler to use tmp_h exactly once.
+					asm volatile("" ::: "memory");
+
+					if (tmp_h < min)
+						min = tmp_h;
+				}
+				last_head_ = min;
+			}
+
+			avail = last_head_ > tail ? last_head_ - tail : 0;
+			if (!avail) {
+				thr_pos().tail = ULONG_MAX;
+				return 0;
+			}
+			if (avail > n)
+				avail = n;
+		} while (!__sync_bool_compare_and_swap(&tail_, tail,
+						       tail + avail) &&
+			 (NATSYS_STAT(deq_races), 1));
+
+		for (size_t i = 0; i < avail; ++i)
+			out[i] = ptr_array_[(tail + i) & Q_MASK];
+
+		// Allow producers rewrite the slots.
+		thr_pos().tail = ULONG_MAX;
+		return avail;
+	}
+
 private:
 	/*
 	 * The most hot members are cacheline aligned to avoid
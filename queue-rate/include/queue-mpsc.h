@@ -26,6 +26,12 @@
 
 #include <atomic>
 
+// Count an event of the queue (enq_races, a lost CAS on the pushlist);
+// a harness may define it to collect them.
+#ifndef QUEUE_MPSC_STAT
+#define QUEUE_MPSC_STAT(event) ((void)0)
+#endif
+
 namespace lockfree {
 
 // linked_item<T> is just an example of a type LT which can be passed as a
@@ -65,7 +71,22 @@ public:
         LT *old = pushlist.load(std::memory_order_relaxed);
         do {
             item->next = old;
-        } while (!pushlist.compare_exchange_weak(old, item, std::memory_order_release));
+        } while (!pushlist.compare_exchange_weak(old, item, std::memory_order_release) &&
+                 (QUEUE_MPSC_STAT(enq_races), true));
+    }
+
+    // Push a chain of items with a single CAS. The caller has already
+    // linked the chain newest first, like the pushlist itself:
+    // last->next->...->first, where first is the oldest item. Only
+    // first->next is written here, to splice the chain onto the rest of
+    // the pushlist.
+    inline void push_bulk(LT* first, LT* last)
+    {
+        LT *old = pushlist.load(std::memory_order_relaxed);
+        do {
+            first->next = old;
+        } while (!pushlist.compare_exchange_weak(old, last, std::memory_order_release) &&
+                 (QUEUE_MPSC_STAT(enq_races), true));
     }
 
     inline LT* pop()
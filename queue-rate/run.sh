@@ -34,21 +34,22 @@ case $2 in
                lockrate_tidex  lockrate_tidex_nps"
         ;;
     queue)
-        TESTS="qrate_cloudius qrate_folly qrate_mc
-               qrate_natsys qrate_vyukov"
+        # <binary>:<queue> pairs, the queue is selected with -q
+        TESTS="qrate:cloudius qrate:folly qrate:mc
+               qrate:natsys qrate:vyukov"
         ;;
     alloc)
-        TESTS="alloc_rate_boost_malloc   alloc_rate_cloudius_malloc
-               alloc_rate_folly_malloc   alloc_rate_mc_malloc
-               alloc_rate_natsys_malloc  alloc_rate_tbb_malloc
-               alloc_rate_vyukov_malloc  alloc_rate_mc_tbbmalloc
-               alloc_rate_vyukov_tbbmalloc"
-        TESTS="${TESTS} alloc_rate_boost_li alloc_rate_cloudius_li
-               alloc_rate_folly_li alloc_rate_mc_li
-               alloc_rate_natsys_li alloc_rate_tbb_li
-               alloc_rate_vyukov_li"
-        TESTS="${TESTS} alloc_rate_mc_jemalloc alloc_rate_vyukov_jemalloc"
-        TESTS="${TESTS} alloc_rate_mc_ssmalloc alloc_rate_vyukov_ssmalloc"
+        TESTS="alloc_rate_malloc:boost   alloc_rate_malloc:cloudius
+               alloc_rate_malloc:folly   alloc_rate_malloc:mc
+               alloc_rate_malloc:natsys  alloc_rate_malloc:tbb
+               alloc_rate_malloc:vyukov  alloc_rate_tbbmalloc:mc
+               alloc_rate_tbbmalloc:vyukov"
+        TESTS="${TESTS} alloc_rate_li:boost alloc_rate_li:cloudius
+               alloc_rate_li:folly alloc_rate_li:mc
+               alloc_rate_li:natsys alloc_rate_li:tbb
+               alloc_rate_li:vyukov"
+        TESTS="${TESTS} alloc_rate_jemalloc:mc alloc_rate_jemalloc:vyukov"
+        TESTS="${TESTS} alloc_rate_ssmalloc:mc alloc_rate_ssmalloc:vyukov"
 
         ;;
     * )
@@ -58,34 +59,135 @@ case $2 in
 esac
 
 for test in $TESTS; do
-    if [ ! -f ${test} ]; then
-        die "File $test does not exist"
+    if [ ! -f ${test%%:*} ]; then
+        die "File ${test%%:*} does not exist"
     fi
 done
 
-TIMEOUT=10
+# qrate runs for a fixed DURATION (seconds) instead of a fixed message
+# count, so contended runs still report a rate instead of timing out.
+# It sweeps every p/c split in one process (--sweep), REPEATS times per
+# point, and stops a stuck run itself after TIMEOUT; medians and 95%
+# confidence intervals go to <output>.sweep.
+# The other drivers keep the fixed count and the TIMEOUT kill.
+DURATION=${DURATION:-2}
+TIMEOUT=$((DURATION+10))
+REPEATS=${REPEATS:-1}
+# What qrate consumers do on an empty queue, see --wait
+WAIT=${WAIT:-spin}
+# How qrate consumers share queues, see --topology; pairs is the only
+# one the SPSC queues (qrate:pcq, qrate:spsc) run in, and takes no -r
+TOPOLOGY=${TOPOLOGY:-sharded}
+RANDOMIZE=-r
+if [ "${TOPOLOGY}" = "pairs" ]; then
+    RANDOMIZE=
+fi
 PWD=$(pwd)
 messages=10000000
+window=65536
 max_threads=$1
+# Producer batch sizes to sweep (queue/alloc buckets only), e.g.
+#     BATCHES="1 16 64 256" ./run.sh 16 queue
+BATCHES=${BATCHES:-1}
+# Thread placement policy for every driver, see --placement
+PLACEMENT=${PLACEMENT:-legacy}
+# What every driver does between failed polls and lock attempts, see --backoff
+BACKOFF=${BACKOFF:-default}
+# Payload bytes per qrate message, see --payload; BY_VALUE=1 copies them
+# through the queue (--by-value) instead of passing pointers
+PAYLOAD=${PAYLOAD:-0}
+BY_VALUE=${BY_VALUE:-0}
+# Per message work of qrate consumers, see --work
+WORK=${WORK:-none}
+# Nodes per qrate queue, see -Q; 0 leaves the queues unbounded
+CAPACITY=${CAPACITY:-0}
+# PERF=1 counts hardware events in qrate runs (--perf) into <output>.perf
+PERF=${PERF:-0}
+QRATE_PERF=
+if [ ${PERF} -ne 0 ]; then
+    QRATE_PERF="--perf"
+fi
+# Seed for every driver's random choices, see --seed; empty draws a new one
+SEED=${SEED:-}
+SEED_FLAG=
+if [ -n "${SEED}" ]; then
+    SEED_FLAG="--seed ${SEED}"
+fi
+QRATE_PAYLOAD=
+if [ ${PAYLOAD} -gt 0 ]; then
+    QRATE_PAYLOAD="--payload ${PAYLOAD}"
+    if [ ${BY_VALUE} -ne 0 ]; then
+        QRATE_PAYLOAD="${QRATE_PAYLOAD} --by-value"
+    fi
+fi
 let range=${max_threads}-1
 for test in $TESTS; do
-    rm -f ${test}.out
+  for batch in ${BATCHES}; do
+    binary=${test%%:*}
+    queue=
+    output=${binary}
+    if [ "${binary}" != "${test}" ]; then
+        queue="-q ${test#*:} -b ${batch}"
+        output=${binary}_${test#*:}
+        if [ ${batch} -gt 1 ]; then
+            output=${output}_b${batch}
+        fi
+    fi
+    if [ "${PLACEMENT}" != "legacy" ]; then
+        output=${output}_${PLACEMENT}
+    fi
+    if [ "${binary}" = "qrate" ] && [ "${WAIT}" != "spin" ]; then
+        output=${output}_${WAIT}
+    fi
+    if [ "${binary}" = "qrate" ] && [ "${TOPOLOGY}" != "sharded" ]; then
+        output=${output}_${TOPOLOGY}
+    fi
+    if [ "${BACKOFF}" != "default" ]; then
+        output=${output}_${BACKOFF}
+    fi
+    if [ "${binary}" = "qrate" ] && [ ${CAPACITY} -gt 0 ]; then
+        output=${output}_Q${CAPACITY}
+    fi
+    if [ "${binary}" = "qrate" ] && [ "${WORK}" != "none" ]; then
+        output=${output}_$(echo ${WORK} | tr ':' '_')
+    fi
+    if [ "${binary}" = "qrate" ] && [ ${PAYLOAD} -gt 0 ]; then
+        output=${output}_${PAYLOAD}B
+        if [ ${BY_VALUE} -ne 0 ]; then
+            output=${output}_value
+        fi
+    fi
+    rm -f ${output}.out
+    if [ "${binary}" = "qrate" ]; then
+        cmd="./${binary} ${queue} --sweep ${max_threads} -d ${DURATION} -m $((window*max_threads)) ${RANDOMIZE} --placement ${PLACEMENT} --repeat ${REPEATS} --timeout ${TIMEOUT} --wait ${WAIT} --topology ${TOPOLOGY} --backoff ${BACKOFF} --work ${WORK} -Q ${CAPACITY} ${QRATE_PAYLOAD} ${QRATE_PERF} ${SEED_FLAG}"
+        echo "$cmd"
+        rm -f ${output}.sweep ${output}.perf
+        eval ${cmd} | grep "DATAOUT\|SWEEPOUT\|PERFOUT" |
+            while read line; do
+                case "${line}" in
+                    DATAOUT*)  echo "${line}" | tee -a ${output}.out ;;
+                    SWEEPOUT*) echo "${line}" >> ${output}.sweep ;;
+                    PERFOUT*)  echo "${line}" >> ${output}.perf ;;
+                esac
+            done
+        continue
+    fi
     for producers in $(seq 1 $range); do
         consumers=$(expr ${max_threads} - ${producers})
         if [ ${consumers} -le ${producers} ]; then
             let max_producers=$(expr ${max_threads} - ${consumers})
             for allproducers in $(seq ${consumers} ${max_producers}); do
                 let total=$(expr ${allproducers} + ${consumers})
-                cmd="./$test -p ${allproducers} -c ${consumers} -m ${messages} -r"
-                if [ -f ${test} ]; then
+                cmd="./${binary} ${queue} -p ${allproducers} -c ${consumers} -m ${messages} -r --placement ${PLACEMENT} --backoff ${BACKOFF} ${SEED_FLAG}"
+                if [ -f ${binary} ]; then
                     echo -n "$cmd : "
-                    ((eval ${cmd} || die "Error in test" 1>&2) | grep DATAOUT | tee -a ${test}.out) &
+                    ((eval ${cmd} || die "Error in test" 1>&2) | grep DATAOUT | tee -a ${output}.out) &
                     pid1=$!
                     (sleep ${TIMEOUT}; killtree ${pid1}; echo "KILLED pid ${pid1}";
-                     echo "DATAOUT ${allproducers} ${consumers} ${total} -1.0 -1.0" >> ${test}.out ) &
+                     echo "DATAOUT ${allproducers} ${consumers} ${total} -1.0 -1.0 ${batch}" >> ${output}.out ) &
                     pid2=$!
                 else
-                    die "Fatal:  cannot find file ${test}"
+                    die "Fatal:  cannot find file ${binary}"
                 fi
                 wait ${pid1}
                 killtree ${pid2} 2>/dev/null
@@ -93,5 +195,6 @@ for test in $TESTS; do
             done
         fi
     done
+  done
 done
 exit
@@ -5,26 +5,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <pthread.h>
 #include <stdint.h>
-#include <sys/time.h>
 #include <new>
+#include "timing.h"
+#include "placement.h"
+#include "results.h"
+#include "backoff.h"
+#include "perfctr.h"
+#include "rng.h"
 /* -------------------------------------------------------------------  */
 /* |Facebook Folly  | https://github.com/facebook/folly               | */
 /* |Moody Camel     | https://github.com/cameron314/concurrentqueue   | */
 /* |Cloudius        | https://github.com/cloudius-systems/osv         | */
 /* |Natsys Queue    | https://github.com/natsys/blog                  | */
 /* -------------------------------------------------------------------  */
-#define FOLLY_QUEUE        1
-#define MOODY_CAMEL_QUEUE  2
-#define CLOUDIUS_QUEUE     3
-#define NATSYS_QUEUE       4
-#define VYUKOV_QUEUE       5
-#define TBB_QUEUE          6
 #define BULK_DEQUEUE       524288
 
 #define MALLOC_ALLOC       1
 
+#ifndef ALLOC_NAME
+#define ALLOC_NAME         "unknown"
+#endif
+
 //#define DEBUG
 extern "C" {
 extern int printme(char *instr);
@@ -50,6 +54,10 @@ typedef struct thread_data_t {
     int          total_messages;
     int          randomize;
     int          extra_alloc;
+    int          batch;
+    uint64_t     waits;         /* failed attempts that went to backoff() */
+    perf_counters_t perf;       /* --perf hardware counters, timed region */
+    phase_t      phase;
 } thread_data_t;
 typedef struct work_node_t {
     work_node_t *next;
@@ -67,25 +75,10 @@ pthread_barrier_t g_barrier;
 hwloc_topology_t  g_topo;
 int               g_done;
 int               g_random_fd;
+double            g_tsc_per_nsec;
 
 
-#if  QUEUE_METHOD==FOLLY_QUEUE
-#include "folly_q.h"
-#elif QUEUE_METHOD==MOODY_CAMEL_QUEUE
-#include "moody_camel_q.h"
-#elif QUEUE_METHOD==CLOUDIUS_QUEUE
-#include "cloudius_q.h"
-#elif QUEUE_METHOD==NATSYS_QUEUE
-#include "natsys_q.h"
-#elif QUEUE_METHOD==VYUKOV_QUEUE
-#include "vyukov_q.h"
-#elif QUEUE_METHOD==TBB_QUEUE
-#include "tbb_q.h"
-#elif QUEUE_METHOD==BOOST_QUEUE
-#include "boost_q.h"
-#else
-#error "A valid queue method has not been chosen"
-#endif
+#include "queues.h"
 
 #if ALLOC_METHOD==MALLOC_ALLOC
 
@@ -110,7 +103,9 @@ static inline void extra_free(void* freeme) {
 }
 
 #elif ALLOC_METHOD==TBB_ALLOC
+#ifndef __TBB_WEAK_SYMBOLS_PRESENT /* tbb_q.h may have pulled in tbb_config.h */
 #define __TBB_WEAK_SYMBOLS_PRESENT 1
+#endif
 #include "concurrentqueue/benchmarks/tbb/dynamic_link.h"
 #include "concurrentqueue/benchmarks/tbb/cache_aligned_allocator.h"
 tbb::cache_aligned_allocator<work_node_t> g_alloc;
@@ -142,6 +137,7 @@ static inline void extra_free(void** freeme) {
 
 
 
+template<class A>
 void *do_produce(void *clientdata)
 {
     int i;
@@ -167,42 +163,80 @@ void *do_produce(void *clientdata)
             printme(str1);
     }
     int         *permute   = (int *)malloc(sizeof(int) *tdata->nconsumers);
+    uint64_t     rng       = rng_seed(g_seed, 0, me);
 
     for(i=0; i<tdata->nconsumers; i++)
         permute[i]=i;
 
     for(i=0; i<tdata->nconsumers; i++) {
         int swapme, index;
-        index=urandom(g_random_fd)%tdata->nconsumers;
+        index=rng_below(&rng, tdata->nconsumers);
         swapme = permute[i];
         permute[i] = permute[index];
         permute[index] = swapme;
     }
 
-    producer_token_t prodTok(Q[q]);
+    A::thread_init(me);
+    typename A::producer_token_t prodTok(*A::Q[q]);
+    perf_open(&tdata->perf);
     /* Start Timer Barrier */
     pthread_barrier_wait(&g_barrier);
     pthread_barrier_wait(&g_barrier);
 
     /* End Timer Barrier */
     pthread_barrier_wait(&g_barrier);
+    perf_start(&tdata->perf);
+    uint64_t start = rdtsc();
     DEBUG_PRINT("Thread %d beginning, using q=%d\n",me,q);
 
-    for(i = tdata->messages_per_thread-1; i >= 0; --i) {
-        work_node_t *n     = work_node_alloc(me,i+1);
-        if(tdata->randomize) {
-            if(tdata->extra_alloc)
-                n->extra_alloc_data=extra_alloc();
-            q = (q+1) % tdata->nconsumers;
-            enqueue(Q[permute[q]],*n);
-        } else {
-            if(tdata->extra_alloc)
-                n->extra_alloc_data=extra_alloc();
+    if(tdata->batch > 1) {
+        work_node_t **batch = (work_node_t **)malloc(sizeof(work_node_t *) * tdata->batch);
 
-            enqueue_tok(Q[q],prodTok, *n);
+        for(i = tdata->messages_per_thread-1; i >= 0; i -= tdata->batch) {
+            int k, nb = (i+1 < tdata->batch) ? i+1 : tdata->batch;
+
+            for(k = 0; k < nb; k++) {
+                batch[k] = work_node_alloc(me,i-k+1);
+
+                if(tdata->extra_alloc)
+                    batch[k]->extra_alloc_data=extra_alloc();
+            }
+
+            if(tdata->randomize) {
+                q = (q+1) % tdata->nconsumers;
+                A::enqueue_bulk(*A::Q[permute[q]], batch, nb);
+            } else
+                A::enqueue_bulk_tok(*A::Q[q], prodTok, batch, nb);
+        }
+
+        free(batch);
+    } else {
+        for(i = tdata->messages_per_thread-1; i >= 0; --i) {
+            work_node_t *n     = work_node_alloc(me,i+1);
+            if(tdata->randomize) {
+                if(tdata->extra_alloc)
+                    n->extra_alloc_data=extra_alloc();
+                q = (q+1) % tdata->nconsumers;
+                A::enqueue(*A::Q[permute[q]],*n);
+            } else {
+                if(tdata->extra_alloc)
+                    n->extra_alloc_data=extra_alloc();
+
+                A::enqueue_tok(*A::Q[q],prodTok, *n);
+            }
         }
     }
 
+    /* The producer never waits on an empty queue:  its whole loop, */
+    /* allocations included, is busy                               */
+    tdata->phase.start = start;
+    tdata->phase.stop  = rdtsc();
+    perf_stop(&tdata->perf);
+    tdata->phase.busy  = tdata->phase.stop - start;
+    tdata->phase.empty = 0;
+    tdata->phase.msgs  = tdata->messages_per_thread;
+    tdata->waits       = t_backoff_waits;
+
     DEBUG_PRINT("Thread %d finished producing!\n", nodes[0].id);
     hwloc_bitmap_free(cpuset);
     free(str);
@@ -218,7 +252,7 @@ void *do_produce(void *clientdata)
 
         for(i=0; i<tdata->nconsumers; i++) {
             work_node_t *n     = work_node_alloc(me,0);
-            enqueue(Q[i],*n);
+            A::enqueue(*A::Q[i],*n);
         }
     }
 
@@ -233,17 +267,19 @@ void *do_produce(void *clientdata)
     return NULL;
 }
 
+template<class A>
 void *do_consume(void *clientdata)
 {
     char *str;
     char *str1;
-    struct timeval ti, tf;
     int            i,me;
     hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
     thread_data_t *tdata = (thread_data_t *)clientdata;
     double         calls=0.0, sum=0.0;
     me = tdata->index;
-    consumer_token_t consTok(Q[me]);
+    A::thread_init(me);
+    typename A::consumer_token_t consTok(*A::Q[me]);
+    perf_open(&tdata->perf);
 
     hwloc_bitmap_zero(cpuset);
     hwloc_get_cpubind(g_topo, cpuset, HWLOC_CPUBIND_THREAD);
@@ -267,10 +303,12 @@ void *do_consume(void *clientdata)
     /* Start timer Barrier */
     pthread_barrier_wait(&g_barrier);
     pthread_barrier_wait(&g_barrier);
-    gettimeofday(&ti, NULL);
 
     /* End Timer Barrier */
     pthread_barrier_wait(&g_barrier);
+    perf_start(&tdata->perf);
+    uint64_t start = rdtsc(), last = start, busy = 0, empty = 0, msgs = 0;
+    unsigned fails = 0;
     int done=0;
 
     while(!done) {
@@ -279,17 +317,23 @@ void *do_consume(void *clientdata)
         size_t result;
 
         if(tdata->nproducers==tdata->nconsumers)
-            result = try_dequeue_bulk_tok(Q[me],consTok,node[0],BULK_DEQUEUE);
+            result = A::try_dequeue_bulk_tok(*A::Q[me],consTok,node[0],BULK_DEQUEUE);
         else
-            result = try_dequeue_bulk(Q[me], node[0],BULK_DEQUEUE);
+            result = A::try_dequeue_bulk(*A::Q[me], node[0],BULK_DEQUEUE);
 
         sum+=result;
         calls++;
 
         if(result==0) {
+            uint64_t now = rdtsc();
+            empty += now - last;
+            last   = now;
+            backoff(BACKOFF_NONE, &fails);
             continue;
         }
 
+        fails = 0;
+
         for(i=0; i< result; i++) {
             DEBUG_PRINT("Consumer:  (tid=%d node data = %d\n",
                         node[i]->id, node[i]->data);
@@ -297,22 +341,33 @@ void *do_consume(void *clientdata)
             if(node[i]->data == 0) {
                 DEBUG_PRINT("Got 0 from node! assuming finished!\n");
                 done=1;
-            }
+            } else
+                msgs++;
             if(tdata->extra_alloc)
                 extra_free(&node[i]->extra_alloc_data);
             work_node_free(node[i]);
         }
+
+        /* A successful call is charged up to the end of its frees */
+        uint64_t now = rdtsc();
+        busy += now - last;
+        last  = now;
     }
 
     DEBUG_PRINT("Consumer finished!\n");
-    gettimeofday(&tf, NULL);
+    perf_stop(&tdata->perf);
+    tdata->phase.start = start;
+    tdata->phase.stop  = last;
+    tdata->phase.busy  = busy;
+    tdata->phase.empty = empty;
+    tdata->phase.msgs  = msgs;
+    tdata->waits       = t_backoff_waits;
     /* End of job barrier for timing */
     pthread_barrier_wait(&g_barrier);
 
     /* End of job barrier for printing */
     pthread_barrier_wait(&g_barrier);
-    long usec = ((tf.tv_sec - ti.tv_sec)*1000000L+tf.tv_usec) - ti.tv_usec;
-    double usecF       = (double) usec;
+    double usecF       = (last - start) / g_tsc_per_nsec / 1000.0;
     double n_producers = (double) tdata->nproducers/tdata->nconsumers;
     double n_msgs      = (double) tdata->messages_per_thread*n_producers;
     printf("Consumer %03d:  n_msgs=%f in %f usec n_producers handled=%f:  mmsgs/s=%f nmsg/call=%f\n",
@@ -324,17 +379,90 @@ void *do_consume(void *clientdata)
     return NULL;
 }
 
+static const queue_entry_t g_queues[] = {
+    QUEUE_LIST(QUEUE_ENTRY)
+};
+#define N_QUEUES ((int)(sizeof(g_queues)/sizeof(g_queues[0])))
+
 int main(int argc, char *argv[])
 {
-    struct timeval   ti, tf;
     pthread_attr_t   attr;
     cpu_set_t        cpus;
-    int              i, j, n, d, depth;
+    int              i, n, d, depth;
     hwloc_obj_t      obj;
-    int c, nproducers = 0, nconsumers=0, nmessages=0, randomize=0, extra_alloc=0;
-
-    while((c = getopt(argc, argv, "erp:c:m:")) != -1)
+    const queue_entry_t *queue = NULL;
+    int c, nproducers = 0, nconsumers=0, nmessages=0, randomize=0, extra_alloc=0, batch=1, seeded=0;
+    int              placement = PLACE_LEGACY;
+    const char      *json = NULL, *csv = NULL;
+
+    static struct option long_options[] = {
+        {"placement", required_argument, NULL, 'P'},
+        {"json",      required_argument, NULL, 'J'},
+        {"csv",       required_argument, NULL, 'C'},
+        {"backoff",   required_argument, NULL, 'B'},
+        {"perf",      no_argument,       NULL, 'F'},
+        {"perf-raw",  required_argument, NULL, 'H'},
+        {"seed",      required_argument, NULL, 'D'},
+        {NULL,        0,                 NULL, 0}
+    };
+
+    while((c = getopt_long(argc, argv, "erq:p:c:m:b:", long_options, NULL)) != -1)
         switch(c) {
+            case 'J':
+                json = optarg;
+                break;
+
+            case 'C':
+                csv = optarg;
+                break;
+
+            case 'F':
+                g_perf = 1;
+                break;
+
+            case 'D':
+                g_seed = strtoull(optarg, NULL, 0);
+                seeded = 1;
+                break;
+
+            case 'H':
+                g_perf     = 1;
+                g_perf_raw = strtoull(optarg, NULL, 16);
+                break;
+
+            case 'B':
+                g_backoff = backoff_lookup(optarg);
+
+                if(g_backoff < 0) {
+                    fprintf(stderr, "Unknown backoff `%s'.\n", optarg);
+                    backoff_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'P':
+                placement = placement_lookup(optarg);
+
+                if(placement < 0) {
+                    fprintf(stderr, "Unknown placement `%s'.\n", optarg);
+                    placement_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'q':
+                queue = queue_lookup(g_queues, N_QUEUES, optarg);
+
+                if(!queue) {
+                    fprintf(stderr, "Unknown queue `%s'.\n", optarg);
+                    queue_usage(stderr, g_queues, N_QUEUES);
+                    return 1;
+                }
+
+                break;
+
             case 'e':
                 extra_alloc = 1;
                 break;
@@ -353,6 +481,10 @@ int main(int argc, char *argv[])
                 nmessages = atoi(optarg);
                 break;
 
+            case 'b':
+                batch = atoi(optarg);
+                break;
+
             case '?':
                 if(optopt == 'p')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
@@ -360,6 +492,12 @@ int main(int argc, char *argv[])
                 if(optopt == 'c')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
 
+                if(optopt == 'b')
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+
+                if(optopt == 'q')
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+
                 if(optopt == 'm')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 else if(isprint(optopt))
@@ -376,23 +514,41 @@ int main(int argc, char *argv[])
         }
 
     if(nproducers < 1 || nconsumers < 1 || (nproducers < nconsumers) ||
-       nmessages < nconsumers) {
-        fprintf(stderr, "Usage:  -p <num> -c <num> -m with (p <= c) and (m >= c)\n");
+       nmessages < nconsumers || batch < 1 || !queue ||
+       (queue->spsc && (nproducers != 1 || nconsumers != 1))) {
+        fprintf(stderr, "Usage:  -q <queue> -p <num> -c <num> -m with (p <= c) and (m >= c)\n");
+        queue_usage(stderr, g_queues, N_QUEUES);
+        fprintf(stderr, "        -b <num> producers enqueue batches of num messages\n");
+        fprintf(stderr, "        the SPSC queues (pcq, spsc) need -p 1 -c 1\n");
+        fprintf(stderr, "        --json <file>, --csv <file> append a results record to file\n");
+        backoff_usage(stderr);
+        perf_usage(stderr);
+        fprintf(stderr, "        --seed <num> seed the -r queue order, to replay a run\n");
+        placement_usage(stderr);
         return 1;
     }
 
-    printf("Starting mpsc with %s queue P:%d C:%d NM:%d\n",
-           QUEUE_NAME,nproducers, nconsumers,nmessages);
+    printf("Starting mpsc with %s queue P:%d C:%d NM:%d B:%d\n",
+           queue->description,nproducers, nconsumers,nmessages,batch);
     pthread_t        producers[nproducers];
     pthread_t        consumers[nconsumers];
     thread_data_t    producer_data[nproducers];
     thread_data_t    consumer_data[nconsumers];
     int              messages_per_thread = nmessages/nproducers;
     int              total_messages      = messages_per_thread*nproducers;
-    Q = initQ(nconsumers, nproducers, nmessages);
+    queue->init(nconsumers);
+
+    for(i=0; i < nconsumers; i++)
+        queue->create(i, nconsumers, nproducers, nmessages);
     g_random_fd = urandom_init();
+
+    if(!seeded)
+        g_seed = urandom(g_random_fd);
+
+    printf("Seed %llu\n", (unsigned long long)g_seed);
     hwloc_topology_init(&g_topo);
     hwloc_topology_load(g_topo);
+    g_tsc_per_nsec = tsc_calibrate();
 
     depth=hwloc_topology_get_depth(g_topo);
 
@@ -413,9 +569,16 @@ int main(int argc, char *argv[])
     pthread_attr_init(&attr);
     pthread_barrier_init(&g_barrier, NULL, nproducers+nconsumers+1);
 
-    for(i=0,j=1; i < nproducers; i++) {
+    hwloc_obj_t      producer_obj[nproducers];
+    hwloc_obj_t      consumer_obj[nconsumers];
+    placement_map(g_topo, placement, nproducers, nconsumers,
+                  producer_obj, consumer_obj);
+    placement_print(stdout, g_topo, placement, nproducers, nconsumers,
+                    producer_obj, consumer_obj);
+
+    for(i=0; i < nproducers; i++) {
         CPU_ZERO(&cpus);
-        obj = hwloc_get_obj_by_type(g_topo, HWLOC_OBJ_CORE, j);
+        obj = producer_obj[i];
         hwloc_cpuset_to_glibc_sched_affinity(g_topo,obj->cpuset,
                                              &cpus,sizeof(cpus));
         pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
@@ -427,22 +590,20 @@ int main(int argc, char *argv[])
         producer_data[i].total_messages      = total_messages;
         producer_data[i].randomize           = randomize;
         producer_data[i].extra_alloc         = extra_alloc;
+        producer_data[i].batch               = batch;
 
-        int ret = pthread_create(producers + i, &attr, do_produce, (void *)&producer_data[i]);
+        int ret = pthread_create(producers + i, &attr, queue->produce, (void *)&producer_data[i]);
 
         if(ret != 0) {
             exit(1);
         } else {
             DEBUG_PRINT("Spawned producer thread %d\n", i);
         }
-
-        if(i<=(nconsumers-2)) j+=2;
-        else j+=1;
     }
 
-    for(i=0, j=0; i < nconsumers; i++,j+=2) {
+    for(i=0; i < nconsumers; i++) {
         CPU_ZERO(&cpus);
-        obj = hwloc_get_obj_by_type(g_topo, HWLOC_OBJ_CORE, j);
+        obj = consumer_obj[i];
         hwloc_cpuset_to_glibc_sched_affinity(g_topo,obj->cpuset,
                                              &cpus,sizeof(cpus));
         pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
@@ -455,8 +616,9 @@ int main(int argc, char *argv[])
         consumer_data[i].total_messages      = total_messages;
         consumer_data[i].randomize           = randomize;
         consumer_data[i].extra_alloc         = extra_alloc;
+        consumer_data[i].batch               = batch;
 
-        int ret = pthread_create(consumers+i, &attr, do_consume, (void *)&consumer_data[i]);
+        int ret = pthread_create(consumers+i, &attr, queue->consume, (void *)&consumer_data[i]);
 
         if(ret != 0) {
             exit(1);
@@ -472,14 +634,12 @@ int main(int argc, char *argv[])
     /* Start timer Barrier */
     pthread_barrier_wait(&g_barrier);
     pthread_barrier_wait(&g_barrier);
-    gettimeofday(&ti, NULL);
 
     /* End timer Barrier */
     pthread_barrier_wait(&g_barrier);
 
     /* End of job barrier for timing */
     pthread_barrier_wait(&g_barrier);
-    gettimeofday(&tf, NULL);
 
     /* End of job barrier for printing */
     pthread_barrier_wait(&g_barrier);
@@ -492,8 +652,20 @@ int main(int argc, char *argv[])
         pthread_join(consumers[i], NULL);
     }
 
-    long usec = ((tf.tv_sec - ti.tv_sec)*1000000L+tf.tv_usec) - ti.tv_usec;
-    double usecF       = (double) usec;
+    phase_summary_t phases;
+    phase_t         producer_phase[nproducers];
+    phase_t         consumer_phase[nconsumers];
+
+    for(i=0; i < nproducers; i++)
+        producer_phase[i] = producer_data[i].phase;
+
+    for(i=0; i < nconsumers; i++)
+        consumer_phase[i] = consumer_data[i].phase;
+
+    phase_summarize(&phases, producer_phase, nproducers,
+                    consumer_phase, nconsumers);
+
+    double usecF       = phases.window / g_tsc_per_nsec / 1000.0;
     double n_msgs      = (double) total_messages;
     double n_producers = (double) nproducers;
     printf("Time in microseconds: %f\n",usecF);
@@ -501,9 +673,88 @@ int main(int argc, char *argv[])
            n_msgs, n_producers, n_msgs/usecF,
            n_msgs/usecF/n_producers);
 
-    printf("DATAOUT %d %d %d %f %f\n",
+    printf("DATAOUT %d %d %d %f %f %d\n",
            nproducers,nconsumers,total_messages,
-           n_msgs/usecF,n_msgs/usecF/n_producers);
+           n_msgs/usecF,n_msgs/usecF/n_producers,batch);
+    phase_print(stdout, &phases, nproducers, nconsumers, total_messages,
+                g_tsc_per_nsec);
+
+    /* Failed polls and full ring checks per message, see qrate */
+    uint64_t prod_waits = 0, cons_waits = 0;
+
+    for(i=0; i < nproducers; i++)
+        prod_waits += producer_data[i].waits;
+
+    for(i=0; i < nconsumers; i++)
+        cons_waits += consumer_data[i].waits;
+
+    double prod_wpm = (double)prod_waits/total_messages;
+    double cons_wpm = (double)cons_waits/total_messages;
+    printf("Backoff %s: producer waits/msg=%.3f consumer waits/msg=%.3f\n",
+           backoff_name(g_backoff), prod_wpm, cons_wpm);
+    printf("BACKOFFOUT %d %d %d %f %f\n",
+           nproducers,nconsumers,total_messages,prod_wpm,cons_wpm);
+
+    /* --perf:  each role's counters, allocator included */
+    perf_counters_t prod_perf, cons_perf;
+
+    perf_sum_init(&prod_perf);
+    perf_sum_init(&cons_perf);
+
+    for(i=0; i < nproducers; i++)
+        perf_sum(&prod_perf, &producer_data[i].perf);
+
+    for(i=0; i < nconsumers; i++)
+        perf_sum(&cons_perf, &consumer_data[i].perf);
+
+    perf_print(stdout, "producer", nproducers, nconsumers, &prod_perf, total_messages);
+    perf_print(stdout, "consumer", nproducers, nconsumers, &cons_perf, total_messages);
+
+    if(json || csv) {
+        result_t *res = result_new("alloc_rate");
+        double    consumer_rate[nconsumers];
+        char      seed[24];
+
+        snprintf(seed, sizeof(seed), "%llu", (unsigned long long)g_seed);
+
+        for(i=0; i < nconsumers; i++)
+            consumer_rate[i] = consumer_phase[i].msgs * g_tsc_per_nsec * 1000.0 /
+                               (consumer_phase[i].stop - consumer_phase[i].start);
+
+        result_str(res, "allocator", ALLOC_NAME);
+        result_str(res, "queue", queue->name);
+        result_int(res, "producers", nproducers);
+        result_int(res, "consumers", nconsumers);
+        result_int(res, "messages", total_messages);
+        result_str(res, "placement", placement_name(placement));
+        result_str(res, "seed", seed);
+        result_int(res, "batch", batch);
+        result_int(res, "randomize", randomize);
+        result_int(res, "extra_alloc", extra_alloc);
+        result_num(res, "usec", usecF);
+        result_num(res, "mmsgs_per_sec", n_msgs/usecF);
+        result_num(res, "mmsgs_per_sec_per_producer", n_msgs/usecF/n_producers);
+        result_nums(res, "consumer_mmsgs_per_sec", consumer_rate, nconsumers);
+        result_num(res, "producer_cycles_per_msg", phases.prod_cpm);
+        result_num(res, "consumer_cycles_per_msg", phases.cons_cpm);
+        result_num(res, "consumer_empty_pct", phases.empty_pct);
+        result_num(res, "barrier_skew_nsec", phases.skew / g_tsc_per_nsec);
+        result_str(res, "backoff", backoff_name(g_backoff));
+        result_num(res, "producer_waits_per_msg", prod_wpm);
+        result_num(res, "consumer_waits_per_msg", cons_wpm);
+        perf_record(res, "producer", &prod_perf, total_messages);
+        perf_record(res, "consumer", &cons_perf, total_messages);
+        result_num(res, "tsc_ghz", g_tsc_per_nsec);
+        result_host(res, g_topo);
+
+        if(json)
+            result_write(res, json, RESULT_JSON);
+
+        if(csv)
+            result_write(res, csv, RESULT_CSV);
+
+        result_free(res);
+    }
 
     return 0;
 }
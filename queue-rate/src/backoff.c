@@ -0,0 +1,38 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <string.h>
+#include "backoff.h"
+
+int                g_backoff = BACKOFF_DEFAULT;
+__thread uint64_t  t_backoff_waits;
+
+static const char *g_backoff_names[BACKOFF_COUNT] = {
+    "default", "none", "pause", "exp", "yield", "sleep"
+};
+
+int backoff_lookup(const char *name)
+{
+    int i;
+
+    for(i = 0; i < BACKOFF_COUNT; i++)
+        if(strcmp(g_backoff_names[i], name) == 0)
+            return i;
+
+    return -1;
+}
+
+const char *backoff_name(int policy)
+{
+    return g_backoff_names[policy];
+}
+
+void backoff_usage(FILE *out)
+{
+    int i;
+
+    fprintf(out, "        --backoff <policy> one of:");
+
+    for(i = 0; i < BACKOFF_COUNT; i++)
+        fprintf(out, " %s", g_backoff_names[i]);
+
+    fprintf(out, "\n");
+}
@@ -0,0 +1,104 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __BACKOFF_H__
+#define __BACKOFF_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sched.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What a thread does between two failed attempts:  an empty dequeue,  */
+/* a full ring or a lock held by someone else.  Modelled on             */
+/* libcds/cds/algo/backoff_strategy.h, in C so lockrate can use it.     */
+/*                                                                      */
+/*   default  each wait loop keeps what it did before (consumers retry  */
+/*            at once, natsys pauses, the ConcurrencyFreaks locks yield)*/
+/*   none     retry at once                                             */
+/*   pause    one pause instruction (cds::backoff::pause)               */
+/*   exp      16, 32 ... 16384 pauses, then a yield per failure         */
+/*            (cds::backoff::exponential with its default bounds)       */
+/*   yield    sched_yield (cds::backoff::yield)                         */
+/*   sleep    BACKOFF_SPIN pauses, then BACKOFF_SLEEP_NSEC naps         */
+typedef enum backoff_t {
+    BACKOFF_DEFAULT,
+    BACKOFF_NONE,
+    BACKOFF_PAUSE,
+    BACKOFF_EXP,
+    BACKOFF_YIELD,
+    BACKOFF_SLEEP,
+    BACKOFF_COUNT
+} backoff_t;
+
+#define BACKOFF_EXP_MIN    16U
+#define BACKOFF_EXP_STEPS  10           /* 16 << 10 == 16384 pauses        */
+#define BACKOFF_SPIN       1024
+#define BACKOFF_SLEEP_NSEC 50000
+
+/* Policy of the whole process, set once from --backoff */
+extern int                g_backoff;
+/* Failed attempts of the calling thread that went through backoff() */
+extern __thread uint64_t  t_backoff_waits;
+
+/* Policy index for a name, -1 when unknown */
+extern int         backoff_lookup(const char *name);
+extern const char *backoff_name(int policy);
+extern void        backoff_usage(FILE *out);
+
+static inline void backoff_pause(void)
+{
+    __asm__ __volatile__("pause" ::: "memory");
+}
+
+/* Wait after the *fails-th consecutive failure of a loop; the caller  */
+/* zeroes *fails whenever it makes progress.  native is the loop's own */
+/* policy, used under --backoff default.                               */
+static inline void backoff(int native, unsigned *fails)
+{
+    struct timespec nap = { 0, BACKOFF_SLEEP_NSEC };
+    unsigned        i, n = (*fails)++;
+    int             policy = g_backoff == BACKOFF_DEFAULT ? native : g_backoff;
+
+    t_backoff_waits++;
+
+    switch(policy) {
+        case BACKOFF_PAUSE:
+            backoff_pause();
+            break;
+
+        case BACKOFF_EXP:
+            if(n > BACKOFF_EXP_STEPS) {
+                sched_yield();
+                break;
+            }
+
+            for(i = 0; i < (BACKOFF_EXP_MIN << n); i++)
+                backoff_pause();
+
+            break;
+
+        case BACKOFF_YIELD:
+            sched_yield();
+            break;
+
+        case BACKOFF_SLEEP:
+            if(n < BACKOFF_SPIN)
+                backoff_pause();
+            else
+                nanosleep(&nap, NULL);
+
+            break;
+
+        default:
+            break;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BACKOFF_H__ */
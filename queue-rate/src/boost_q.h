@@ -5,57 +5,88 @@
 #include "concurrentqueue/benchmarks/boost/config.hpp"
 #include "concurrentqueue/benchmarks/boost/config/suffix.hpp"
 #include "concurrentqueue/benchmarks/boost/lockfree/queue.hpp" /* Boost queue */
-#define QUEUE_NAME "Boost Queue"
-typedef boost::lockfree::queue<work_node_t *> Q_t;
-class token_t { public: token_t(Q_t &q) {} };
-typedef token_t producer_token_t;
-typedef token_t consumer_token_t;
-Q_t *Q;
-Q_t *initQ(int nconsumers, int nproducers, int nmessages)
-{
-    Q_t *arr = static_cast<Q_t *>(::operator new[](nconsumers*sizeof(Q_t)));
 
-    for(int i = 0; i < nconsumers; i++) {
-        ::new(arr+i) Q_t();
+/* Most nodes preallocated per queue; push allocates past it */
+#define BOOST_MAX_NODES (1<<20)
+
+struct boost_queue {
+    typedef boost::lockfree::queue<work_node_t *> Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 1 };      /* several consumers may share one queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    enum { bounded = 1 };   /* try_enqueue refuses at capacity (-Q) */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        /* Preallocate the nodes:  bounded_push (-Q) takes only these */
+        ::new(q) Q_t(nmessages < BOOST_MAX_NODES ? nmessages+1 : BOOST_MAX_NODES);
+        return q;
     }
 
-    return arr;
-}
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        inQ.push(&work);
+    }
 
-static inline void enqueue_tok(Q_t                    &inQ,
-                               const producer_token_t &token,
+    static inline void enqueue(Q_t                    &inQ,
                                work_node_t            &work)
-{
-    inQ.push(&work);
-}
-
-static inline void enqueue(Q_t                    &inQ,
-                           work_node_t            &work)
-{
-    inQ.push(&work);
-}
-
-static inline int try_dequeue_bulk(Q_t                     &inQ,
-                                   work_node_t            *&head,
-                                   int                     num)
-{
-    bool good;
-    good = inQ.pop(head);
-
-    if(good) return 1;
-    else return 0;
-}
-
-static inline int try_dequeue_bulk_tok(Q_t               &inQ,
-                                       consumer_token_t  &tok,
-                                       work_node_t      *&head,
-                                       int                num)
-{
-    bool good;
-    good = inQ.pop(head);
-
-    if(good) return 1;
-    else return 0;
-}
+    {
+        inQ.push(&work);
+    }
+
+    /* -Q:  false when the queue is at the capacity it was built with */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        return inQ.bounded_push(&work);
+    }
+
+    /* lockfree::queue has no batched push */
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            inQ.push(work[i]);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    /* consume_all() is unbounded, so drain with pop() up to num */
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        work_node_t **out = &head;
+        int           n   = 0;
+
+        while(n < num && inQ.pop(out[n]))
+            n++;
+
+        return n;
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
+    }
+};
+boost_queue::Q_t **boost_queue::Q;
 
 #endif /* __BOOST_Q_H__ */
@@ -0,0 +1,553 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __CDS_Q_H__
+#define __CDS_Q_H__
+
+/* ------------------------------------------------------------------- */
+/* The libcds queue family.  Unlike the intrusive Vyukov and Cloudius  */
+/* queues these allocate a node per message and, for the lock-free     */
+/* ones, hand the dequeued node to a safe memory reclamation scheme:   */
+/*                                                                     */
+/*   HP   hazard pointers, a fixed number per thread                   */
+/*   DHP  dynamic hazard pointers (Pass the Buck), grown on demand     */
+/*                                                                     */
+/* The GC is a template parameter of the container, so the lock-free  */
+/* queues are listed once per GC (CDS_GC_QUEUE_LIST) and --gc picks    */
+/* the table, the same way --by-value picks a payload size.  The       */
+/* lock-based and bounded array queues need no reclamation and are     */
+/* listed once (CDS_QUEUE_LIST).  --queue-stats picks a third and      */
+/* fourth copy, built with the containers' stat policies.  FCQueue's   */
+/* wait strategy is a trait as well, so --fc-wait picks fcqueue out of */
+/* a table of its own; its passes and compaction are constructor       */
+/* arguments, taken from g_fc_passes and g_fc_compact.                 */
+/*                                                                     */
+/* TreiberStack is the LIFO of the family, for work pools that need no */
+/* order; treiberelim turns on its elimination array, whose waits are  */
+/* the --eliminate front end's (elim_backoff) rather than libcds'      */
+/* millisecond sleeps.                                                 */
+/*                                                                     */
+/* Every thread that touches a GC based container must be attached to  */
+/* the libcds thread manager:  thread_init attaches on first use and a */
+/* thread_local guard detaches when the pool thread exits.  main()     */
+/* brackets the runs with cds_start and cds_stop, which construct the  */
+/* GC singletons and attach main() itself, since destroy_queues        */
+/* drains the queues from there.                                       */
+/* ------------------------------------------------------------------- */
+#include <cds/init.h>
+#include <cds/gc/hp.h>
+#include <cds/gc/dhp.h>
+#include <cds/container/msqueue.h>
+#include <cds/container/basket_queue.h>
+#include <cds/container/moir_queue.h>
+#include <cds/container/optimistic_queue.h>
+#include <cds/container/segmented_queue.h>
+#include <cds/container/fcqueue.h>
+#include <cds/container/rwqueue.h>
+#include <cds/container/tsigas_cycle_queue.h>
+#include <cds/container/vyukov_mpmc_cycle_queue.h>
+#include <cds/container/treiber_stack.h>
+#include <queue>
+#include <type_traits>
+#include "fc.h"
+#include "elim.h"
+
+/* HP's default limit of attached threads, raised for bigger sweeps */
+#define CDS_HP_THREADS  100
+
+/* Cells per segment of the segmented queue:  a dequeue takes any      */
+/* populated cell of the first segment, so FIFO order is relaxed by up */
+/* to this many messages.  --quasi sets it; libcds wants a power of    */
+/* two of at least 2.                                                  */
+#define CDS_QUASI_FACTOR 16
+
+static int g_cds_quasi = CDS_QUASI_FACTOR;
+
+enum { CDS_GC_HP, CDS_GC_DHP, CDS_GC_COUNT };
+
+static const char *g_cds_gc_names[CDS_GC_COUNT] = { "hp", "dhp" };
+
+static inline int cds_gc_lookup(const char *name)
+{
+    for(int i = 0; i < CDS_GC_COUNT; i++)
+        if(strcmp(g_cds_gc_names[i], name) == 0)
+            return i;
+
+    return -1;
+}
+
+static inline void cds_gc_usage(FILE *out)
+{
+    fprintf(out, "        --gc <hp|dhp> reclamation for the lock-free libcds queues (default hp)\n");
+}
+
+static inline void cds_quasi_usage(FILE *out)
+{
+    fprintf(out, "        --quasi <num> cells per segment of segmented, so how far FIFO is relaxed\n");
+    fprintf(out, "              (default %d, rounded up to a power of two of at least 2);\n",
+            CDS_QUASI_FACTOR);
+    fprintf(out, "              --quasi-sweep runs every point at 2, 4, 8 ... num\n");
+}
+
+/* Detaches the thread from libcds when it exits */
+struct cds_thread_t {
+    bool attached;
+
+    ~cds_thread_t()
+    {
+        if(attached)
+            cds::threading::Manager::detachThread();
+    }
+};
+
+static inline cds_thread_t &cds_thread()
+{
+    static thread_local cds_thread_t t;
+
+    return t;
+}
+
+static inline void cds_thread_attach()
+{
+    cds_thread_t &t = cds_thread();
+
+    if(!t.attached) {
+        cds::threading::Manager::attachThread();
+        t.attached = true;
+    }
+}
+
+static inline void cds_thread_detach()
+{
+    cds_thread_t &t = cds_thread();
+
+    if(t.attached) {
+        cds::threading::Manager::detachThread();
+        t.attached = false;
+    }
+}
+
+static cds::gc::HP  *g_cds_hp;
+static cds::gc::DHP *g_cds_dhp;
+
+/* Construct both GC singletons for up to nthreads attached threads */
+/* and attach the calling thread                                    */
+static void cds_start(int nthreads)
+{
+    cds::Initialize();
+    g_cds_hp  = new cds::gc::HP(0, nthreads > CDS_HP_THREADS ? nthreads
+                                                             : CDS_HP_THREADS);
+    g_cds_dhp = new cds::gc::DHP();
+    cds_thread_attach();
+}
+
+/* After the pool threads have exited */
+static void cds_stop()
+{
+    cds_thread_detach();
+    delete g_cds_dhp;
+    delete g_cds_hp;
+    cds::Terminate();
+}
+
+/* How each container is built:  whether it needs the thread attached */
+/* to a GC, whether it is a bounded array and what its constructor    */
+/* takes                                                              */
+template<class C>
+struct cds_traits {
+    enum { gc = 1 };
+    enum { bounded = 0 };
+    static void construct(C *q, int nmessages) { ::new(q) C(); }
+};
+
+/* The bounded arrays want a power of two of at least 2 cells */
+static inline size_t cds_capacity(int nmessages)
+{
+    size_t n = 2;
+
+    while(n < (size_t)nmessages)
+        n <<= 1;
+
+    return n;
+}
+
+template<class GC, class T, class Traits>
+struct cds_traits<cds::container::SegmentedQueue<GC, T, Traits> > {
+    typedef cds::container::SegmentedQueue<GC, T, Traits> C;
+    enum { gc = 1 };
+    enum { bounded = 0 };
+    static void construct(C *q, int nmessages) { ::new(q) C(g_cds_quasi); }
+};
+
+template<class T, class Sequence, class Traits>
+struct cds_traits<cds::container::FCQueue<T, Sequence, Traits> > {
+    typedef cds::container::FCQueue<T, Sequence, Traits> C;
+    enum { gc = 0 };
+    enum { bounded = 0 };
+    static void construct(C *q, int nmessages) { ::new(q) C(g_fc_compact, g_fc_passes); }
+};
+
+template<class T, class Traits>
+struct cds_traits<cds::container::RWQueue<T, Traits> > {
+    typedef cds::container::RWQueue<T, Traits> C;
+    enum { gc = 0 };
+    enum { bounded = 0 };
+    static void construct(C *q, int nmessages) { ::new(q) C(); }
+};
+
+template<class T, class Traits>
+struct cds_traits<cds::container::TsigasCycleQueue<T, Traits> > {
+    typedef cds::container::TsigasCycleQueue<T, Traits> C;
+    enum { gc = 0 };
+    enum { bounded = 1 };
+    static void construct(C *q, int nmessages) { ::new(q) C(cds_capacity(nmessages)); }
+};
+
+template<class T, class Traits>
+struct cds_traits<cds::container::VyukovMPMCCycleQueue<T, Traits> > {
+    typedef cds::container::VyukovMPMCCycleQueue<T, Traits> C;
+    enum { gc = 0 };
+    enum { bounded = 1 };
+    static void construct(C *q, int nmessages) { ::new(q) C(cds_capacity(nmessages)); }
+};
+
+/* Any of the containers, holding node pointers */
+template<class C>
+struct cds_queue {
+    typedef C Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 1 };      /* consumers may share a queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    /* The arrays refuse at the capacity newQ was given, rounded up */
+    /* to a power of two; the lists never refuse                    */
+    enum { bounded = cds_traits<C>::bounded };
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        cds_traits<C>::construct(q, nmessages);
+        return q;
+    }
+
+    static inline void thread_init(int index)
+    {
+        if(cds_traits<C>::gc)
+            cds_thread_attach();
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
+                               work_node_t            &work)
+    {
+        unsigned fails = 0;
+
+        while(!inQ.push(&work))
+            backoff(BACKOFF_PAUSE, &fails);
+    }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+    }
+
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        return inQ.push(&work);
+    }
+
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            enqueue(inQ, *work[i]);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        work_node_t **out = &head;
+        int           n   = 0;
+
+        while(n < num && inQ.pop(out[n]))
+            n++;
+
+        return n;
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
+    }
+};
+template<class C> typename cds_queue<C>::Q_t **cds_queue<C>::Q;
+
+/* --queue-stats rebuilds the containers with the stat and item_counter */
+/* policies of the libcds stress tests turned on                         */
+struct cds_msqueue_stat_traits : public cds::container::msqueue::traits {
+    typedef cds::container::msqueue::stat<>             stat;
+    typedef cds::atomicity::item_counter                item_counter;
+};
+
+struct cds_basket_stat_traits : public cds::container::basket_queue::traits {
+    typedef cds::container::basket_queue::stat<>        stat;
+    typedef cds::atomicity::item_counter                item_counter;
+};
+
+struct cds_optimistic_stat_traits : public cds::container::optimistic_queue::traits {
+    typedef cds::container::optimistic_queue::stat<>    stat;
+    typedef cds::atomicity::item_counter                item_counter;
+};
+
+struct cds_segmented_stat_traits : public cds::container::segmented_queue::traits {
+    typedef cds::container::segmented_queue::stat<>     stat;
+};
+
+struct cds_fcqueue_stat_traits : public cds::container::fcqueue::traits {
+    typedef cds::container::fcqueue::stat<>             stat;
+};
+
+struct cds_treiber_stat_traits : public cds::container::treiber_stack::traits {
+    typedef cds::container::treiber_stack::stat<>       stat;
+    typedef cds::atomicity::item_counter                item_counter;
+};
+
+struct cds_rwqueue_stat_traits : public cds::container::rwqueue::traits {
+    typedef cds::atomicity::item_counter                item_counter;
+};
+
+struct cds_tsigas_stat_traits : public cds::container::tsigas_queue::traits {
+    typedef cds::atomicity::item_counter                item_counter;
+};
+
+struct cds_vyukov_stat_traits : public cds::container::vyukov_queue::traits {
+    typedef cds::atomicity::item_counter                item_counter;
+};
+
+/* One registry argument for the GC, whether the stat policies are on */
+/* and fcqueue's FC_WAIT_* strategy, so the lists below take a single */
+/* type                                                               */
+template<class GC, bool STAT, int FC_WAIT = FC_WAIT_BACKOFF>
+struct cds_cfg {
+    typedef GC gc;
+    enum { stat = STAT };
+    enum { fc_wait = FC_WAIT };
+};
+typedef cds_cfg<cds::gc::HP,  false> cds_hp;
+typedef cds_cfg<cds::gc::DHP, false> cds_dhp;
+typedef cds_cfg<cds::gc::HP,  true>  cds_hp_stat;
+typedef cds_cfg<cds::gc::DHP, true>  cds_dhp_stat;
+typedef cds_cfg<cds::gc::HP,  false, FC_WAIT_CONDVAR>       cds_fc_condvar;
+typedef cds_cfg<cds::gc::HP,  false, FC_WAIT_MULTI_CONDVAR> cds_fc_multi_condvar;
+typedef cds_cfg<cds::gc::HP,  false, FC_WAIT_MULTI_MUTEX>   cds_fc_multi_mutex;
+typedef cds_cfg<cds::gc::HP,  true,  FC_WAIT_CONDVAR>       cds_fc_condvar_stat;
+typedef cds_cfg<cds::gc::HP,  true,  FC_WAIT_MULTI_CONDVAR> cds_fc_multi_condvar_stat;
+typedef cds_cfg<cds::gc::HP,  true,  FC_WAIT_MULTI_MUTEX>   cds_fc_multi_mutex_stat;
+
+template<class CFG, class Plain, class Stat>
+using cds_pick = typename std::conditional<CFG::stat, Stat, Plain>::type;
+
+/* --backoff for fcqueue's waiters, as lockrate_fc's wait */
+struct cds_fc_backoff {
+    unsigned fails;
+
+    cds_fc_backoff() : fails(0) { }
+    void operator()() { backoff(BACKOFF_PAUSE, &fails); }
+    void reset() { fails = 0; }
+};
+
+/* The libcds strategies behind FC_WAIT_* */
+template<int FC_WAIT>
+struct cds_fc_wait;
+
+template<>
+struct cds_fc_wait<FC_WAIT_BACKOFF> {
+    typedef cds::algo::flat_combining::wait_strategy::backoff<cds_fc_backoff> type;
+};
+
+template<>
+struct cds_fc_wait<FC_WAIT_CONDVAR> {
+    typedef cds::algo::flat_combining::wait_strategy::single_mutex_single_condvar<FC_WAIT_MSEC> type;
+};
+
+template<>
+struct cds_fc_wait<FC_WAIT_MULTI_CONDVAR> {
+    typedef cds::algo::flat_combining::wait_strategy::single_mutex_multi_condvar<FC_WAIT_MSEC> type;
+};
+
+template<>
+struct cds_fc_wait<FC_WAIT_MULTI_MUTEX> {
+    typedef cds::algo::flat_combining::wait_strategy::multi_mutex_multi_condvar<FC_WAIT_MSEC> type;
+};
+
+template<class CFG>
+struct cds_fcqueue_traits
+    : public cds_pick<CFG, cds::container::fcqueue::traits, cds_fcqueue_stat_traits> {
+    typedef typename cds_fc_wait<CFG::fc_wait>::type    wait_strategy;
+};
+
+/* Elimination on, waiting as long as the --eliminate slots do */
+template<class Base>
+struct cds_treiber_elim_traits : public Base {
+    static CDS_CONSTEXPR const bool enable_elimination = true;
+    typedef elim_backoff                                elimination_backoff;
+};
+
+template<class CFG>
+using cds_msqueue = cds_queue<cds::container::MSQueue<typename CFG::gc, work_node_t *,
+    cds_pick<CFG, cds::container::msqueue::traits, cds_msqueue_stat_traits> > >;
+template<class CFG>
+using cds_basket_queue = cds_queue<cds::container::BasketQueue<typename CFG::gc, work_node_t *,
+    cds_pick<CFG, cds::container::basket_queue::traits, cds_basket_stat_traits> > >;
+template<class CFG>
+using cds_moir_queue = cds_queue<cds::container::MoirQueue<typename CFG::gc, work_node_t *,
+    cds_pick<CFG, cds::container::msqueue::traits, cds_msqueue_stat_traits> > >;
+template<class CFG>
+using cds_optimistic_queue = cds_queue<cds::container::OptimisticQueue<typename CFG::gc, work_node_t *,
+    cds_pick<CFG, cds::container::optimistic_queue::traits, cds_optimistic_stat_traits> > >;
+template<class CFG>
+using cds_segmented_queue = cds_queue<cds::container::SegmentedQueue<typename CFG::gc, work_node_t *,
+    cds_pick<CFG, cds::container::segmented_queue::traits, cds_segmented_stat_traits> > >;
+template<class CFG>
+using cds_treiber_stack = cds_queue<cds::container::TreiberStack<typename CFG::gc, work_node_t *,
+    cds_pick<CFG, cds::container::treiber_stack::traits, cds_treiber_stat_traits> > >;
+template<class CFG>
+using cds_treiber_elim_stack = cds_queue<cds::container::TreiberStack<typename CFG::gc, work_node_t *,
+    cds_treiber_elim_traits<cds_pick<CFG, cds::container::treiber_stack::traits,
+                                     cds_treiber_stat_traits> > > >;
+
+/* No GC:  CFG says whether the stat policies are on and, for fcqueue, */
+/* how its waiters wait                                                */
+template<class CFG>
+using cds_fcqueue = cds_queue<cds::container::FCQueue<work_node_t *, std::queue<work_node_t *>,
+    cds_fcqueue_traits<CFG> > >;
+template<class CFG>
+using cds_rwqueue = cds_queue<cds::container::RWQueue<work_node_t *,
+    cds_pick<CFG, cds::container::rwqueue::traits, cds_rwqueue_stat_traits> > >;
+template<class CFG>
+using cds_tsigas_queue = cds_queue<cds::container::TsigasCycleQueue<work_node_t *,
+    cds_pick<CFG, cds::container::tsigas_queue::traits, cds_tsigas_stat_traits> > >;
+template<class CFG>
+using cds_vyukov_cycle_queue = cds_queue<cds::container::VyukovMPMCCycleQueue<work_node_t *,
+    cds_pick<CFG, cds::container::vyukov_queue::traits, cds_vyukov_stat_traits> > >;
+
+/* libcds' counters in qstats_t terms; the empty dequeues are left to */
+/* the driver, since every bulk dequeue ends on one                   */
+template<class S>
+static inline void cds_stat_add(const S &st, qstats_t *s) { }
+
+template<class Counter>
+static inline void cds_stat_add(const cds::intrusive::msqueue::stat<Counter> &st,
+                                qstats_t *s)
+{
+    s->enq_races += st.m_EnqueueRace.get();
+    s->deq_races += st.m_DequeueRace.get();
+    s->retries   += st.m_AdvanceTailError.get() + st.m_BadTail.get();
+}
+
+/* A lost enqueue CAS first tries to join the basket it lost to */
+template<class Counter>
+static inline void cds_stat_add(const cds::intrusive::basket_queue::stat<Counter> &st,
+                                qstats_t *s)
+{
+    s->enq_races += st.m_EnqueueRace.get();
+    s->deq_races += st.m_DequeueRace.get();
+    s->retries   += st.m_AdvanceTailError.get() + st.m_BadTail.get() +
+                    st.m_TryAddBasket.get();
+}
+
+/* The prev links are repaired when a dequeue finds them stale */
+template<class Counter>
+static inline void cds_stat_add(const cds::intrusive::optimistic_queue::stat<Counter> &st,
+                                qstats_t *s)
+{
+    s->enq_races += st.m_EnqueueRace.get();
+    s->deq_races += st.m_DequeueRace.get();
+    s->retries   += st.m_AdvanceTailError.get() + st.m_BadTail.get() +
+                    st.m_FixListCount.get();
+}
+
+/* A push that lands on a cell already taken moves on to another */
+template<class Counter>
+static inline void cds_stat_add(const cds::intrusive::segmented_queue::stat<Counter> &st,
+                                qstats_t *s)
+{
+    s->enq_races += st.m_nPushContended.get();
+    s->deq_races += st.m_nPopContended.get();
+    s->retries   += st.m_nPushPopulated.get();
+    s->segments  += st.m_nSegmentCreated.get();
+}
+
+/* How many combiners ran, and how often a waiter polled its record */
+template<class Counter>
+static inline void cds_stat_add(const cds::container::fcqueue::stat<Counter> &st,
+                                qstats_t *s)
+{
+    s->combines += st.m_nCombiningCount.get();
+    s->retries  += st.m_nPassiveWaitIteration.get();
+}
+
+/* A push or pop that lost its CAS backs off into the elimination */
+/* array, where a collision pairs it with the opposite operation   */
+template<class Counter>
+static inline void cds_stat_add(const cds::intrusive::treiber_stack::stat<Counter> &st,
+                                qstats_t *s)
+{
+    s->enq_races  += st.m_PushRace.get();
+    s->deq_races  += st.m_PopRace.get();
+    s->retries    += st.m_EliminationFailed.get();
+    s->eliminated += st.m_ActivePushCollision.get() + st.m_PassivePushCollision.get();
+}
+
+/* RWQueue and the cycle queues keep an item counter only */
+template<class C>
+static inline auto cds_stats_read(const C &q, qstats_t *s, int)
+    -> decltype(q.statistics(), void())
+{
+    cds_stat_add(q.statistics(), s);
+}
+
+template<class C>
+static inline void cds_stats_read(const C &q, qstats_t *s, long) { }
+
+template<class C>
+struct queue_stats<cds_queue<C> > {
+    static inline void read(C &inQ, qstats_t *s)
+    {
+        cds_stats_read(inQ, s, 0);
+        s->left  += inQ.size();
+        s->sized  = 1;
+    }
+};
+
+/*      -q name   adapter                    description           */
+#define CDS_GC_QUEUE_LIST(X, CFG)                                   \
+    X(msqueue,    cds_msqueue<CFG>,          "libcds MSQueue")     \
+    X(basket,     cds_basket_queue<CFG>,     "libcds BasketQueue") \
+    X(moir,       cds_moir_queue<CFG>,       "libcds MoirQueue")   \
+    X(optimistic, cds_optimistic_queue<CFG>, "libcds OptimisticQueue") \
+    X(segmented,  cds_segmented_queue<CFG>,  "libcds SegmentedQueue") \
+    X(treiber,    cds_treiber_stack<CFG>,    "libcds TreiberStack (LIFO)") \
+    X(treiberelim, cds_treiber_elim_stack<CFG>, "libcds TreiberStack with elimination (LIFO)")
+
+#define CDS_QUEUE_LIST(X, CFG)                                      \
+    X(fcqueue,    cds_fcqueue<CFG>,          "libcds FCQueue (flat combining)") \
+    X(rwqueue,    cds_rwqueue<CFG>,          "libcds RWQueue (two locks)")      \
+    X(tsigas,     cds_tsigas_queue<CFG>,     "libcds TsigasCycleQueue")         \
+    X(vyukovcycle, cds_vyukov_cycle_queue<CFG>, "libcds VyukovMPMCCycleQueue")
+
+#endif /* __CDS_Q_H__ */
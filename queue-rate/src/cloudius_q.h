@@ -2,56 +2,92 @@
 #ifndef __CLOUDIUS_Q_H__
 #define __CLOUDIUS_Q_H__
 
+/* Lost CAS on the pushlist count under --queue-stats */
+#define QUEUE_MPSC_STAT(event) QSTAT(event)
 #include "queue-mpsc.h"                                      /* Cloudius Queue       */
-#define QUEUE_NAME "Cloudius Queue"
-typedef lockfree::queue_mpsc<work_node_t>   Q_t;
-class token_t { public: token_t(Q_t &q) {} };
-typedef token_t producer_token_t;
-typedef token_t consumer_token_t;
-Q_t *Q;
-Q_t *initQ(int nconsumers, int nproducers, int nmessages)
-{
-    Q_t *arr = static_cast<Q_t *>(::operator new[](nconsumers*sizeof(Q_t)));
-
-    for(int i = 0; i < nconsumers; i++) {
-        ::new(arr+i) Q_t();
+struct cloudius_queue {
+    typedef lockfree::queue_mpsc<work_node_t>   Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 0 };      /* one consumer per queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    enum { bounded = 0 };   /* -Q is counted by the driver */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t();
+        return q;
     }
 
-    return arr;
-}
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        inQ.push(&work);
+    }
 
-static inline void enqueue_tok(Q_t                    &inQ,
-                               const producer_token_t &token,
+    static inline void enqueue(Q_t                    &inQ,
                                work_node_t            &work)
-{
-    inQ.push(&work);
-}
-
-static inline void enqueue(Q_t                    &inQ,
-                           work_node_t            &work)
-{
-    inQ.push(&work);
-}
-
-static inline int try_dequeue_bulk(Q_t                     &inQ,
-                                   work_node_t            *&head,
-                                   int                     num)
-{
-    head = inQ.pop();
-
-    if(head) return 1;
-    else return 0;
-}
-
-static inline int try_dequeue_bulk_tok(Q_t               &inQ,
-                                       consumer_token_t  &tok,
-                                       work_node_t      *&head,
-                                       int                num)
-{
-    head = inQ.pop();
-
-    if(head) return 1;
-    else return 0;
-}
+    {
+        inQ.push(&work);
+    }
+
+    /* Never refuses:  the driver keeps -Q for this queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+        return true;
+    }
+
+    /* The push list is newest first:  chain the batch that way and */
+    /* splice it onto the list with a single CAS                    */
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = num-1; i > 0; i--)
+            work[i]->next = work[i-1];
+
+        inQ.push_bulk(work[0], work[num-1]);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    /* The first pop() takes the whole push list with one exchange and
+     * reverses it into the pop list; the following ones only walk it.
+     * popall() would hand back an unbounded chain, num bounds the batch */
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        work_node_t **out = &head;
+        int           n   = 0;
+
+        while(n < num && (out[n] = inQ.pop()) != NULL)
+            n++;
+
+        return n;
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
+    }
+};
+cloudius_queue::Q_t **cloudius_queue::Q;
 
 #endif /* __CLOUDIUS_Q_H__ */
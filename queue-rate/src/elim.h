@@ -0,0 +1,241 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __ELIM_H__
+#define __ELIM_H__
+
+/* ------------------------------------------------------------------- */
+/* Elimination front end (--eliminate <slots>), for work pools that    */
+/* need no FIFO order.  elim_queue<A> wraps any pointer adapter and    */
+/* puts an array of slots in front of each of its queues:              */
+/*                                                                     */
+/*   a dequeue that finds the queue empty waits in a random slot for   */
+/*   up to ELIM_SPIN pauses before it reports the queue empty          */
+/*   an enqueue first looks at one random slot and hands its node      */
+/*   straight to a dequeue waiting there                               */
+/*                                                                     */
+/* A matched pair never reaches the queue, whose head and tail are     */
+/* where producers and consumers of a nearly empty queue collide       */
+/* (Hendler, Shavit and Yerushalmi's elimination back-off, applied in  */
+/* front of the queue as Moir et al. do).  An eliminated message       */
+/* overtakes the ones still queued, so order per producer is lost.     */
+/*                                                                     */
+/* A slot is empty (NULL), holds a waiting dequeue (ELIM_WAITING) or   */
+/* the node handed to that dequeue, which only the waiter clears.      */
+/* ------------------------------------------------------------------- */
+#include "backoff.h"
+#include "rng.h"
+
+#define ELIM_SLOTS_MAX 64
+#define ELIM_SPIN      256
+#define ELIM_WAITING   ((work_node_t *)1)
+
+/* Slots in use per queue, from --eliminate; 0 when it is off */
+static int g_elim_slots;
+
+/* Slot choices of the calling thread, one stream per side */
+static __thread uint64_t t_elim_give_rng;
+static __thread uint64_t t_elim_take_rng;
+
+static inline void elim_usage(FILE *out)
+{
+    fprintf(out, "        --eliminate <slots> pair enqueues with dequeues waiting on an empty queue\n");
+    fprintf(out, "              in up to %d slots per queue, before they reach it; FIFO is lost\n",
+            ELIM_SLOTS_MAX);
+}
+
+struct elim_slot_t {
+    work_node_t *volatile node;
+    char                  pad[64-sizeof(work_node_t *)];
+};
+
+/* Waits for a predicate as libcds' elimination_backoff does, for */
+/* as long as the front end waits in its slots                    */
+struct elim_backoff {
+    template<class Predicate>
+    bool operator()(Predicate pr) const
+    {
+        for(int i = 0; i < ELIM_SPIN; i++) {
+            if(pr())
+                return true;
+
+            backoff_pause();
+        }
+
+        return pr();
+    }
+
+    void operator()() const { backoff_pause(); }
+    static void reset() { }
+};
+
+/* Hand work to a dequeue waiting in a random slot */
+static inline bool elim_give(elim_slot_t *slots, work_node_t *work)
+{
+    elim_slot_t *s      = &slots[rng_below(&t_elim_give_rng, g_elim_slots)];
+    work_node_t *expect = ELIM_WAITING;
+
+    if(s->node != ELIM_WAITING ||
+       !__atomic_compare_exchange_n(&s->node, &expect, work, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return false;
+
+    QSTAT(eliminated);
+    return true;
+}
+
+/* Wait in a random empty slot for an enqueue:  1 and the node at */
+/* head when one came                                             */
+static inline int elim_take(elim_slot_t *slots, work_node_t *&head)
+{
+    elim_slot_t *s      = &slots[rng_below(&t_elim_take_rng, g_elim_slots)];
+    work_node_t *expect = NULL;
+
+    if(s->node != NULL ||
+       !__atomic_compare_exchange_n(&s->node, &expect, ELIM_WAITING, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return 0;
+
+    elim_backoff()([s]() {
+        return __atomic_load_n(&s->node, __ATOMIC_ACQUIRE) != ELIM_WAITING;
+    });
+
+    /* Withdraw, unless an enqueue got there first */
+    expect = ELIM_WAITING;
+
+    if(__atomic_compare_exchange_n(&s->node, &expect, (work_node_t *)NULL, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return 0;
+
+    head = expect;
+    __atomic_store_n(&s->node, (work_node_t *)NULL, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* The wrapped queue behind its slots */
+template<class A>
+struct elim_q_t {
+    elim_slot_t        slots[ELIM_SLOTS_MAX];
+    typename A::Q_t   *q;
+
+    ~elim_q_t()
+    {
+        typedef typename A::Q_t inner_t;
+
+        q->~inner_t();
+        ::operator delete(q);
+    }
+};
+
+template<class A>
+struct elim_queue {
+    typedef elim_q_t<A> Q_t;
+    struct producer_token_t {
+        typename A::producer_token_t tok;
+        producer_token_t(Q_t &q) : tok(*q.q) { }
+    };
+    struct consumer_token_t {
+        typename A::consumer_token_t tok;
+        consumer_token_t(Q_t &q) : tok(*q.q) { }
+    };
+    enum { mpmc = A::mpmc };
+    enum { spsc = A::spsc };
+    enum { bounded = A::bounded };
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        memset(q->slots, 0, sizeof(q->slots));
+        q->q = A::newQ(nconsumers, nproducers, nmessages);
+        return q;
+    }
+
+    static inline void thread_init(int index)
+    {
+        t_elim_give_rng = rng_seed(g_seed, 2, index);
+        t_elim_take_rng = rng_seed(g_seed, 3, index);
+        A::thread_init(index);
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
+                               work_node_t            &work)
+    {
+        if(!elim_give(inQ.slots, &work))
+            A::enqueue(*inQ.q, work);
+    }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        if(!elim_give(inQ.slots, &work))
+            A::enqueue_tok(*inQ.q, token.tok, work);
+    }
+
+    /* A handed over node takes no room in the queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        return elim_give(inQ.slots, &work) || A::try_enqueue(*inQ.q, work);
+    }
+
+    /* The front of the batch while dequeues are waiting, the rest */
+    /* in one bulk enqueue                                         */
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        int i = 0;
+
+        while(i < num && elim_give(inQ.slots, work[i]))
+            i++;
+
+        if(i < num)
+            A::enqueue_bulk(*inQ.q, work+i, num-i);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        int i = 0;
+
+        while(i < num && elim_give(inQ.slots, work[i]))
+            i++;
+
+        if(i < num)
+            A::enqueue_bulk_tok(*inQ.q, token.tok, work+i, num-i);
+    }
+
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        int n = A::try_dequeue_bulk(*inQ.q, head, num);
+
+        return n ? n : elim_take(inQ.slots, head);
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        int n = A::try_dequeue_bulk_tok(*inQ.q, tok.tok, head, num);
+
+        return n ? n : elim_take(inQ.slots, head);
+    }
+};
+template<class A> typename elim_queue<A>::Q_t **elim_queue<A>::Q;
+
+template<class A>
+struct queue_stats<elim_queue<A> > {
+    static inline void read(elim_q_t<A> &inQ, qstats_t *s)
+    {
+        queue_stats<A>::read(*inQ.q, s);
+    }
+};
+
+#define ELIM_ENTRY(name, adapter, description)                        \
+    QUEUE_ENTRY(name, elim_queue<adapter >, description)
+
+#endif /* __ELIM_H__ */
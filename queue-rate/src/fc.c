@@ -0,0 +1,282 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "backoff.h"
+#include "fc.h"
+
+unsigned          g_fc_passes  = FC_PASSES;
+unsigned          g_fc_compact = FC_COMPACT;
+int               g_fc_wait    = FC_WAIT_BACKOFF;
+__thread int      t_fc_slot;
+
+static const char *g_fc_wait_names[FC_WAIT_COUNT] = {
+    "backoff", "condvar", "multi-condvar", "multi-mutex"
+};
+
+int fc_wait_lookup(const char *name)
+{
+    int i;
+
+    for(i = 0; i < FC_WAIT_COUNT; i++)
+        if(strcmp(g_fc_wait_names[i], name) == 0)
+            return i;
+
+    return -1;
+}
+
+const char *fc_wait_name(int wait)
+{
+    return g_fc_wait_names[wait];
+}
+
+void fc_usage(FILE *out)
+{
+    int i;
+
+    fprintf(out, "        --fc-passes <num> combining passes per combiner (default %d)\n",
+            FC_PASSES);
+    fprintf(out, "        --fc-compact <num> unlink publication records idle for num combines,\n");
+    fprintf(out, "              every num combines (default %d)\n", FC_COMPACT);
+    fprintf(out, "        --fc-wait <strategy> how posted operations wait, one of:");
+
+    for(i = 0; i < FC_WAIT_COUNT; i++)
+        fprintf(out, " %s", g_fc_wait_names[i]);
+
+    fprintf(out, "\n");
+}
+
+void fc_init(fc_t *fc, int nrecs)
+{
+    unsigned period = 1;
+    int      i;
+
+    while(period < g_fc_compact)
+        period <<= 1;
+
+    memset(fc, 0, sizeof(*fc));
+    fc->mask  = period - 1;
+    fc->nrecs = nrecs;
+
+    if(posix_memalign((void **)&fc->recs, 64, sizeof(fc_rec_t) * nrecs) != 0)
+        abort();
+
+    memset(fc->recs, 0, sizeof(fc_rec_t) * nrecs);
+
+    for(i = 0; i < nrecs; i++) {
+        pthread_mutex_init(&fc->recs[i].mutex, NULL);
+        pthread_cond_init(&fc->recs[i].cond, NULL);
+    }
+
+    pthread_mutex_init(&fc->mutex, NULL);
+    pthread_cond_init(&fc->cond, NULL);
+    fc->recs[0].active = 1;
+}
+
+void fc_destroy(fc_t *fc)
+{
+    int i;
+
+    for(i = 0; i < fc->nrecs; i++) {
+        pthread_mutex_destroy(&fc->recs[i].mutex);
+        pthread_cond_destroy(&fc->recs[i].cond);
+    }
+
+    pthread_mutex_destroy(&fc->mutex);
+    pthread_cond_destroy(&fc->cond);
+    free(fc->recs);
+}
+
+static inline int fc_trylock(fc_t *fc)
+{
+    return !__atomic_load_n(&fc->lock, __ATOMIC_RELAXED) &&
+           !__atomic_exchange_n(&fc->lock, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void fc_unlock(fc_t *fc)
+{
+    __atomic_store_n(&fc->lock, 0, __ATOMIC_RELEASE);
+}
+
+static inline int fc_done(fc_rec_t *rec)
+{
+    return __atomic_load_n(&rec->op, __ATOMIC_ACQUIRE) == FC_DONE;
+}
+
+/* Link rec back in after the head when a compaction dropped it.  Only */
+/* the owner links its record and only the combiner unlinks it, which  */
+/* clears active once the record is out of the list.                   */
+static void fc_publish(fc_t *fc, fc_rec_t *rec)
+{
+    fc_rec_t *head = fc->recs, *next;
+
+    if(rec == head || __atomic_load_n(&rec->active, __ATOMIC_ACQUIRE))
+        return;
+
+    rec->age = __atomic_load_n(&fc->count, __ATOMIC_RELAXED);
+    __atomic_store_n(&rec->active, 1, __ATOMIC_RELEASE);
+    next = __atomic_load_n(&head->next, __ATOMIC_RELAXED);
+
+    do
+        rec->next = next;
+    while(!__atomic_compare_exchange_n(&head->next, &next, rec, 1,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* The combiner served rec */
+static inline void fc_notify(fc_t *fc, fc_rec_t *rec)
+{
+    if(g_fc_wait == FC_WAIT_CONDVAR)
+        pthread_cond_broadcast(&fc->cond);
+    else if(g_fc_wait != FC_WAIT_BACKOFF)
+        pthread_cond_signal(&rec->cond);
+}
+
+/* A waiter found its operation done once it had the lock:  pass the */
+/* turn to some other waiter, which may now become the combiner      */
+static void fc_wakeup(fc_t *fc)
+{
+    fc_rec_t *p;
+
+    if(g_fc_wait == FC_WAIT_CONDVAR)
+        pthread_cond_broadcast(&fc->cond);
+    else if(g_fc_wait != FC_WAIT_BACKOFF)
+        for(p = fc->recs; p; p = __atomic_load_n(&p->next, __ATOMIC_ACQUIRE))
+            if(__atomic_load_n(&p->op, __ATOMIC_ACQUIRE) >= FC_OP) {
+                pthread_cond_signal(&p->cond);
+                break;
+            }
+}
+
+/* Sleep until the combiner notifies rec or FC_WAIT_MSEC pass */
+static void fc_block(fc_t *fc, fc_rec_t *rec)
+{
+    pthread_mutex_t *mutex = g_fc_wait == FC_WAIT_MULTI_MUTEX ? &rec->mutex : &fc->mutex;
+    pthread_cond_t  *cond  = g_fc_wait == FC_WAIT_CONDVAR ? &fc->cond : &rec->cond;
+    struct timespec  until;
+
+    if(fc_done(rec))
+        return;
+
+    pthread_mutex_lock(mutex);
+
+    if(!fc_done(rec)) {
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += FC_WAIT_MSEC * 1000000L;
+
+        if(until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+
+        pthread_cond_timedwait(cond, mutex, &until);
+    }
+
+    pthread_mutex_unlock(mutex);
+}
+
+/* Wait for a combiner to serve rec:  1 when it did, 0 when the lock */
+/* came free first and the caller is now the combiner                */
+static int fc_wait(fc_t *fc, fc_rec_t *rec)
+{
+    unsigned fails = 0;
+
+    while(!fc_done(rec)) {
+        fc_publish(fc, rec);
+        rec->waits++;
+
+        if(g_fc_wait == FC_WAIT_BACKOFF)
+            backoff(BACKOFF_PAUSE, &fails);
+        else
+            fc_block(fc, rec);
+
+        if(fc_trylock(fc)) {
+            if(fc_done(rec)) {
+                fc_unlock(fc);
+                fc_wakeup(fc);
+                break;
+            }
+
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* One pass over the list:  whether it served anything */
+static int fc_pass(fc_t *fc, unsigned age, fc_exec_t exec, void *obj)
+{
+    fc_rec_t *p;
+    int       op, served = 0;
+
+    for(p = fc->recs; p; p = __atomic_load_n(&p->next, __ATOMIC_ACQUIRE)) {
+        op = __atomic_load_n(&p->op, __ATOMIC_ACQUIRE);
+
+        if(op < FC_OP)
+            continue;
+
+        p->age = age;
+        p->arg = exec(obj, op, p->arg);
+        fc->ops++;
+        __atomic_store_n(&p->op, FC_DONE, __ATOMIC_RELEASE);
+        fc_notify(fc, p);
+        served = 1;
+    }
+
+    return served;
+}
+
+/* Unlink the records, other than the head, idle for a whole period */
+static void fc_compact(fc_t *fc, unsigned age)
+{
+    fc_rec_t *prev = fc->recs, *p, *next, *expect;
+
+    for(p = __atomic_load_n(&prev->next, __ATOMIC_ACQUIRE); p; p = next) {
+        next   = __atomic_load_n(&p->next, __ATOMIC_ACQUIRE);
+        expect = p;
+
+        /* A record linked in after the head meanwhile makes the CAS */
+        /* fail; p is then still in the list, behind it              */
+        if(p->age + fc->mask < age &&
+           __atomic_compare_exchange_n(&prev->next, &expect, next, 0,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&p->active, 0, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        prev = p;
+    }
+}
+
+static void fc_combine(fc_t *fc, fc_exec_t exec, void *obj)
+{
+    unsigned age = __atomic_add_fetch(&fc->count, 1, __ATOMIC_RELAXED);
+    unsigned pass, useful = 0, empty = 0;
+
+    for(pass = 0; pass < g_fc_passes; pass++)
+        if(fc_pass(fc, age, exec, obj))
+            useful++;
+        else if(++empty > useful)
+            break;
+
+    if((age & fc->mask) == 0)
+        fc_compact(fc, age);
+}
+
+void *fc_apply(fc_t *fc, int op, void *arg, fc_exec_t exec, void *obj)
+{
+    fc_rec_t *rec = &fc->recs[t_fc_slot];
+
+    rec->arg = arg;
+    __atomic_store_n(&rec->op, op, __ATOMIC_RELEASE);
+
+    if(fc_trylock(fc) || !fc_wait(fc, rec)) {
+        /* The combiner serves its own record on the first pass */
+        fc_publish(fc, rec);
+        fc_combine(fc, exec, obj);
+        fc_unlock(fc);
+    }
+
+    return rec->arg;
+}
@@ -0,0 +1,98 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __FC_H__
+#define __FC_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Flat combining (Hendler, Incze, Shavit and Tzafrir).  A thread posts */
+/* its operation in its own publication record; whoever gets the        */
+/* combiner lock runs every posted operation on the sequential object,  */
+/* so the object's lines stay in one cache and the lock changes hands   */
+/* once per batch rather than once per operation.                       */
+/*                                                                      */
+/* The knobs are those of libcds' cds::algo::flat_combining::kernel,    */
+/* which qrate's fcqueue is built on; lockrate_fc serializes its list   */
+/* with the C combiner below, a transcription of that kernel.           */
+/*                                                                      */
+/*   passes   passes over the publication list per combiner, stopping   */
+/*            early once the empty passes outnumber the useful ones     */
+/*   compact  every compact combines (rounded up to a power of two)     */
+/*            the combiner unlinks the records idle for that long;      */
+/*            their owners link them back on their next operation       */
+/*   wait     how a thread whose operation is posted waits:             */
+/*     backoff        backoff() on the record (--backoff, pause)        */
+/*     condvar        one mutex and condition variable for all          */
+/*     multi-condvar  one mutex, a condition variable per record        */
+/*     multi-mutex    a mutex and condition variable per record         */
+/*            The blocking waits time out after FC_WAIT_MSEC and try    */
+/*            the combiner lock again, as libcds' do.                   */
+typedef enum fc_wait_t {
+    FC_WAIT_BACKOFF,
+    FC_WAIT_CONDVAR,
+    FC_WAIT_MULTI_CONDVAR,
+    FC_WAIT_MULTI_MUTEX,
+    FC_WAIT_COUNT
+} fc_wait_t;
+
+/* libcds' defaults */
+#define FC_PASSES    8
+#define FC_COMPACT   1024
+#define FC_WAIT_MSEC 2
+
+/* Set once from --fc-passes, --fc-compact and --fc-wait */
+extern unsigned g_fc_passes;
+extern unsigned g_fc_compact;
+extern int      g_fc_wait;
+/* Publication record of the calling thread in every fc_t, 0 and up */
+extern __thread int t_fc_slot;
+
+/* Wait index for a name, -1 when unknown */
+extern int         fc_wait_lookup(const char *name);
+extern const char *fc_wait_name(int wait);
+extern void        fc_usage(FILE *out);
+
+/* Operation codes below FC_OP are the record's own states */
+enum { FC_EMPTY, FC_DONE, FC_OP };
+
+typedef struct fc_rec_t {
+    volatile int              op;       /* FC_EMPTY, FC_DONE or posted op  */
+    volatile int              active;   /* linked into the list            */
+    volatile unsigned         age;      /* combine that last served it     */
+    void *volatile            arg;      /* operand in, result out          */
+    struct fc_rec_t *volatile next;
+    uint64_t                  waits;    /* wait strategy calls, owner's    */
+    pthread_mutex_t           mutex;    /* multi-mutex                     */
+    pthread_cond_t            cond;     /* multi-condvar and multi-mutex   */
+} __attribute__((aligned(64))) fc_rec_t;
+
+/* Runs one posted operation on the sequential object */
+typedef void *(*fc_exec_t)(void *obj, int op, void *arg);
+
+typedef struct fc_t {
+    volatile int     lock;      /* the combiner's                        */
+    unsigned         count;     /* combines so far, the records' age     */
+    unsigned         mask;      /* compaction period - 1                 */
+    int              nrecs;
+    fc_rec_t        *recs;      /* recs[0] heads the list and stays      */
+    uint64_t         ops;       /* operations the combiners ran          */
+    pthread_mutex_t  mutex;     /* condvar and multi-condvar             */
+    pthread_cond_t   cond;      /* condvar                               */
+} fc_t;
+
+/* A combiner for nrecs threads, with the current g_fc_* settings */
+extern void  fc_init(fc_t *fc, int nrecs);
+extern void  fc_destroy(fc_t *fc);
+/* Post op on arg from slot t_fc_slot and return what exec returned */
+extern void *fc_apply(fc_t *fc, int op, void *arg, fc_exec_t exec, void *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FC_H__ */
@@ -0,0 +1,93 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __FOLLY_PCQ_Q_H__
+#define __FOLLY_PCQ_Q_H__
+
+#include "folly/folly/ProducerConsumerQueue.h"               /* Folly SPSC Queue     */
+#include "backoff.h"
+
+/* Ring slots at most, like spsc_q.h:  a full ring makes the producer wait */
+#define PCQ_MAX_SLOTS   (1U<<20)
+
+struct folly_pcq_queue {
+    typedef folly::ProducerConsumerQueue<work_node_t *> Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 0 };      /* one consumer per queue */
+    enum { spsc = 1 };      /* and one producer:  --topology pairs */
+    enum { bounded = 1 };   /* try_enqueue refuses at capacity (-Q) */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        /* One slot is always left empty */
+        ::new(q) Q_t(nmessages+1 < (int)PCQ_MAX_SLOTS ? nmessages+1 : PCQ_MAX_SLOTS);
+        return q;
+    }
+
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
+                               work_node_t            &work)
+    {
+        unsigned fails = 0;
+
+        while(!inQ.write(&work))
+            backoff(BACKOFF_PAUSE, &fails);
+    }
+
+    /* -Q:  false when the queue is at the capacity it was built with */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        return inQ.write(&work);
+    }
+
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            enqueue(inQ, *work[i]);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    /* No batched read:  drain slot by slot up to num */
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        work_node_t **out = &head;
+        int           n   = 0;
+
+        while(n < num && inQ.read(out[n]))
+            n++;
+
+        return n;
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
+    }
+};
+folly_pcq_queue::Q_t **folly_pcq_queue::Q;
+
+#endif /* __FOLLY_PCQ_Q_H__ */
@@ -3,59 +3,171 @@
 #define __FOLLY_Q_H__
 
 #include "folly/folly/MPMCQueue.h"                           /* Facebook Folly Queue */
-#define QUEUE_NAME "Facebook Folly Queue"
-typedef folly::MPMCQueue<work_node_t *> Q_t;
-class token_t { public: token_t(Q_t &q) {} };
-typedef token_t producer_token_t;
-typedef token_t consumer_token_t;
-Q_t *Q;
-Q_t *initQ(int nconsumers, int nproducers, int nmessages)
-{
-    Q_t *arr = static_cast<Q_t *>(::operator new[](nconsumers*sizeof(Q_t)));
+#include "value_node.h"
+struct folly_queue {
+    typedef folly::MPMCQueue<work_node_t *> Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 1 };      /* several consumers may share one queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    enum { bounded = 1 };   /* try_enqueue refuses at capacity (-Q) */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t(nmessages);
+        return q;
+    }
+
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+    }
+
+    /* write() refuses a full queue rather than waiting:  retry, so */
+    /* no node is dropped                                          */
+    static inline void enqueue(Q_t                    &inQ,
+                               work_node_t            &work)
+    {
+        unsigned fails = 0;
+
+        while(!inQ.write(&work))
+            backoff(BACKOFF_PAUSE, &fails);
+    }
+
+    /* -Q:  false when the queue is at the capacity it was built with */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        return inQ.write(&work);
+    }
+
+    /* MPMCQueue has no batched write:  one ticket per node */
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            enqueue(inQ, *work[i]);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    /* MPMCQueue has no batched read:  drain slot by slot up to num */
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        work_node_t **out = &head;
+        int           n   = 0;
+
+        while(n < num && inQ.read(out[n]))
+            n++;
+
+        return n;
+    }
 
-    for(int i = 0; i < nconsumers; i++) {
-        ::new(arr+i) Q_t(nmessages);
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
     }
+};
+folly_queue::Q_t **folly_queue::Q;
 
-    return arr;
-}
+/* By value (--by-value):  each slot holds a whole message */
+template<int N>
+struct folly_value_queue {
+    typedef folly::MPMCQueue<value_node_t<N> > Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 1 };
+    enum { spsc = 0 };
+    enum { bounded = 1 };   /* try_enqueue refuses at capacity (-Q) */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t(nmessages);
+        return q;
+    }
+
+    static inline void thread_init(int index) { value_buffer<N>::init(); }
 
-static inline void enqueue_tok(Q_t                    &inQ,
-                               const producer_token_t &token,
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
                                work_node_t            &work)
-{
-    inQ.write(&work);
-}
-
-static inline void enqueue(Q_t                    &inQ,
-                           work_node_t            &work)
-{
-    inQ.write(&work);
-}
-
-static inline int try_dequeue_bulk(Q_t                     &inQ,
-                                   work_node_t            *&head,
-                                   int                     num)
-{
-    bool flag;
-    flag = inQ.read(head);
-
-    if(flag) {
-        return 1;
-    } else return 0;
-}
-
-static inline int try_dequeue_bulk_tok(Q_t               &inQ,
-                                       consumer_token_t  &tok,
-                                       work_node_t      *&head,
-                                       int                num)
-{
-    bool flag;
-    flag = inQ.read(head);
-
-    if(flag) {
-        return 1;
-    } else return 0;
-}
+    {
+        unsigned fails = 0;
+
+        while(!inQ.write(*reinterpret_cast<value_node_t<N> *>(&work)))
+            backoff(BACKOFF_PAUSE, &fails);
+    }
+
+    /* -Q:  false when the queue is at the capacity it was built with */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        return inQ.write(*reinterpret_cast<value_node_t<N> *>(&work));
+    }
+
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            enqueue(inQ, *work[i]);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        value_node_t<N> *buf = value_buffer<N>::buf;
+        int              n   = 0;
+
+        while(n < num && n < VALUE_BULK && inQ.read(buf[n]))
+            n++;
+
+        return value_buffer<N>::hand_out(head, n);
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
+    }
+};
+template<int N> typename folly_value_queue<N>::Q_t **folly_value_queue<N>::Q;
 
 #endif /* __FOLLY_Q_H__ */
@@ -0,0 +1,59 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+/* ------------------------------------------------------------------- */
+/* The parts of folly/detail/CacheLocality.cpp and MemoryIdler.cpp     */
+/* that LifoSem and Baton link against.  Those two files need glog and */
+/* double-conversion, which are not vendored, so the harness supplies  */
+/* plain versions:  a flat cache topology (LifoSem only uses it to     */
+/* stripe its wait nodes) and an idler that never trims memory.        */
+/* ------------------------------------------------------------------- */
+#include <dlfcn.h>
+#include <unistd.h>
+#include <folly/detail/CacheLocality.h>
+#include <folly/detail/MemoryIdler.h>
+
+namespace folly {
+namespace detail {
+
+CacheLocality CacheLocality::uniform(size_t numCpus)
+{
+    CacheLocality rv;
+
+    rv.numCpus = numCpus;
+    rv.numCachesByLevel.push_back(numCpus);
+
+    for(size_t cpu = 0; cpu < numCpus; cpu++)
+        rv.localityIndexByCpu.push_back(cpu);
+
+    return rv;
+}
+
+template <>
+const CacheLocality& CacheLocality::system<std::atomic>()
+{
+    static CacheLocality *cache =
+        new CacheLocality(uniform(sysconf(_SC_NPROCESSORS_CONF)));
+
+    return *cache;
+}
+
+Getcpu::Func Getcpu::resolveVdsoFunc()
+{
+    void *h = dlopen("linux-vdso.so.1", RTLD_LAZY | RTLD_LOCAL | RTLD_NOLOAD);
+
+    return h ? Getcpu::Func(dlsym(h, "__vdso_getcpu")) : nullptr;
+}
+
+#ifdef FOLLY_TLS
+template struct SequentialThreadId<std::atomic>;
+#endif
+template struct AccessSpreader<std::atomic>;
+
+AtomicStruct<std::chrono::steady_clock::duration>
+MemoryIdler::defaultIdleTimeout(std::chrono::seconds(5));
+
+void MemoryIdler::flushLocalMallocCaches() { }
+
+void MemoryIdler::unmapUnusedStack(size_t retain) { }
+
+} // namespace detail
+} // namespace folly
@@ -0,0 +1,68 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <stdlib.h>
+#include <string.h>
+#include "histogram.h"
+
+static inline uint64_t hist_value(unsigned index)
+{
+    unsigned shift;
+
+    if(index < 2*HIST_SUB_COUNT)
+        return index;
+
+    shift = index/HIST_SUB_COUNT - 1;
+    return (((uint64_t)(index % HIST_SUB_COUNT + HIST_SUB_COUNT + 1)) << shift) - 1;
+}
+
+hist_t *hist_alloc(void)
+{
+    hist_t *h = (hist_t *)calloc(1, sizeof(hist_t));
+
+    if(h)
+        h->min = UINT64_MAX;
+
+    return h;
+}
+
+void hist_free(hist_t *h)
+{
+    free(h);
+}
+
+void hist_merge(hist_t *dst, const hist_t *src)
+{
+    unsigned i;
+
+    for(i=0; i<HIST_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+
+    dst->count += src->count;
+
+    if(src->min < dst->min) dst->min = src->min;
+
+    if(src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const hist_t *h, double percentile)
+{
+    unsigned i;
+    uint64_t seen = 0, target;
+
+    if(h->count == 0)
+        return 0;
+
+    target = (uint64_t)(percentile / 100.0 * (double)h->count + 0.5);
+
+    if(target < 1) target = 1;
+
+    if(target > h->count) target = h->count;
+
+    for(i=0; i<HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+
+        if(seen >= target)
+            return hist_value(i) < h->max ? hist_value(i) : h->max;
+    }
+
+    return h->max;
+}
@@ -0,0 +1,60 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Log-linear (HDR style) histogram of 64 bit values.  Values below      */
+/* 2*HIST_SUB_COUNT are recorded exactly; above that every power of two  */
+/* is split into HIST_SUB_COUNT linear sub-buckets, which bounds the     */
+/* relative error of a reported value to 1/HIST_SUB_COUNT.               */
+/*                                                                       */
+/* A histogram has a single writer:  each consumer owns one and they are */
+/* merged once the run is over, so recording needs no atomics.           */
+#define HIST_SUB_BITS  5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS   ((65 - HIST_SUB_BITS) * HIST_SUB_COUNT)
+
+typedef struct hist_t {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[HIST_BUCKETS];
+} hist_t;
+
+static inline unsigned hist_index(uint64_t value)
+{
+    unsigned shift;
+
+    if(value < 2*HIST_SUB_COUNT)
+        return (unsigned)value;
+
+    shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+    return shift*HIST_SUB_COUNT + (unsigned)(value >> shift);
+}
+
+static inline void hist_record(hist_t *h, uint64_t value)
+{
+    h->buckets[hist_index(value)]++;
+    h->count++;
+
+    if(value < h->min) h->min = value;
+
+    if(value > h->max) h->max = value;
+}
+
+extern hist_t   *hist_alloc(void);
+extern void      hist_free(hist_t *h);
+extern void      hist_merge(hist_t *dst, const hist_t *src);
+/* Highest value equivalent to the bucket holding the given percentile */
+extern uint64_t  hist_percentile(const hist_t *h, double percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HISTOGRAM_H__ */
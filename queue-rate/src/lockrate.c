@@ -6,10 +6,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <pthread.h>
 #include <stdint.h>
-#include <sys/time.h>
 #include <ctype.h>
+#include "timing.h"
+#include "placement.h"
+#include "results.h"
+#include "backoff.h"
+#include "perfctr.h"
+#include "rng.h"
+#include "fc.h"
+/* The ConcurrencyFreaks locks wait as --backoff says; they yield by default */
+#define CF_WAIT(fails) backoff(BACKOFF_YIELD, &(fails))
 #include "ConcurrencyFreaks/C11/locks/clh_mutex.h"
 #include "ConcurrencyFreaks/C11/locks/mpsc_mutex.h"
 #include "ConcurrencyFreaks/C11/locks/tidex_mutex.h"
@@ -42,6 +51,7 @@ extern unsigned long urandom(int urandom_fd);
 #define TIDEX_LOCK       4
 #define TICKET_LOCK      5
 #define TIDEX_NPS_LOCK   6
+#define FC_LOCK          7
 
 //#define LOCK_METHOD PTHREAD
 //#define LOCK_METHOD PTHREAD_SPINLOCK
@@ -50,12 +60,15 @@ extern unsigned long urandom(int urandom_fd);
 //#define LOCK_METHOD TIDEX_LOCK
 //#define LOCK_METHOD TICKET_LOCK
 //#define LOCK_METHOD TIDEX_NPS_LOCK
+//#define LOCK_METHOD FC_LOCK
 
 pthread_barrier_t g_barrier;
 hwloc_topology_t  g_topo;
 pthread_mutex_t   g_mutex = PTHREAD_MUTEX_INITIALIZER;
 int               g_done;
 int               g_random_fd;
+double            g_tsc_per_nsec;
+int               g_nthreads;   /* producers and consumers, for FC_LOCK */
 
 #if LOCK_METHOD==PTHREAD_LOCK
 #define LOCK_PAD 64
@@ -69,10 +82,18 @@ static inline void lock_init(lock_t *lock)
     pthread_mutex_init(&lock->mutex,NULL);
 }
 
+/* Blocks in the kernel by default; any other --backoff spins on trylock */
 static inline void lock(lock_t *lock)
 {
-    pthread_mutex_lock(&lock->mutex);
+    unsigned fails = 0;
 
+    if(g_backoff == BACKOFF_DEFAULT) {
+        pthread_mutex_lock(&lock->mutex);
+        return;
+    }
+
+    while(pthread_mutex_trylock(&lock->mutex) != 0)
+        backoff(BACKOFF_NONE, &fails);
 }
 
 static inline void unlock(lock_t *lock)
@@ -92,10 +113,18 @@ static inline void lock_init(lock_t *lock)
     pthread_spin_init(&lock->mutex,0);
 }
 
+/* glibc's own spin by default; any other --backoff spins on trylock */
 static inline void lock(lock_t *lock)
 {
-    pthread_spin_lock(&lock->mutex);
+    unsigned fails = 0;
+
+    if(g_backoff == BACKOFF_DEFAULT) {
+        pthread_spin_lock(&lock->mutex);
+        return;
+    }
 
+    while(pthread_spin_trylock(&lock->mutex) != 0)
+        backoff(BACKOFF_NONE, &fails);
 }
 
 static inline void unlock(lock_t *lock)
@@ -218,6 +247,28 @@ static inline void unlock(lock_t *lock)
     tidex_nps_mutex_unlock(&lock->mutex);
 }
 
+#elif LOCK_METHOD==FC_LOCK
+/* Not a lock:  q_push and q_pop post to the queue's flat combiner,  */
+/* with a publication record per thread (t_fc_slot), and whichever   */
+/* thread holds the combiner lock runs the posted list operations    */
+#define LOCK_PAD 256
+#define MUTEX_NAME "Flat Combining"
+typedef struct lock_t {
+    fc_t fc;
+} lock_t;
+
+static inline void lock_init(lock_t *lock)
+{
+    fc_init(&lock->fc, g_nthreads);
+}
+
+#endif
+
+/* Whether this build is lockrate_fc, for the option checks */
+#if LOCK_METHOD==FC_LOCK
+#define LOCK_IS_FC 1
+#else
+#define LOCK_IS_FC 0
 #endif
 
 typedef struct thread_data_t {
@@ -228,6 +279,9 @@ typedef struct thread_data_t {
     int          messages_per_thread;
     int          total_messages;
     int          randomize;
+    uint64_t     waits;         /* failed attempts that went to backoff() */
+    perf_counters_t perf;       /* --perf hardware counters, timed region */
+    phase_t      phase;
 } thread_data_t;
 
 typedef struct q_node_t {
@@ -248,9 +302,9 @@ void q_create(q_t *self)
     lock_init(&self->lock);
 }
 
-void q_push(q_t *self, q_node_t *n)
+/* The list operations, serialized by the caller */
+static inline void q_push_locked(q_t *self, q_node_t *n)
 {
-    lock(&self->lock);
     n->next = NULL;
 
     if(self->head == NULL) {
@@ -260,21 +314,14 @@ void q_push(q_t *self, q_node_t *n)
         self->head->next = n;
         self->head = n;
     }
-
-    unlock(&self->lock);
-    return;
 }
 
-q_node_t *q_pop(q_t *self)
+static inline q_node_t *q_pop_locked(q_t *self)
 {
     q_node_t *rc;
 
-    lock(&self->lock);
-
-    if(self->tail == NULL) {
-        unlock(&self->lock);
+    if(self->tail == NULL)
         return NULL;
-    }
 
     rc = self->tail;
 
@@ -283,9 +330,49 @@ q_node_t *q_pop(q_t *self)
         self->tail = NULL;
     } else self->tail = self->tail->next;
 
+    return rc;
+}
+
+#if LOCK_METHOD==FC_LOCK
+enum { Q_PUSH = FC_OP, Q_POP };
+
+static void *q_exec(void *obj, int op, void *arg)
+{
+    if(op == Q_PUSH) {
+        q_push_locked((q_t *)obj, (q_node_t *)arg);
+        return NULL;
+    }
+
+    return q_pop_locked((q_t *)obj);
+}
+
+void q_push(q_t *self, q_node_t *n)
+{
+    fc_apply(&self->lock.fc, Q_PUSH, n, q_exec, self);
+}
+
+q_node_t *q_pop(q_t *self)
+{
+    return (q_node_t *)fc_apply(&self->lock.fc, Q_POP, NULL, q_exec, self);
+}
+#else
+void q_push(q_t *self, q_node_t *n)
+{
+    lock(&self->lock);
+    q_push_locked(self, n);
+    unlock(&self->lock);
+}
+
+q_node_t *q_pop(q_t *self)
+{
+    q_node_t *rc;
+
+    lock(&self->lock);
+    rc = q_pop_locked(self);
     unlock(&self->lock);
     return rc;
 }
+#endif
 
 q_t *Q;
 q_t *initQ(int nconsumers, int nproducers, int nmessages)
@@ -313,6 +400,8 @@ void *do_produce(void *clientdata)
     int            me     = tdata->index;
     int            q      = me % tdata->nconsumers;
     hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
+
+    t_fc_slot = me;
     hwloc_bitmap_zero(cpuset);
     hwloc_get_cpubind(g_topo, cpuset, HWLOC_CPUBIND_THREAD);
     hwloc_bitmap_asprintf(&str, cpuset);
@@ -332,13 +421,14 @@ void *do_produce(void *clientdata)
     work_node_t *nodes_tmp = NULL;
     work_node_t *nodes     = (work_node_t *)malloc(sizeof(work_node_t) * tdata->messages_per_thread);
     int         *permute   = (int *)malloc(sizeof(int) *tdata->nconsumers);
+    uint64_t     rng       = rng_seed(g_seed, 0, me);
 
     for(i=0; i<tdata->nconsumers; i++)
         permute[i]=i;
 
     for(i=0; i<tdata->nconsumers; i++) {
         int swapme, index;
-        index=urandom(g_random_fd)%tdata->nconsumers;
+        index=rng_below(&rng, tdata->nconsumers);
         swapme = permute[i];
         permute[i] = permute[index];
         permute[index] = swapme;
@@ -349,12 +439,15 @@ void *do_produce(void *clientdata)
         nodes[i].data = i+1;
     }
 
+    perf_open(&tdata->perf);
     /* Start Timer Barrier */
     pthread_barrier_wait(&g_barrier);
     pthread_barrier_wait(&g_barrier);
 
     /* End Timer Barrier */
     pthread_barrier_wait(&g_barrier);
+    perf_start(&tdata->perf);
+    uint64_t start = rdtsc();
     DEBUG_PRINT("Thread %d beginning, using q=%d\n", me,q);
 
     for(i = tdata->messages_per_thread-1; i >= 0; --i) {
@@ -365,6 +458,15 @@ void *do_produce(void *clientdata)
             q_push(&Q[q], &nodes[i].node);
     }
 
+    /* The producer never waits on an empty queue:  its whole loop is busy */
+    tdata->phase.start = start;
+    tdata->phase.stop  = rdtsc();
+    perf_stop(&tdata->perf);
+    tdata->phase.busy  = tdata->phase.stop - start;
+    tdata->phase.empty = 0;
+    tdata->phase.msgs  = tdata->messages_per_thread;
+    tdata->waits       = t_backoff_waits;
+
     DEBUG_PRINT("Thread %d finished producing!\n", nodes[i].id);
     hwloc_bitmap_free(cpuset);
     free(str);
@@ -402,12 +504,12 @@ void *do_consume(void *clientdata)
 {
     char *str;
     char *str1;
-    struct timeval ti, tf;
     int            i,me;
     hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
     thread_data_t *tdata = (thread_data_t *)clientdata;
     double         calls=0.0, sum=0.0;
     me = tdata->index;
+    t_fc_slot = tdata->nproducers + me;
 
     hwloc_bitmap_zero(cpuset);
     hwloc_get_cpubind(g_topo, cpuset, HWLOC_CPUBIND_THREAD);
@@ -425,42 +527,60 @@ void *do_consume(void *clientdata)
 
     }
 
+    perf_open(&tdata->perf);
     /* Start timer Barrier */
     pthread_barrier_wait(&g_barrier);
     pthread_barrier_wait(&g_barrier);
-    gettimeofday(&ti, NULL);
 
     /* End Timer Barrier */
     pthread_barrier_wait(&g_barrier);
+    perf_start(&tdata->perf);
+    uint64_t start = rdtsc(), last = start, now, busy = 0, empty = 0, msgs = 0;
+    unsigned fails = 0;
     int done = 0;
 
     while(!done) {
         work_node_t *node = (work_node_t *)q_pop(&Q[me]);
         sum++;
         calls++;
+        now = rdtsc();
 
         if(!node) {
+            empty += now - last;
+            last   = now;
+            backoff(BACKOFF_NONE, &fails);
             continue;
         }
 
+        fails = 0;
+
+        busy += now - last;
+        last  = now;
+
         DEBUG_PRINT("Consumer:  (tid=%d node data = %d pl=%d\n",
                     node->id, node->data, done);
 
         if(node->data == 0) {
             DEBUG_PRINT("Got 0 from node! assuming finished!\n");
             done = 1;
-        }
+        } else
+            msgs++;
     }
 
     DEBUG_PRINT("Consumer finished!\n");
-    gettimeofday(&tf, NULL);
+    perf_stop(&tdata->perf);
+    tdata->phase.start = start;
+    tdata->phase.stop  = last;
+    tdata->phase.busy  = busy;
+    tdata->phase.empty = empty;
+    tdata->phase.msgs  = msgs;
+    tdata->waits       = t_backoff_waits;
     /* End of job barrier for timing */
     pthread_barrier_wait(&g_barrier);
 
     /* End of job barrier for printing */
     pthread_barrier_wait(&g_barrier);
-    long usec = ((tf.tv_sec - ti.tv_sec)*1000000L+tf.tv_usec) - ti.tv_usec;
-    double usecF       = (double) usec;
+    double usecF       = (last - start) / g_tsc_per_nsec / 1000.0;
     double n_producers = (double) tdata->nproducers/tdata->nconsumers;
     double n_msgs      = (double) tdata->messages_per_thread*n_producers;
     printf("Consumer %03d:  n_msgs=%f in %f usec n_producers handled=%f:  mmsgs/s=%f mmsg/call=%f\n",
@@ -475,15 +595,96 @@ void *do_consume(void *clientdata)
 
 int main(int argc,char *argv[])
 {
-    struct timeval   ti, tf;
     pthread_attr_t   attr;
     cpu_set_t        cpus;
-    int              i, j, n, d, depth;
+    int              i, n, d, depth;
     hwloc_obj_t obj;
-    int c, nproducers = 0, nconsumers=0, nmessages=0, randomize=0;
-
-    while((c = getopt(argc, argv, "rp:c:m:")) != -1)
+    int c, nproducers = 0, nconsumers=0, nmessages=0, randomize=0, seeded=0, fc=0;
+    int              placement = PLACE_LEGACY;
+    const char      *json = NULL, *csv = NULL;
+
+    static struct option long_options[] = {
+        {"placement", required_argument, NULL, 'P'},
+        {"json",      required_argument, NULL, 'J'},
+        {"csv",       required_argument, NULL, 'C'},
+        {"backoff",   required_argument, NULL, 'B'},
+        {"perf",      no_argument,       NULL, 'F'},
+        {"perf-raw",  required_argument, NULL, 'H'},
+        {"seed",      required_argument, NULL, 'D'},
+        {"fc-passes", required_argument, NULL, 'A'},
+        {"fc-compact", required_argument, NULL, 'I'},
+        {"fc-wait",   required_argument, NULL, 'M'},
+        {NULL,        0,                 NULL, 0}
+    };
+
+    while((c = getopt_long(argc, argv, "rp:c:m:", long_options, NULL)) != -1)
         switch(c) {
+            case 'J':
+                json = optarg;
+                break;
+
+            case 'C':
+                csv = optarg;
+                break;
+
+            case 'F':
+                g_perf = 1;
+                break;
+
+            case 'D':
+                g_seed = strtoull(optarg, NULL, 0);
+                seeded = 1;
+                break;
+
+            case 'H':
+                g_perf     = 1;
+                g_perf_raw = strtoull(optarg, NULL, 16);
+                break;
+
+            case 'A':
+                g_fc_passes = atoi(optarg);
+                fc = 1;
+                break;
+
+            case 'I':
+                g_fc_compact = atoi(optarg);
+                fc = 1;
+                break;
+
+            case 'M':
+                g_fc_wait = fc_wait_lookup(optarg);
+                fc = 1;
+
+                if(g_fc_wait < 0) {
+                    fprintf(stderr, "Unknown fc wait `%s'.\n", optarg);
+                    fc_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'B':
+                g_backoff = backoff_lookup(optarg);
+
+                if(g_backoff < 0) {
+                    fprintf(stderr, "Unknown backoff `%s'.\n", optarg);
+                    backoff_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'P':
+                placement = placement_lookup(optarg);
+
+                if(placement < 0) {
+                    fprintf(stderr, "Unknown placement `%s'.\n", optarg);
+                    placement_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
             case 'r':
                 randomize = 1;
                 break;
@@ -523,8 +724,20 @@ int main(int argc,char *argv[])
         }
 
     if(nproducers < 1 || nconsumers < 1 || (nproducers < nconsumers) ||
-       nmessages < nconsumers) {
+       nmessages < nconsumers || (int)g_fc_passes < 1 || (int)g_fc_compact < 1) {
         fprintf(stderr, "Usage:  -p <num> -c <num> -m with (p <= c) and (m >= c)\n");
+        fprintf(stderr, "        --json <file>, --csv <file> append a results record to file\n");
+        backoff_usage(stderr);
+        perf_usage(stderr);
+        fprintf(stderr, "        --seed <num> seed the -r queue order, to replay a run\n");
+        fc_usage(stderr);
+        fprintf(stderr, "              (lockrate_fc only)\n");
+        placement_usage(stderr);
+        return 1;
+    }
+
+    if(fc && !LOCK_IS_FC) {
+        fprintf(stderr, "The --fc-* options are for lockrate_fc.\n");
         return 1;
     }
 
@@ -536,10 +749,20 @@ int main(int argc,char *argv[])
     int              total_messages      = messages_per_thread*nproducers;
     Q = initQ(nconsumers, nproducers, nmessages);
     g_random_fd = urandom_init();
+
+    if(!seeded)
+        g_seed = urandom(g_random_fd);
+
+    printf("Seed %llu\n", (unsigned long long)g_seed);
     printf("Starting %s queue with locks P:%d C:%d N:%d\n",
            MUTEX_NAME,nproducers, nconsumers,nmessages);
+#if LOCK_METHOD==FC_LOCK
+    printf("FC passes=%u compact=%u wait=%s\n",
+           g_fc_passes, g_fc_compact, fc_wait_name(g_fc_wait));
+#endif
     hwloc_topology_init(&g_topo);
     hwloc_topology_load(g_topo);
+    g_tsc_per_nsec = tsc_calibrate();
 
     depth=hwloc_topology_get_depth(g_topo);
 
@@ -573,14 +796,22 @@ int main(int argc,char *argv[])
 
     pthread_attr_init(&attr);
     pthread_barrier_init(&g_barrier, NULL, nproducers+nconsumers+1);
+    g_nthreads = nproducers+nconsumers;
 
     for(i=0; i < nconsumers; i++) {
         q_create(&Q[i]);
     }
 
-    for(i=0,j=1; i < nproducers; i++) {
+    hwloc_obj_t      producer_obj[nproducers];
+    hwloc_obj_t      consumer_obj[nconsumers];
+    placement_map(g_topo, placement, nproducers, nconsumers,
+                  producer_obj, consumer_obj);
+    placement_print(stdout, g_topo, placement, nproducers, nconsumers,
+                    producer_obj, consumer_obj);
+
+    for(i=0; i < nproducers; i++) {
         CPU_ZERO(&cpus);
-        obj = hwloc_get_obj_by_type(g_topo, HWLOC_OBJ_CORE, j);
+        obj = producer_obj[i];
         hwloc_cpuset_to_glibc_sched_affinity(g_topo,obj->cpuset,
                                              &cpus,sizeof(cpus));
         pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
@@ -599,14 +830,11 @@ int main(int argc,char *argv[])
         } else {
             DEBUG_PRINT("Spawned consumer thread %d\n", i);
         }
-
-        if(i<=(nconsumers-2)) j+=2;
-        else j+=1;
     }
 
-    for(i=0, j=0; i < nconsumers; i++,j+=2) {
+    for(i=0; i < nconsumers; i++) {
         CPU_ZERO(&cpus);
-        obj = hwloc_get_obj_by_type(g_topo, HWLOC_OBJ_CORE, j);
+        obj = consumer_obj[i];
         hwloc_cpuset_to_glibc_sched_affinity(g_topo,obj->cpuset,
                                              &cpus,sizeof(cpus));
         pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
@@ -635,14 +863,12 @@ int main(int argc,char *argv[])
     /* Start timer Barrier */
     pthread_barrier_wait(&g_barrier);
     pthread_barrier_wait(&g_barrier);
-    gettimeofday(&ti, NULL);
 
     /* End timer Barrier */
     pthread_barrier_wait(&g_barrier);
 
     /* End of job barrier for timing */
     pthread_barrier_wait(&g_barrier);
-    gettimeofday(&tf, NULL);
 
     /* End of job barrier for printing */
     pthread_barrier_wait(&g_barrier);
@@ -655,8 +881,20 @@ int main(int argc,char *argv[])
         pthread_join(consumers[i], NULL);
     }
 
-    long usec = ((tf.tv_sec - ti.tv_sec)*1000000L+tf.tv_usec) - ti.tv_usec;
-    double usecF       = (double) usec;
+    phase_summary_t phases;
+    phase_t         producer_phase[nproducers];
+    phase_t         consumer_phase[nconsumers];
+
+    for(i=0; i < nproducers; i++)
+        producer_phase[i] = producer_data[i].phase;
+
+    for(i=0; i < nconsumers; i++)
+        consumer_phase[i] = consumer_data[i].phase;
+
+    phase_summarize(&phases, producer_phase, nproducers,
+                    consumer_phase, nconsumers);
+
+    double usecF       = phases.window / g_tsc_per_nsec / 1000.0;
     double n_msgs      = (double) total_messages;
     double n_producers = (double) nproducers;
     printf("Time in microseconds: %f\n",usecF);
@@ -666,5 +904,111 @@ int main(int argc,char *argv[])
     printf("DATAOUT %d %d %d %f %f\n",
            nproducers,nconsumers,total_messages,
            n_msgs/usecF,n_msgs/usecF/n_producers);
+    phase_print(stdout, &phases, nproducers, nconsumers, total_messages,
+                g_tsc_per_nsec);
+
+    /* Failed lock attempts and empty polls per message, see qrate */
+    uint64_t prod_waits = 0, cons_waits = 0;
+
+    for(i=0; i < nproducers; i++)
+        prod_waits += producer_data[i].waits;
+
+    for(i=0; i < nconsumers; i++)
+        cons_waits += consumer_data[i].waits;
+
+    double prod_wpm = (double)prod_waits/total_messages;
+    double cons_wpm = (double)cons_waits/total_messages;
+    printf("Backoff %s: producer waits/msg=%.3f consumer waits/msg=%.3f\n",
+           backoff_name(g_backoff), prod_wpm, cons_wpm);
+    printf("BACKOFFOUT %d %d %d %f %f\n",
+           nproducers,nconsumers,total_messages,prod_wpm,cons_wpm);
+
+    /* --perf:  each role's counters, lock handoffs included */
+    perf_counters_t prod_perf, cons_perf;
+
+    perf_sum_init(&prod_perf);
+    perf_sum_init(&cons_perf);
+
+    for(i=0; i < nproducers; i++)
+        perf_sum(&prod_perf, &producer_data[i].perf);
+
+    for(i=0; i < nconsumers; i++)
+        perf_sum(&cons_perf, &consumer_data[i].perf);
+
+    perf_print(stdout, "producer", nproducers, nconsumers, &prod_perf, total_messages);
+    perf_print(stdout, "consumer", nproducers, nconsumers, &cons_perf, total_messages);
+
+#if LOCK_METHOD==FC_LOCK
+    /* How many operations a combiner ran per turn, and how often the */
+    /* others waited on it; empty pops and sentinels are operations   */
+    uint64_t fc_ops = 0, fc_combines = 0, fc_waits = 0;
+    int      j;
+
+    for(i=0; i < nconsumers; i++) {
+        fc_ops      += Q[i].lock.fc.ops;
+        fc_combines += Q[i].lock.fc.count;
+
+        for(j=0; j < Q[i].lock.fc.nrecs; j++)
+            fc_waits += Q[i].lock.fc.recs[j].waits;
+    }
+
+    double fc_opc = fc_combines ? (double)fc_ops/fc_combines : 0.0;
+    double fc_wpo = fc_ops ? (double)fc_waits/fc_ops : 0.0;
+    printf("FC %s: ops/combine=%.3f waits/op=%.3f\n",
+           fc_wait_name(g_fc_wait), fc_opc, fc_wpo);
+    printf("FCOUT %d %d %d %u %u %f %f\n", nproducers, nconsumers, total_messages,
+           g_fc_passes, g_fc_compact, fc_opc, fc_wpo);
+#endif
+
+    if(json || csv) {
+        result_t *res = result_new("lockrate");
+        double    consumer_rate[nconsumers];
+        char      seed[24];
+
+        snprintf(seed, sizeof(seed), "%llu", (unsigned long long)g_seed);
+
+        for(i=0; i < nconsumers; i++)
+            consumer_rate[i] = consumer_phase[i].msgs * g_tsc_per_nsec * 1000.0 /
+                               (consumer_phase[i].stop - consumer_phase[i].start);
+
+        result_str(res, "lock", MUTEX_NAME);
+        result_int(res, "producers", nproducers);
+        result_int(res, "consumers", nconsumers);
+        result_int(res, "messages", total_messages);
+        result_str(res, "placement", placement_name(placement));
+        result_str(res, "seed", seed);
+        result_int(res, "randomize", randomize);
+        result_num(res, "usec", usecF);
+        result_num(res, "mmsgs_per_sec", n_msgs/usecF);
+        result_num(res, "mmsgs_per_sec_per_producer", n_msgs/usecF/n_producers);
+        result_nums(res, "consumer_mmsgs_per_sec", consumer_rate, nconsumers);
+        result_num(res, "producer_cycles_per_msg", phases.prod_cpm);
+        result_num(res, "consumer_cycles_per_msg", phases.cons_cpm);
+        result_num(res, "consumer_empty_pct", phases.empty_pct);
+        result_num(res, "barrier_skew_nsec", phases.skew / g_tsc_per_nsec);
+        result_str(res, "backoff", backoff_name(g_backoff));
+        result_num(res, "producer_waits_per_msg", prod_wpm);
+        result_num(res, "consumer_waits_per_msg", cons_wpm);
+        perf_record(res, "producer", &prod_perf, total_messages);
+        perf_record(res, "consumer", &cons_perf, total_messages);
+#if LOCK_METHOD==FC_LOCK
+        result_int(res, "fc_passes", g_fc_passes);
+        result_int(res, "fc_compact", g_fc_compact);
+        result_str(res, "fc_wait", fc_wait_name(g_fc_wait));
+        result_num(res, "fc_ops_per_combine", fc_opc);
+        result_num(res, "fc_waits_per_op", fc_wpo);
+#endif
+        result_num(res, "tsc_ghz", g_tsc_per_nsec);
+        result_host(res, g_topo);
+
+        if(json)
+            result_write(res, json, RESULT_JSON);
+
+        if(csv)
+            result_write(res, csv, RESULT_CSV);
+
+        result_free(res);
+    }
+
     return 0;
 }
@@ -0,0 +1,91 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __MOODY_CAMEL_BLOCKING_QUEUE_H__
+#define __MOODY_CAMEL_BLOCKING_QUEUE_H__
+
+#include "concurrentqueue/blockingconcurrentqueue.h"         /* Moody Camel Blocking */
+/* ConcurrentQueue plus a semaphore that every enqueue signals, so a */
+/* consumer can sleep in wait_dequeue_bulk (--wait blocking)         */
+struct moody_camel_blocking_queue {
+    typedef moodycamel::BlockingConcurrentQueue<work_node_t *>                   Q_t;
+    typedef moodycamel::BlockingConcurrentQueue<work_node_t *>::producer_token_t producer_token_t;
+    typedef moodycamel::BlockingConcurrentQueue<work_node_t *>::consumer_token_t consumer_token_t;
+    enum { mpmc = 1 };      /* several consumers may share one queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    enum { bounded = 0 };   /* -Q is counted by the driver */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t(nmessages);
+        return q;
+    }
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        inQ.enqueue(token, &work);
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
+                               work_node_t            &work)
+    {
+        inQ.enqueue(&work);
+    }
+
+    /* Never refuses:  the driver keeps -Q for this queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+        return true;
+    }
+
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        inQ.enqueue_bulk(work, num);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        inQ.enqueue_bulk(token, work, num);
+    }
+
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        return inQ.try_dequeue_bulk(&head,num);
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return inQ.try_dequeue_bulk(tok,&head,num);
+    }
+};
+moody_camel_blocking_queue::Q_t **moody_camel_blocking_queue::Q;
+
+template<>
+struct queue_wait<moody_camel_blocking_queue> {
+    enum { native = 1 };
+
+    static inline int dequeue(moody_camel_blocking_queue::Q_t                &inQ,
+                              moody_camel_blocking_queue::consumer_token_t   &tok,
+                              work_node_t                                   *&head,
+                              int                                             num,
+                              long                                            usec)
+    {
+        return inQ.wait_dequeue_bulk_timed(tok, &head, num, usec);
+    }
+};
+
+#endif /* __MOODY_CAMEL_BLOCKING_QUEUE_H__ */
@@ -3,47 +3,152 @@
 #define __MOODY_CAMEL_QUEUE_H__
 
 #include "concurrentqueue/concurrentqueue.h"                 /* Moody Camel Queue    */
-#define QUEUE_NAME "Moody Camel Queue"
-typedef moodycamel::ConcurrentQueue<work_node_t *>                   Q_t;
-typedef moodycamel::ConcurrentQueue<work_node_t *>::producer_token_t producer_token_t;
-typedef moodycamel::ConcurrentQueue<work_node_t *>::consumer_token_t consumer_token_t;
-Q_t *Q;
-Q_t *initQ(int nconsumers, int nproducers, int nmessages)
-{
-    Q_t *arr = static_cast<Q_t *>(::operator new[](nconsumers*sizeof(Q_t)));
-
-    for(int i = 0; i < nconsumers; i++) {
-        ::new(arr+i) Q_t(nmessages);
-    }
-
-    return arr;
-}
-static inline void enqueue_tok(Q_t                    &inQ,
-                               const producer_token_t &token,
+#include "value_node.h"
+struct moody_camel_queue {
+    typedef moodycamel::ConcurrentQueue<work_node_t *>                   Q_t;
+    typedef moodycamel::ConcurrentQueue<work_node_t *>::producer_token_t producer_token_t;
+    typedef moodycamel::ConcurrentQueue<work_node_t *>::consumer_token_t consumer_token_t;
+    enum { mpmc = 1 };      /* several consumers may share one queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    enum { bounded = 0 };   /* -Q is counted by the driver */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t(nmessages);
+        return q;
+    }
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        inQ.enqueue(token, &work);
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
+                               work_node_t            &work)
+    {
+        inQ.enqueue(&work);
+    }
+
+    /* Never refuses:  the driver keeps -Q for this queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+        return true;
+    }
+
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        inQ.enqueue_bulk(work, num);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        inQ.enqueue_bulk(token, work, num);
+    }
+
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        return inQ.try_dequeue_bulk(&head,num);
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return inQ.try_dequeue_bulk(tok,&head,num);
+    }
+};
+moody_camel_queue::Q_t **moody_camel_queue::Q;
+
+/* By value (--by-value):  blocks of whole messages, and the bulk */
+/* calls copy straight between the nodes and the blocks           */
+template<int N>
+struct moody_camel_value_queue {
+    typedef moodycamel::ConcurrentQueue<value_node_t<N> >                   Q_t;
+    typedef typename moodycamel::ConcurrentQueue<value_node_t<N> >::producer_token_t producer_token_t;
+    typedef typename moodycamel::ConcurrentQueue<value_node_t<N> >::consumer_token_t consumer_token_t;
+    enum { mpmc = 1 };
+    enum { spsc = 0 };
+    enum { bounded = 0 };   /* -Q is counted by the driver */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t(nmessages);
+        return q;
+    }
+    static inline void thread_init(int index) { value_buffer<N>::init(); }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        inQ.enqueue(token, *reinterpret_cast<value_node_t<N> *>(&work));
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
                                work_node_t            &work)
-{
-    inQ.enqueue(token, &work);
-}
-
-static inline void enqueue(Q_t                    &inQ,
-                           work_node_t            &work)
-{
-    inQ.enqueue(&work);
-}
-
-static inline int try_dequeue_bulk(Q_t                     &inQ,
-                                   work_node_t            *&head,
-                                   int                     num)
-{
-    return inQ.try_dequeue_bulk(&head,num);
-}
-
-static inline int try_dequeue_bulk_tok(Q_t               &inQ,
-                                       consumer_token_t  &tok,
-                                       work_node_t      *&head,
-                                       int                num)
-{
-    return inQ.try_dequeue_bulk(tok,&head,num);
-}
+    {
+        inQ.enqueue(*reinterpret_cast<value_node_t<N> *>(&work));
+    }
+
+    /* Never refuses:  the driver keeps -Q for this queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+        return true;
+    }
+
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        inQ.enqueue_bulk(value_iter<N>(work), num);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        inQ.enqueue_bulk(token, value_iter<N>(work), num);
+    }
+
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        int n = inQ.try_dequeue_bulk(value_buffer<N>::buf,
+                                     num < VALUE_BULK ? num : VALUE_BULK);
+
+        return value_buffer<N>::hand_out(head, n);
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        int n = inQ.try_dequeue_bulk(tok, value_buffer<N>::buf,
+                                     num < VALUE_BULK ? num : VALUE_BULK);
+
+        return value_buffer<N>::hand_out(head, n);
+    }
+};
+template<int N> typename moody_camel_value_queue<N>::Q_t **moody_camel_value_queue<N>::Q;
 
 #endif /* __MOODY_CAMEL_QUEUE_H__ */
@@ -2,56 +2,94 @@
 #ifndef __NATSYS_Q_H__
 #define __NATSYS_Q_H__
 
+#include "backoff.h"
+/* Full and empty ring waits follow --backoff; they pause by default */
+#define NATSYS_WAIT(fails) backoff(BACKOFF_PAUSE, &(fails))
+/* and its lost CAS on the tail count under --queue-stats */
+#define NATSYS_STAT(event) QSTAT(event)
 #include "natsysq.h"                                         /* Natsys Q             */
-#define QUEUE_NAME "Natsys Queue"
-typedef LockFreeQueue<work_node_t,thr_id,10000000>   Q_t;
-class token_t { public: token_t(Q_t &q) {} };
-typedef token_t producer_token_t;
-typedef token_t consumer_token_t;
-Q_t *Q;
-Q_t *initQ(int nconsumers, int nproducers, int nmessages)
-{
-    Q_t *arr = static_cast<Q_t *>(::operator new[](nconsumers*sizeof(Q_t)));
+struct natsys_queue {
+    /* Q_SIZE must be a power of two:  slots are indexed with Q_SIZE-1 */
+    typedef LockFreeQueue<work_node_t,thr_id,(1UL<<23)>  Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 1 };      /* several consumers may share one queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    enum { bounded = 0 };   /* -Q is counted by the driver */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t(nproducers,nconsumers);
+        return q;
+    }
 
-    for(int i = 0; i < nconsumers; i++) {
-        ::new(arr+i) Q_t(nproducers,nconsumers);
+    /* ThrPos slots in LockFreeQueue are indexed by a per-thread id:     */
+    /* producers use the head and consumers the tail of their own slot   */
+    static inline void thread_init(int index)
+    {
+        set_thr_id(index);
     }
 
-    return arr;
-}
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        inQ.push(&work);
+    }
 
-static inline void enqueue_tok(Q_t                    &inQ,
-                               const producer_token_t &token,
+    static inline void enqueue(Q_t                    &inQ,
                                work_node_t            &work)
-{
-    inQ.push(&work);
-}
-
-static inline void enqueue(Q_t                    &inQ,
-                           work_node_t            &work)
-{
-    inQ.push(&work);
-}
-
-static inline int try_dequeue_bulk(Q_t                     &inQ,
-                                   work_node_t            *&head,
-                                   int                     num)
-{
-    head = inQ.pop();
-
-    if(head) return 1;
-    else return 0;
-}
-
-static inline int try_dequeue_bulk_tok(Q_t               &inQ,
-                                       consumer_token_t  &tok,
-                                       work_node_t      *&head,
-                                       int                num)
-{
-    head = inQ.pop();
-
-    if(head) return 1;
-    else return 0;
-}
+    {
+        inQ.push(&work);
+    }
+
+    /* Never refuses:  the driver keeps -Q for this queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+        return true;
+    }
+
+    /* One fetch-and-add on the head reserves the whole batch */
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        inQ.push_bulk(work, num);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    /* Claim up to num filled slots with a single CAS on the tail */
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        work_node_t **out = &head;
+        int           n   = 0;
+
+        n = inQ.pop_bulk(out, num);
+
+        return n;
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
+    }
+};
+natsys_queue::Q_t **natsys_queue::Q;
 
 #endif /* __NATSYS_Q_H__ */
@@ -0,0 +1,231 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __PARKING_H__
+#define __PARKING_H__
+
+/* ------------------------------------------------------------------- */
+/* Consumer parking (--wait).  By default a consumer spins on an empty */
+/* queue; the other modes put it to sleep until a producer wakes it:   */
+/*                                                                     */
+/*   spin        poll try_dequeue_bulk, the original behaviour         */
+/*   futex       folly::detail::Futex sequence word                    */
+/*   eventcount  folly::EventCount prepareWait/wait, notify per send   */
+/*   lifosem     folly::LifoSem, posted once per park                  */
+/*   blocking    the queue's own blocking dequeue (-q mcblock)         */
+/*                                                                     */
+/* futex and lifosem keep a sleeping flag next to the consumer's       */
+/* queue.  The consumer raises it, fences and looks at the queue once  */
+/* more before it sleeps; a producer fences after its enqueue and only */
+/* pays for a wake when it finds the flag up, and the one that clears  */
+/* it does the wake.  One parker_t per consumer queue.                 */
+/* ------------------------------------------------------------------- */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <folly/detail/Futex.h>
+#include <folly/experimental/EventCount.h>
+#include <folly/LifoSem.h>
+
+typedef enum wait_t {
+    WAIT_SPIN,
+    WAIT_FUTEX,
+    WAIT_EVENTCOUNT,
+    WAIT_LIFOSEM,
+    WAIT_BLOCKING,
+    WAIT_COUNT
+} wait_t;
+
+static const char *g_wait_names[WAIT_COUNT] = {
+    "spin", "futex", "eventcount", "lifosem", "blocking"
+};
+
+struct parker_t {
+    std::atomic<int>                      sleeping;
+    folly::detail::Futex<std::atomic>     futex;
+    folly::EventCount                     ec;
+    folly::LifoSem                        sem;
+};
+
+static inline int wait_lookup(const char *name)
+{
+    for(int i = 0; i < WAIT_COUNT; i++)
+        if(strcmp(g_wait_names[i], name) == 0)
+            return i;
+
+    return -1;
+}
+
+static inline void wait_usage(FILE *out)
+{
+    fprintf(out, "        --wait <mode> consumers on an empty queue, one of:");
+
+    for(int i = 0; i < WAIT_COUNT; i++)
+        fprintf(out, " %s", g_wait_names[i]);
+
+    fprintf(out, "\n");
+}
+
+/* LifoSem wants more alignment than operator new gives in C++11 */
+static inline parker_t *parkers_new(int n)
+{
+    void *mem;
+
+    if(posix_memalign(&mem, 128, sizeof(parker_t) * n) != 0)
+        abort();
+
+    parker_t *p = static_cast<parker_t *>(mem);
+
+    for(int i = 0; i < n; i++) {
+        ::new(&p[i]) parker_t();
+        p[i].sleeping.store(0, std::memory_order_relaxed);
+        p[i].futex.store(0, std::memory_order_relaxed);
+    }
+
+    return p;
+}
+
+static inline void parkers_free(parker_t *p, int n)
+{
+    for(int i = 0; i < n; i++)
+        p[i].~parker_t();
+
+    free(p);
+}
+
+/* Producer side, after every enqueue call into p's queue */
+static inline void park_notify(parker_t *p, int wait)
+{
+    switch(wait) {
+        case WAIT_FUTEX:
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if(p->sleeping.load(std::memory_order_relaxed) &&
+               p->sleeping.exchange(0)) {
+                p->futex.fetch_add(1);
+                p->futex.futexWake(1);
+            }
+
+            break;
+
+        case WAIT_EVENTCOUNT:
+            p->ec.notify();
+            break;
+
+        case WAIT_LIFOSEM:
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if(p->sleeping.load(std::memory_order_relaxed) &&
+               p->sleeping.exchange(0))
+                p->sem.post();
+
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Unconditional wake, for the end of a run and for --timeout */
+static inline void park_wake(parker_t *p, int wait)
+{
+    switch(wait) {
+        case WAIT_FUTEX:
+            p->futex.fetch_add(1);
+            p->futex.futexWake();
+            break;
+
+        case WAIT_EVENTCOUNT:
+            p->ec.notifyAll();
+            break;
+
+        case WAIT_LIFOSEM:
+            p->sem.post();
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* ------------------------------------------------------------------- */
+/* Consumer side.  Returns what try_dequeue_bulk returned on the last  */
+/* look at the queue, and sets *slept when the thread actually went to */
+/* sleep.  park_wake() gets a consumer out of the parker's own waits;  */
+/* the queue's blocking dequeue gives up after usec instead, so that   */
+/* the consumer still notices --timeout.                               */
+/* ------------------------------------------------------------------- */
+template<class A>
+static inline int park(parker_t                     *p,
+                       int                           wait,
+                       typename A::Q_t              &inQ,
+                       typename A::consumer_token_t &tok,
+                       work_node_t                 *&head,
+                       int                           num,
+                       long                          usec,
+                       int                          *slept)
+{
+    int n;
+
+    *slept = 0;
+
+    switch(wait) {
+        case WAIT_FUTEX: {
+            uint32_t seq = p->futex.load(std::memory_order_acquire);
+
+            p->sleeping.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if((n = A::try_dequeue_bulk_tok(inQ, tok, head, num)) != 0) {
+                p->sleeping.store(0, std::memory_order_relaxed);
+                return n;
+            }
+
+            *slept = 1;
+            p->futex.futexWait(seq);
+            p->sleeping.store(0, std::memory_order_relaxed);
+            break;
+        }
+
+        case WAIT_EVENTCOUNT: {
+            folly::EventCount::Key key = p->ec.prepareWait();
+
+            if((n = A::try_dequeue_bulk_tok(inQ, tok, head, num)) != 0) {
+                p->ec.cancelWait();
+                return n;
+            }
+
+            *slept = 1;
+            p->ec.wait(key);
+            break;
+        }
+
+        case WAIT_LIFOSEM:
+            p->sleeping.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if((n = A::try_dequeue_bulk_tok(inQ, tok, head, num)) != 0) {
+                /* A producer took the flag:  its post is on the way */
+                if(!p->sleeping.exchange(0))
+                    p->sem.wait();
+
+                return n;
+            }
+
+            *slept = 1;
+            p->sem.wait();
+            p->sleeping.store(0, std::memory_order_relaxed);
+            break;
+
+        case WAIT_BLOCKING:
+            *slept = 1;
+            return queue_wait<A>::dequeue(inQ, tok, head, num, usec);
+
+        default:
+            return 0;
+    }
+
+    return A::try_dequeue_bulk_tok(inQ, tok, head, num);
+}
+
+#endif /* __PARKING_H__ */
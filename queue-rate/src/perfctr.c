@@ -0,0 +1,204 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfctr.h"
+
+int      g_perf;
+uint64_t g_perf_raw;
+
+static const char *g_perf_names[PERF_NEVENTS] = {
+    "cycles", "instructions", "llc_misses", "node_misses",
+    "branch_misses", "context_switches", "raw"
+};
+
+/* Warn once per run of the driver, not once per thread */
+static int g_perf_warned;
+
+void perf_usage(FILE *out)
+{
+    fprintf(out, "        --perf count cycles, instructions, LLC and remote node misses, branch\n");
+    fprintf(out, "              misses and context switches per thread, reported per message\n");
+    fprintf(out, "        --perf-raw <hex> also count a raw, model specific event (e.g. HITM)\n");
+}
+
+static void perf_attr(int event, struct perf_event_attr *attr)
+{
+    memset(attr, 0, sizeof(*attr));
+    attr->size        = sizeof(*attr);
+    attr->disabled    = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                        PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch(event) {
+        case PERF_CYCLES:
+            attr->type   = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+
+        case PERF_INSTRUCTIONS:
+            attr->type   = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+
+        case PERF_LLC_MISSES:
+            attr->type   = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+
+        case PERF_NODE_MISSES:
+            attr->type   = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_NODE |
+                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+
+        case PERF_BRANCH_MISSES:
+            attr->type   = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+
+        case PERF_CTX_SWITCHES:
+            attr->type   = PERF_TYPE_SOFTWARE;
+            attr->config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+            break;
+
+        case PERF_RAW:
+            attr->type   = PERF_TYPE_RAW;
+            attr->config = g_perf_raw;
+            break;
+    }
+}
+
+void perf_open(perf_counters_t *pc)
+{
+    struct perf_event_attr attr;
+    int                    i;
+
+    memset(pc, 0, sizeof(*pc));
+
+    for(i = 0; i < PERF_NEVENTS; i++) {
+        pc->fd[i] = -1;
+
+        if(!g_perf || (i == PERF_RAW && !g_perf_raw))
+            continue;
+
+        perf_attr(i, &attr);
+        /* This thread, on whatever CPU it runs */
+        pc->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+        if(pc->fd[i] < 0 && !__atomic_exchange_n(&g_perf_warned, 1, __ATOMIC_RELAXED))
+            fprintf(stderr, "perf: %s not available, see "
+                    "/proc/sys/kernel/perf_event_paranoid\n", g_perf_names[i]);
+    }
+}
+
+void perf_start(perf_counters_t *pc)
+{
+    int i;
+
+    for(i = 0; i < PERF_NEVENTS; i++)
+        if(pc->fd[i] >= 0) {
+            ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+}
+
+void perf_stop(perf_counters_t *pc)
+{
+    uint64_t buf[3];    /* value, time enabled, time running */
+    int      i;
+
+    for(i = 0; i < PERF_NEVENTS; i++)
+        if(pc->fd[i] >= 0)
+            ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for(i = 0; i < PERF_NEVENTS; i++) {
+        if(pc->fd[i] < 0)
+            continue;
+
+        if(read(pc->fd[i], buf, sizeof(buf)) == sizeof(buf) && buf[2] > 0) {
+            pc->value[i] = buf[2] < buf[1] ?
+                           (uint64_t)((double)buf[0] * buf[1] / buf[2]) : buf[0];
+            pc->valid   |= 1U << i;
+        }
+
+        close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+}
+
+void perf_sum_init(perf_counters_t *sum)
+{
+    int i;
+
+    memset(sum, 0, sizeof(*sum));
+    sum->valid = (1U << PERF_NEVENTS) - 1;
+
+    for(i = 0; i < PERF_NEVENTS; i++)
+        sum->fd[i] = -1;
+}
+
+void perf_sum(perf_counters_t *sum, const perf_counters_t *pc)
+{
+    int i;
+
+    for(i = 0; i < PERF_NEVENTS; i++)
+        sum->value[i] += pc->value[i];
+
+    sum->valid &= pc->valid;
+}
+
+static double perf_per_msg(const perf_counters_t *sum, int event, uint64_t msgs)
+{
+    if(!(sum->valid & (1U << event)) || msgs == 0)
+        return NAN;
+
+    return (double)sum->value[event] / msgs;
+}
+
+void perf_print(FILE *out, const char *role, int p, int c,
+                const perf_counters_t *sum, uint64_t msgs)
+{
+    double v[PERF_NEVENTS];
+    int    i;
+
+    if(!g_perf)
+        return;
+
+    for(i = 0; i < PERF_NEVENTS; i++)
+        v[i] = perf_per_msg(sum, i, msgs);
+
+    fprintf(out, "Perf %s per msg: cycles=%.1f instructions=%.1f ipc=%.2f "
+            "llc_misses=%.3f node_misses=%.3f branch_misses=%.3f "
+            "context_switches=%.5f raw=%.3f\n", role,
+            v[PERF_CYCLES], v[PERF_INSTRUCTIONS],
+            v[PERF_INSTRUCTIONS] / v[PERF_CYCLES],
+            v[PERF_LLC_MISSES], v[PERF_NODE_MISSES], v[PERF_BRANCH_MISSES],
+            v[PERF_CTX_SWITCHES], v[PERF_RAW]);
+    fprintf(out, "PERFOUT %s %d %d %lu %f %f %f %f %f %f %f\n", role, p, c,
+            (unsigned long)msgs, v[PERF_CYCLES], v[PERF_INSTRUCTIONS],
+            v[PERF_LLC_MISSES], v[PERF_NODE_MISSES], v[PERF_BRANCH_MISSES],
+            v[PERF_CTX_SWITCHES], v[PERF_RAW]);
+}
+
+void perf_record(result_t *res, const char *role,
+                 const perf_counters_t *sum, uint64_t msgs)
+{
+    char key[64];
+    int  i;
+
+    if(!g_perf)
+        return;
+
+    for(i = 0; i < PERF_NEVENTS; i++) {
+        if(i == PERF_RAW && !g_perf_raw)
+            continue;
+
+        snprintf(key, sizeof(key), "%s_%s_per_msg", role, g_perf_names[i]);
+        result_num(res, key, perf_per_msg(sum, i, msgs));
+    }
+}
@@ -0,0 +1,74 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __PERFCTR_H__
+#define __PERFCTR_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "results.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Hardware counters per thread (--perf), read with perf_event_open    */
+/* around each thread's timed region and summed per role, so a slow    */
+/* queue shows where its cycles went:                                   */
+/*                                                                      */
+/*   cycles, instructions     IPC of the hot loop                       */
+/*   llc_misses               last level cache misses                   */
+/*   node_misses              loads served by another NUMA node         */
+/*   branch_misses            mispredicted branches                     */
+/*   context_switches         the thread was descheduled                */
+/*   raw                      --perf-raw <config>, a model specific     */
+/*                            event such as HITM loads (the snoop that   */
+/*                            false sharing causes), when given          */
+/*                                                                      */
+/* Every event is opened on its own, so one the kernel or the CPU does  */
+/* not have is reported as unavailable instead of failing the run, and  */
+/* counts are scaled by time enabled / time running when multiplexed.   */
+typedef enum perf_event_t {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_NODE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_CTX_SWITCHES,
+    PERF_RAW,
+    PERF_NEVENTS
+} perf_event_t;
+
+typedef struct perf_counters_t {
+    int      fd[PERF_NEVENTS];
+    uint64_t value[PERF_NEVENTS];
+    unsigned valid;             /* bit per event that was counted */
+} perf_counters_t;
+
+/* Set once from --perf and --perf-raw */
+extern int      g_perf;
+extern uint64_t g_perf_raw;
+
+extern void perf_usage(FILE *out);
+
+/* Open the calling thread's counters, disabled; a no-op without --perf */
+extern void perf_open(perf_counters_t *pc);
+/* Reset and enable as the timed region starts */
+extern void perf_start(perf_counters_t *pc);
+/* Disable, read and close as it ends */
+extern void perf_stop(perf_counters_t *pc);
+/* Add pc into sum; an event stays valid only if it was in both */
+extern void perf_sum(perf_counters_t *sum, const perf_counters_t *pc);
+/* Zeroed sum with every event valid, for perf_sum */
+extern void perf_sum_init(perf_counters_t *sum);
+
+/* "Perf <role>: ..." and a PERFOUT line, per message */
+extern void perf_print(FILE *out, const char *role, int p, int c,
+                       const perf_counters_t *sum, uint64_t msgs);
+/* <role>_<event>_per_msg fields, NaN for unavailable events */
+extern void perf_record(result_t *res, const char *role,
+                        const perf_counters_t *sum, uint64_t msgs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PERFCTR_H__ */
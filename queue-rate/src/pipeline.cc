@@ -0,0 +1,982 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <hwloc.h>
+#include <hwloc/glibc-sched.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <new>
+#include <type_traits>
+#include "timing.h"
+#include "placement.h"
+#include "histogram.h"
+#include "results.h"
+#include "backoff.h"
+#include "service.h"
+#include "perfctr.h"
+#include "rng.h"
+/* ------------------------------------------------------------------- */
+/* Multi-stage pipeline.  Stage 0 threads generate messages, every     */
+/* later stage takes them from the hop (queue) in front of it, runs    */
+/* its --work model on each and passes them on through the next hop,   */
+/* and the last stage retires them:                                    */
+/*                                                                     */
+/*   stage 0  --hop 0-->  stage 1  --hop 1-->  ...  --> stage S-1      */
+/*                                                                     */
+/* Each hop has its own -q backend.  sharded hops have one queue per   */
+/* thread of the stage after them, shared hops one MPMC queue for all  */
+/* of them.  Senders move to another of the hop's queues after every   */
+/* batch, in turn or (-r) at random.                                   */
+/*                                                                     */
+/* -q mpmcpipeline runs every hop in one folly::MPMCPipeline instead:  */
+/* its hops are shared, and each message leaves a stage in the order   */
+/* it entered the pipeline, whichever thread worked on it.             */
+/*                                                                     */
+/* Hops are called through function pointers, once per batch, so that */
+/* every stage can use a different backend without instantiating each  */
+/* combination; stage threads dequeue up to PIPE_BULK nodes a call.    */
+/* ------------------------------------------------------------------- */
+#define PIPE_STAGES_MAX    8
+#define PIPE_BULK          256
+/* Hops of the largest folly::MPMCPipeline built (-q mpmcpipeline) */
+#define PIPE_FOLLY_HOPS    4
+/* How often main samples the hops' depth */
+#define PIPE_SAMPLE_USEC   1000
+
+//#define DEBUG
+extern "C" {
+extern int urandom_init();
+extern unsigned long urandom(int urandom_fd);
+}
+
+#ifdef DEBUG
+#define DEBUG_PRINT(...) do{ fprintf( stderr, __VA_ARGS__ ); } while( 0 )
+#else
+#define DEBUG_PRINT(...) do{ } while ( 0 )
+#endif
+
+typedef struct work_node_t {
+    work_node_t *next;
+    int          id;
+    int          data;
+    uint64_t     ts;            /* rdtsc() as stage 0 sent it */
+    char pad[64-sizeof(work_node_t *) -
+             sizeof(int)              -
+             sizeof(int)              -
+             sizeof(uint64_t)];
+} work_node_t;
+
+/* One per thread, a cache line apart:  received and sent are polled */
+/* by the thread's siblings and by main while it runs                */
+typedef struct thread_data_t {
+    int          stage;
+    int          index;         /* within its stage                       */
+    hwloc_obj_t  obj;
+    int          messages_per_thread;   /* stage 0 only                   */
+    int          batch;
+    int          randomize;
+    volatile uint64_t received; /* messages taken from the hop in front   */
+    volatile uint64_t sent;     /* messages passed to the next hop        */
+    uint64_t     work_cycles;   /* cycles of synthetic work (--work)      */
+    uint64_t     waits;         /* failed attempts that went to backoff() */
+    hist_t      *hist;          /* last stage:  end-to-end latency        */
+    perf_counters_t perf;       /* --perf hardware counters, timed region */
+    phase_t      phase;
+} __attribute__((aligned(64))) thread_data_t;
+
+/* One queue hop between two stages */
+typedef struct hop_t {
+    const char  *name;
+    void       (*thread_init)(int index);
+    void       (*send)(int q, work_node_t **nodes, int n);
+    int        (*recv)(int q, work_node_t **nodes, int n);
+    int          base;          /* first of the hop's queues in its backend */
+    int          nqueues;       /* one per receiving thread, or 1 if shared */
+} hop_t;
+
+pthread_barrier_t g_barrier;
+hwloc_topology_t  g_topo;
+int               g_random_fd;
+double            g_tsc_per_nsec;
+int               g_nstages;
+int               g_threads[PIPE_STAGES_MAX];
+hop_t             g_hops[PIPE_STAGES_MAX-1];
+service_t         g_work[PIPE_STAGES_MAX];  /* --work, per stage after 0 */
+thread_data_t    *g_stage_data[PIPE_STAGES_MAX];
+uint64_t          g_total;
+
+#include "queues.h"
+
+/* ------------------------------------------------------------------- */
+/* Hops over the -q backends of queues.h                               */
+/* ------------------------------------------------------------------- */
+template<class A>
+static void hop_send(int q, work_node_t **nodes, int n)
+{
+    if(n == 1)
+        A::enqueue(*A::Q[q], *nodes[0]);
+    else
+        A::enqueue_bulk(*A::Q[q], nodes, n);
+}
+
+template<class A>
+static int hop_recv(int q, work_node_t **nodes, int n)
+{
+    return A::try_dequeue_bulk(*A::Q[q], nodes[0], n);
+}
+
+typedef struct hop_entry_t {
+    const char  *name;
+    int          mpmc;
+    int          spsc;
+    void       (*init)(int nqueues);
+    void       (*create)(int index, int nconsumers, int nproducers, int nmessages);
+    void       (*destroy)(int nqueues);
+    void       (*thread_init)(int index);
+    void       (*send)(int q, work_node_t **nodes, int n);
+    int        (*recv)(int q, work_node_t **nodes, int n);
+} hop_entry_t;
+
+#define HOP_ENTRY(name, adapter, description)                         \
+    { #name, adapter::mpmc, adapter::spsc, init_queues<adapter>,      \
+      create_queue<adapter>, destroy_queues<adapter>,                 \
+      adapter::thread_init, hop_send<adapter>, hop_recv<adapter> },
+
+static const hop_entry_t g_hop_entries[] = {
+    QUEUE_LIST(HOP_ENTRY)
+};
+#define N_HOP_ENTRIES ((int)(sizeof(g_hop_entries)/sizeof(g_hop_entries[0])))
+
+/* ------------------------------------------------------------------- */
+/* Every hop in one folly::MPMCPipeline (-q mpmcpipeline).  A stage    */
+/* keeps the ticket of each node it reads and writes the node to the   */
+/* next hop with it, which puts it back in pipeline order.             */
+/* ------------------------------------------------------------------- */
+#include "folly/MPMCPipeline.h"
+
+/* MPMCPipeline<work_node_t *, ...> with N stages after the input */
+template<int N, class... T>
+struct pipe_type {
+    typedef typename pipe_type<N-1, work_node_t *, T...>::type type;
+};
+
+template<class... T>
+struct pipe_type<0, T...> {
+    typedef folly::MPMCPipeline<work_node_t *, T...> type;
+};
+
+template<int H>
+struct folly_pipeline {
+    typedef typename pipe_type<H-1>::type P_t;
+    static P_t *P;
+
+    /* The tickets of a thread's last readStage<S> batch */
+    template<int S>
+    static typename P_t::template Ticket<S> *tickets()
+    {
+        static thread_local typename P_t::template Ticket<S> t[PIPE_BULK];
+        return t;
+    }
+
+    /* Hop 0:  stage 0 writes into the first queue */
+    static void send(std::integral_constant<int, 0>, work_node_t **nodes, int n)
+    {
+        unsigned fails = 0;
+
+        for(int i = 0; i < n; i++)
+            while(!P->write(nodes[i]))
+                backoff(BACKOFF_PAUSE, &fails);
+    }
+
+    template<int h>
+    static void send(std::integral_constant<int, h>, work_node_t **nodes, int n)
+    {
+        typename P_t::template Ticket<h-1> *t = tickets<h-1>();
+
+        for(int i = 0; i < n; i++)
+            P->template blockingWriteStage<h-1>(t[i], nodes[i]);
+    }
+
+    /* The last hop is read without tickets */
+    template<int h>
+    static int recv(std::true_type, work_node_t **nodes, int n)
+    {
+        int k = 0;
+
+        while(k < n && P->read(nodes[k]))
+            k++;
+
+        return k;
+    }
+
+    template<int h>
+    static int recv(std::false_type, work_node_t **nodes, int n)
+    {
+        typename P_t::template Ticket<h> *t = tickets<h>();
+        int                               k = 0;
+
+        while(k < n && P->template readStage<h>(t[k], nodes[k]))
+            k++;
+
+        return k;
+    }
+
+    template<int h>
+    static void hop_send(int q, work_node_t **nodes, int n)
+    {
+        send(std::integral_constant<int, h>(), nodes, n);
+    }
+
+    template<int h>
+    static int hop_recv(int q, work_node_t **nodes, int n)
+    {
+        return recv<h>(std::integral_constant<bool, h == H-1>(), nodes, n);
+    }
+
+    /* One capacity per hop.  The pipeline pads its stages to cache  */
+    /* lines and asks for more alignment than new gives under C++11 */
+    template<class... S>
+    static P_t *build(std::integral_constant<int, 0>, size_t capacity, S... sizes)
+    {
+        void *p;
+
+        if(posix_memalign(&p, alignof(P_t), sizeof(P_t)) != 0)
+            abort();
+
+        return ::new(p) P_t(sizes...);
+    }
+
+    template<int N, class... S>
+    static P_t *build(std::integral_constant<int, N>, size_t capacity, S... sizes)
+    {
+        return build(std::integral_constant<int, N-1>(), capacity, capacity, sizes...);
+    }
+
+    static void fill(std::integral_constant<int, H>, hop_t *hops) { }
+
+    static void thread_init(int index) { }
+
+    template<int h>
+    static void fill(std::integral_constant<int, h>, hop_t *hops)
+    {
+        hops[h].thread_init = thread_init;
+        hops[h].send        = hop_send<h>;
+        hops[h].recv        = hop_recv<h>;
+        fill(std::integral_constant<int, h+1>(), hops);
+    }
+
+    static void create(hop_t *hops, size_t capacity)
+    {
+        P = build(std::integral_constant<int, H>(), capacity);
+        fill(std::integral_constant<int, 0>(), hops);
+    }
+
+    static void destroy()
+    {
+        P->~P_t();
+        free(P);
+        P = NULL;
+    }
+};
+template<int H> typename folly_pipeline<H>::P_t *folly_pipeline<H>::P;
+
+typedef struct folly_pipeline_entry_t {
+    void       (*create)(hop_t *hops, size_t capacity);
+    void       (*destroy)(void);
+} folly_pipeline_entry_t;
+
+/* Indexed by hops - 1 */
+static const folly_pipeline_entry_t g_folly_pipelines[PIPE_FOLLY_HOPS] = {
+    { folly_pipeline<1>::create, folly_pipeline<1>::destroy },
+    { folly_pipeline<2>::create, folly_pipeline<2>::destroy },
+    { folly_pipeline<3>::create, folly_pipeline<3>::destroy },
+    { folly_pipeline<4>::create, folly_pipeline<4>::destroy },
+};
+
+/* ------------------------------------------------------------------- */
+/* Stage threads                                                       */
+/* ------------------------------------------------------------------- */
+
+/* Messages the threads of stage g have received so far */
+static uint64_t stage_received(int g)
+{
+    uint64_t sum = 0;
+
+    for(int i = 0; i < g_threads[g]; i++)
+        sum += __atomic_load_n(&g_stage_data[g][i].received, __ATOMIC_ACQUIRE);
+
+    return sum;
+}
+
+static uint64_t stage_sent(int g)
+{
+    uint64_t sum = 0;
+
+    for(int i = 0; i < g_threads[g]; i++)
+        sum += __atomic_load_n(&g_stage_data[g][i].sent, __ATOMIC_ACQUIRE);
+
+    return sum;
+}
+
+/* The hop queue to send the next batch to */
+static inline int next_queue(const hop_t *hop, int q, int randomize,
+                             uint64_t *rng)
+{
+    if(hop->nqueues == 1)
+        return 0;
+
+    if(randomize)
+        return rng_below(rng, hop->nqueues);
+
+    return q+1 == hop->nqueues ? 0 : q+1;
+}
+
+static void start_barrier(void)
+{
+    /* Start Timer Barrier */
+    pthread_barrier_wait(&g_barrier);
+    pthread_barrier_wait(&g_barrier);
+
+    /* End Timer Barrier */
+    pthread_barrier_wait(&g_barrier);
+}
+
+static void *source_thread(void *clientdata)
+{
+    thread_data_t *tdata = (thread_data_t *)clientdata;
+    const hop_t   *out   = &g_hops[0];
+    int            me    = tdata->index, i, k;
+    uint64_t       rng   = rng_seed(g_seed, 0, me);
+    int            q     = me % out->nqueues;
+    work_node_t   *nodes = (work_node_t *)malloc(sizeof(work_node_t) * tdata->messages_per_thread);
+    work_node_t  **batch = (work_node_t **)malloc(sizeof(work_node_t *) * tdata->batch);
+
+    for(i = 0; i < tdata->messages_per_thread; i++) {
+        nodes[i].id   = me;
+        nodes[i].data = i+1;
+    }
+
+    out->thread_init(me);
+    perf_open(&tdata->perf);
+    start_barrier();
+    perf_start(&tdata->perf);
+    uint64_t start = rdtsc(), sent = 0;
+    t_backoff_waits = 0;
+
+    for(i = 0; i < tdata->messages_per_thread; i += k) {
+        uint64_t now = rdtsc();
+
+        for(k = 0; k < tdata->batch && i+k < tdata->messages_per_thread; k++) {
+            nodes[i+k].ts = now;
+            batch[k]      = &nodes[i+k];
+        }
+
+        out->send(out->base + q, batch, k);
+        sent += k;
+        __atomic_store_n(&tdata->sent, sent, __ATOMIC_RELEASE);
+        q = next_queue(out, q, tdata->randomize, &rng);
+    }
+
+    /* Stage 0 never waits on an empty hop:  its whole loop is busy */
+    tdata->phase.start = start;
+    tdata->phase.stop  = rdtsc();
+    perf_stop(&tdata->perf);
+    tdata->phase.busy  = tdata->phase.stop - start;
+    tdata->phase.empty = 0;
+    tdata->phase.msgs  = sent;
+    tdata->waits       = t_backoff_waits;
+
+    /* The last stage still holds pointers into nodes */
+    pthread_barrier_wait(&g_barrier);
+    free(batch);
+    free(nodes);
+    return NULL;
+}
+
+static void *stage_thread(void *clientdata)
+{
+    thread_data_t *tdata = (thread_data_t *)clientdata;
+    int            g     = tdata->stage, me = tdata->index, i, n;
+    const hop_t   *in    = &g_hops[g-1];
+    const hop_t   *out   = g+1 < g_nstages ? &g_hops[g] : NULL;
+    int            qin   = in->base + (in->nqueues == 1 ? 0 : me);
+    int            q     = out ? me % out->nqueues : 0;
+    work_node_t   *node[PIPE_BULK];
+
+    in->thread_init(me);
+
+    if(out)
+        out->thread_init(me);
+
+    perf_open(&tdata->perf);
+    start_barrier();
+    perf_start(&tdata->perf);
+    uint64_t start = rdtsc(), last = start, busy = 0, empty = 0, msgs = 0;
+    uint64_t rng = rng_seed(g_seed, g, me), work = 0, sent = 0;
+    unsigned fails = 0;
+    t_backoff_waits = 0;
+
+    for(;;) {
+        n = in->recv(qin, node, PIPE_BULK);
+
+        if(n == 0) {
+            /* Only an empty hop needs the siblings' counts */
+            if(stage_received(g) >= g_total)
+                break;
+
+            backoff(BACKOFF_NONE, &fails);
+            uint64_t now = rdtsc();
+            empty += now - last;
+            last   = now;
+            continue;
+        }
+
+        fails = 0;
+        msgs += n;
+        __atomic_store_n(&tdata->received, msgs, __ATOMIC_RELEASE);
+
+        for(i = 0; i < n; i++)
+            work += service_run(&g_work[g], NULL, &rng);
+
+        uint64_t now = rdtsc();
+
+        if(out) {
+            out->send(out->base + q, node, n);
+            sent += n;
+            __atomic_store_n(&tdata->sent, sent, __ATOMIC_RELEASE);
+            q = next_queue(out, q, tdata->randomize, &rng);
+            now = rdtsc();
+        } else {
+            for(i = 0; i < n; i++)
+                hist_record(tdata->hist, now - node[i]->ts);
+        }
+
+        busy += now - last;
+        last  = now;
+    }
+
+    perf_stop(&tdata->perf);
+    tdata->phase.start = start;
+    tdata->phase.stop  = last;
+    tdata->phase.busy  = busy;
+    tdata->phase.empty = empty;
+    tdata->phase.msgs  = msgs;
+    tdata->work_cycles = work;
+    tdata->waits       = t_backoff_waits;
+
+    pthread_barrier_wait(&g_barrier);
+    return NULL;
+}
+
+/* Split a,b,c into at most max strings; returns how many */
+static int split_list(char *list, char **item, int max)
+{
+    int   n = 0;
+    char *save, *s;
+
+    for(s = strtok_r(list, ",", &save); s; s = strtok_r(NULL, ",", &save)) {
+        if(n == max)
+            return -1;
+
+        item[n++] = s;
+    }
+
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    int              c, i, g, nstages = 0, nhops, nthreads = 0;
+    int              nqueue_names = 0, nwork = 0, batch = 1, randomize = 0;
+    int              shared = 0, seeded = 0, folly_pipe = 0;
+    long             nmessages = 0;
+    int              placement = PLACE_LEGACY;
+    const char      *json = NULL, *csv = NULL;
+    char            *queue_name[PIPE_STAGES_MAX], *work_name[PIPE_STAGES_MAX];
+    char            *thread_list = NULL, *queue_list = NULL, *work_list = NULL;
+    char             queues[256] = "", works[256] = "", name[64];
+    const hop_entry_t *entry[PIPE_STAGES_MAX-1];
+    int              slots[N_HOP_ENTRIES];  /* queues of each backend */
+
+    static struct option long_options[] = {
+        {"placement", required_argument, NULL, 'P'},
+        {"json",      required_argument, NULL, 'J'},
+        {"csv",       required_argument, NULL, 'C'},
+        {"backoff",   required_argument, NULL, 'B'},
+        {"topology",  required_argument, NULL, 'O'},
+        {"work",      required_argument, NULL, 'X'},
+        {"perf",      no_argument,       NULL, 'F'},
+        {"perf-raw",  required_argument, NULL, 'H'},
+        {"seed",      required_argument, NULL, 'D'},
+        {NULL,        0,                 NULL, 0}
+    };
+
+    while((c = getopt_long(argc, argv, "rq:t:m:b:", long_options, NULL)) != -1)
+        switch(c) {
+            case 'J':
+                json = optarg;
+                break;
+
+            case 'C':
+                csv = optarg;
+                break;
+
+            case 'O':
+                if(strcmp(optarg, "shared") == 0)
+                    shared = 1;
+                else if(strcmp(optarg, "sharded") == 0)
+                    shared = 0;
+                else {
+                    fprintf(stderr, "Unknown topology `%s'.\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            case 'X':
+                work_list = optarg;
+                break;
+
+            case 'F':
+                g_perf = 1;
+                break;
+
+            case 'H':
+                g_perf     = 1;
+                g_perf_raw = strtoull(optarg, NULL, 16);
+                break;
+
+            case 'D':
+                g_seed = strtoull(optarg, NULL, 0);
+                seeded = 1;
+                break;
+
+            case 'B':
+                g_backoff = backoff_lookup(optarg);
+
+                if(g_backoff < 0) {
+                    fprintf(stderr, "Unknown backoff `%s'.\n", optarg);
+                    backoff_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'P':
+                placement = placement_lookup(optarg);
+
+                if(placement < 0) {
+                    fprintf(stderr, "Unknown placement `%s'.\n", optarg);
+                    placement_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'r':
+                randomize = 1;
+                break;
+
+            case 'q':
+                queue_list = optarg;
+                break;
+
+            case 't':
+                thread_list = optarg;
+                break;
+
+            case 'm':
+                nmessages = atol(optarg);
+                break;
+
+            case 'b':
+                batch = atoi(optarg);
+                break;
+
+            case '?':
+                return 1;
+
+            default:
+                abort();
+        }
+
+    /* -t 2,4,1:  threads per stage, which also sets how many stages */
+    if(thread_list) {
+        char *item[PIPE_STAGES_MAX];
+
+        nstages = split_list(thread_list, item, PIPE_STAGES_MAX);
+
+        for(g = 0; g < nstages; g++) {
+            g_threads[g] = atoi(item[g]);
+
+            if(g_threads[g] < 1)
+                nstages = -1;
+            else
+                nthreads += g_threads[g];
+        }
+    }
+
+    nhops = nstages - 1;
+
+    /* -q folly,mc:  backend per hop, the last one for the hops after it */
+    if(queue_list) {
+        snprintf(queues, sizeof(queues), "%s", queue_list);
+        nqueue_names = split_list(queue_list, queue_name, PIPE_STAGES_MAX-1);
+        folly_pipe   = nqueue_names == 1 && strcmp(queue_name[0], "mpmcpipeline") == 0;
+    }
+
+    for(g = 0; g < nhops && nqueue_names > 0 && !folly_pipe; g++) {
+        const char *q = queue_name[g < nqueue_names ? g : nqueue_names-1];
+
+        entry[g] = NULL;
+
+        for(i = 0; i < N_HOP_ENTRIES; i++)
+            if(strcmp(g_hop_entries[i].name, q) == 0)
+                entry[g] = &g_hop_entries[i];
+
+        if(!entry[g]) {
+            fprintf(stderr, "Unknown queue `%s'.\n", q);
+            nqueue_names = 0;
+        }
+    }
+
+    /* --work fixed:500,exp:2000:  model per stage after 0, likewise */
+    if(work_list) {
+        snprintf(works, sizeof(works), "%s", work_list);
+        nwork = split_list(work_list, work_name, PIPE_STAGES_MAX-1);
+
+        for(i = 0; i < nwork; i++)
+            if(service_parse(work_name[i], &g_work[i+1]) < 0 ||
+               g_work[i+1].kind == SERVICE_TOUCH) {
+                fprintf(stderr, "Unknown work model `%s'.\n", work_name[i]);
+                service_usage(stderr);
+                return 1;
+            }
+    } else
+        snprintf(works, sizeof(works), "none");
+
+    for(g = nwork+1; g < nstages && nwork > 0; g++)
+        g_work[g] = g_work[nwork];
+
+    int invalid = nstages < 2 || nqueue_names < 1 || nqueue_names > nhops ||
+                  nmessages < g_threads[0] || batch < 1 || batch > PIPE_BULK ||
+                  (folly_pipe && nhops > PIPE_FOLLY_HOPS);
+
+    for(g = 0; g < nhops && !invalid && !folly_pipe; g++)
+        invalid = (entry[g]->spsc && (g_threads[g] > 1 || g_threads[g+1] > 1)) ||
+                  (shared && !entry[g]->mpmc && g_threads[g+1] > 1);
+
+    if(invalid) {
+        fprintf(stderr, "Usage:  -t <threads>,<threads>[,...] -q <queue>[,...] -m <messages>\n");
+        fprintf(stderr, "        -t threads of each stage, 2 to %d stages; stage 0 sends, the last\n", PIPE_STAGES_MAX);
+        fprintf(stderr, "              stage retires messages, the others pass them on\n");
+        fprintf(stderr, "        -q backend of each hop between two stages, the last one repeats:\n");
+        fprintf(stderr, "              mpmcpipeline (alone, up to %d hops)", PIPE_FOLLY_HOPS);
+
+        for(i = 0; i < N_HOP_ENTRIES; i++)
+            fprintf(stderr, " %s", g_hop_entries[i].name);
+
+        fprintf(stderr, "\n");
+        fprintf(stderr, "              the SPSC queues (pcq, spsc) need one thread on each side\n");
+        fprintf(stderr, "        -m <num> messages, split over the threads of stage 0\n");
+        fprintf(stderr, "        -b <num> stage 0 sends batches of num messages (up to %d)\n", PIPE_BULK);
+        fprintf(stderr, "        -r senders pick the next queue of a hop at random, not in turn\n");
+        fprintf(stderr, "        --topology <sharded|shared> a queue per receiving thread, or one MPMC\n");
+        fprintf(stderr, "              queue per hop; mpmcpipeline is always shared\n");
+        fprintf(stderr, "        --work <model>[,...] service model of each stage after 0, the last\n");
+        fprintf(stderr, "              one repeats:  none, fixed:<cycles> or exp:<cycles>\n");
+        fprintf(stderr, "        --json <file>, --csv <file> append a results record to file\n");
+        backoff_usage(stderr);
+        perf_usage(stderr);
+        fprintf(stderr, "        --seed <num> seed the -r queue choices and the work draws\n");
+        placement_usage(stderr);
+        return 1;
+    }
+
+    if(folly_pipe)
+        shared = 1;
+
+    g_nstages = nstages;
+    g_total   = (nmessages / g_threads[0]) * g_threads[0];
+
+    /* Lay every hop's queues out in its backend's Q array */
+    if(folly_pipe) {
+        for(g = 0; g < nhops; g++) {
+            g_hops[g].name    = "mpmcpipeline";
+            g_hops[g].base    = 0;
+            g_hops[g].nqueues = 1;
+        }
+
+        g_folly_pipelines[nhops-1].create(g_hops, g_total);
+    } else {
+        memset(slots, 0, sizeof(slots));
+
+        for(g = 0; g < nhops; g++) {
+            int e = entry[g] - g_hop_entries;
+
+            g_hops[g].name        = entry[g]->name;
+            g_hops[g].thread_init = entry[g]->thread_init;
+            g_hops[g].send        = entry[g]->send;
+            g_hops[g].recv        = entry[g]->recv;
+            g_hops[g].nqueues     = shared ? 1 : g_threads[g+1];
+            g_hops[g].base        = slots[e];
+            slots[e]             += g_hops[g].nqueues;
+        }
+
+        for(i = 0; i < N_HOP_ENTRIES; i++)
+            if(slots[i])
+                g_hop_entries[i].init(slots[i]);
+
+        for(g = 0; g < nhops; g++)
+            for(i = 0; i < g_hops[g].nqueues; i++)
+                entry[g]->create(g_hops[g].base + i, g_threads[g+1], g_threads[g], g_total);
+    }
+
+    g_random_fd = urandom_init();
+
+    if(!seeded)
+        g_seed = urandom(g_random_fd);
+
+    printf("Seed %llu\n", (unsigned long long)g_seed);
+    hwloc_topology_init(&g_topo);
+    hwloc_topology_load(g_topo);
+    g_tsc_per_nsec = tsc_calibrate();
+
+    /* Stage 0 is placed as the producers, every later stage as consumers */
+    hwloc_obj_t      source_obj[g_threads[0]];
+    hwloc_obj_t      stage_obj[nthreads - g_threads[0]];
+    thread_data_t    data[nthreads];
+    pthread_t        threads[nthreads];
+    pthread_attr_t   attr;
+    cpu_set_t        cpus;
+
+    placement_map(g_topo, placement, g_threads[0], nthreads - g_threads[0],
+                  source_obj, stage_obj);
+    placement_print(stdout, g_topo, placement, g_threads[0], nthreads - g_threads[0],
+                    source_obj, stage_obj);
+
+    pthread_attr_init(&attr);
+    pthread_barrier_init(&g_barrier, NULL, nthreads+1);
+    memset(data, 0, sizeof(data));
+
+    for(g = 0, c = 0; g < nstages; g++) {
+        g_stage_data[g] = &data[c];
+
+        for(i = 0; i < g_threads[g]; i++, c++) {
+            hwloc_obj_t obj = g == 0 ? source_obj[i] : stage_obj[c - g_threads[0]];
+
+            CPU_ZERO(&cpus);
+            hwloc_cpuset_to_glibc_sched_affinity(g_topo, obj->cpuset,
+                                                 &cpus, sizeof(cpus));
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
+            data[c].stage               = g;
+            data[c].index               = i;
+            data[c].obj                 = obj;
+            data[c].messages_per_thread = g_total / g_threads[0];
+            data[c].batch               = batch;
+            data[c].randomize           = randomize;
+            data[c].hist                = g == nstages-1 ? hist_alloc() : NULL;
+
+            if(pthread_create(&threads[c], &attr,
+                              g == 0 ? source_thread : stage_thread, &data[c]) != 0)
+                exit(1);
+        }
+    }
+
+    start_barrier();
+
+    /* Sample how many messages wait in (or are being handed over by) */
+    /* each hop until the last stage has them all                     */
+    double   depth_sum[nhops];
+    uint64_t depth_max[nhops], samples = 0;
+
+    memset(depth_sum, 0, sizeof(depth_sum));
+    memset(depth_max, 0, sizeof(depth_max));
+
+    while(stage_received(nstages-1) < g_total) {
+        struct timespec ts = { 0, PIPE_SAMPLE_USEC * 1000L };
+
+        nanosleep(&ts, NULL);
+
+        for(g = 0; g < nhops; g++) {
+            uint64_t out = stage_sent(g), in = stage_received(g+1);
+            uint64_t d   = out > in ? out - in : 0;
+
+            depth_sum[g] += d;
+
+            if(d > depth_max[g])
+                depth_max[g] = d;
+        }
+
+        samples++;
+    }
+
+    /* End of job barrier, then the sources free their nodes */
+    pthread_barrier_wait(&g_barrier);
+
+    for(i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    /* End to end:  first send of stage 0 to last retire of the last stage */
+    uint64_t first = UINT64_MAX, lastt = 0;
+
+    for(i = 0; i < nthreads; i++) {
+        if(data[i].stage == 0 && data[i].phase.start < first)
+            first = data[i].phase.start;
+
+        if(data[i].stage == nstages-1 && data[i].phase.stop > lastt)
+            lastt = data[i].phase.stop;
+    }
+
+    double usecF  = (lastt - first) / g_tsc_per_nsec / 1000.0;
+    double n_msgs = (double) g_total;
+    double mmsgs  = n_msgs/usecF;
+
+    printf("Pipeline %s: stages=%d threads=%d n_msgs=%lu in %f usec:  mmsgs/s=%f\n",
+           queues, nstages, nthreads, (unsigned long)g_total, usecF, mmsgs);
+    printf("DATAOUT %d %d %lu %f\n", nstages, nthreads, (unsigned long)g_total, mmsgs);
+
+    /* Per stage:  how busy its threads were, and the rate they could */
+    /* keep up if they were never starved.  The stage with the lowest */
+    /* such rate is the one that bounds the pipeline.                 */
+    double busy_pct[nstages], cpm[nstages], capacity[nstages], wpm[nstages];
+    double threads_of[nstages];
+    int    bottleneck = 0;
+
+    for(g = 0; g < nstages; g++) {
+        uint64_t busy = 0, empty = 0, msgs = 0, work = 0;
+
+        for(i = 0; i < g_threads[g]; i++) {
+            busy  += g_stage_data[g][i].phase.busy;
+            empty += g_stage_data[g][i].phase.empty;
+            msgs  += g_stage_data[g][i].phase.msgs;
+            work  += g_stage_data[g][i].work_cycles;
+        }
+
+        threads_of[g] = g_threads[g];
+        busy_pct[g]   = busy+empty ? 100.0*busy/(busy+empty) : NAN;
+        cpm[g]        = msgs ? (double)busy/msgs : NAN;
+        wpm[g]        = msgs ? (double)work/msgs : NAN;
+        capacity[g]   = busy ? g_threads[g] * msgs * g_tsc_per_nsec * 1000.0 / busy : NAN;
+
+        if(capacity[g] < capacity[bottleneck])
+            bottleneck = g;
+
+        printf("Stage %d: threads=%d msgs=%lu busy=%.1f%% cycles/msg=%.1f "
+               "work cycles/msg=%.1f capacity mmsgs/s=%.3f\n",
+               g, g_threads[g], (unsigned long)msgs, busy_pct[g], cpm[g],
+               wpm[g], capacity[g]);
+        printf("STAGEOUT %d %d %lu %f %f %f\n", g, g_threads[g],
+               (unsigned long)msgs, busy_pct[g], cpm[g], capacity[g]);
+    }
+
+    double mean_depth[nhops], max_depth[nhops];
+
+    for(g = 0; g < nhops; g++) {
+        mean_depth[g] = samples ? depth_sum[g]/samples : NAN;
+        max_depth[g]  = depth_max[g];
+        printf("Hop %d (%s, %d queue%s): mean depth=%.1f max depth=%lu\n",
+               g, g_hops[g].name, g_hops[g].nqueues,
+               g_hops[g].nqueues > 1 ? "s" : "", mean_depth[g],
+               (unsigned long)depth_max[g]);
+        printf("HOPOUT %d %s %f %lu\n", g, g_hops[g].name, mean_depth[g],
+               (unsigned long)depth_max[g]);
+    }
+
+    printf("Bottleneck: stage %d\n", bottleneck);
+
+    hist_t *hist = hist_alloc();
+    double  lat[5];
+
+    for(i = 0; i < g_threads[nstages-1]; i++) {
+        hist_merge(hist, g_stage_data[nstages-1][i].hist);
+        hist_free(g_stage_data[nstages-1][i].hist);
+    }
+
+    lat[0] = hist_percentile(hist, 50.0)/g_tsc_per_nsec;
+    lat[1] = hist_percentile(hist, 90.0)/g_tsc_per_nsec;
+    lat[2] = hist_percentile(hist, 99.0)/g_tsc_per_nsec;
+    lat[3] = hist_percentile(hist, 99.9)/g_tsc_per_nsec;
+    lat[4] = hist->max/g_tsc_per_nsec;
+    printf("Latency (nsec): n=%lu p50=%.0f p90=%.0f p99=%.0f p99.9=%.0f max=%.0f\n",
+           (unsigned long)hist->count, lat[0], lat[1], lat[2], lat[3], lat[4]);
+    printf("LATOUT %d %d %lu %f %f %f %f %f\n", nstages, nthreads,
+           (unsigned long)g_total, lat[0], lat[1], lat[2], lat[3], lat[4]);
+    hist_free(hist);
+
+    perf_counters_t perf[nstages];
+
+    for(g = 0; g < nstages; g++) {
+        perf_sum_init(&perf[g]);
+
+        for(i = 0; i < g_threads[g]; i++)
+            perf_sum(&perf[g], &g_stage_data[g][i].perf);
+
+        snprintf(name, sizeof(name), "stage%d", g);
+        perf_print(stdout, name, g, g_threads[g], &perf[g], g_total);
+    }
+
+    if(json || csv) {
+        result_t *res = result_new("pipeline");
+        char      seed[24];
+
+        snprintf(seed, sizeof(seed), "%llu", (unsigned long long)g_seed);
+        result_str(res, "queues", queues);
+        result_int(res, "stages", nstages);
+        result_nums(res, "stage_threads", threads_of, nstages);
+        result_int(res, "messages", g_total);
+        result_str(res, "placement", placement_name(placement));
+        result_str(res, "seed", seed);
+        result_str(res, "topology", shared ? "shared" : "sharded");
+        result_int(res, "batch", batch);
+        result_int(res, "randomize", randomize);
+        result_str(res, "work", works);
+        result_num(res, "usec", usecF);
+        result_num(res, "mmsgs_per_sec", mmsgs);
+        result_nums(res, "stage_busy_pct", busy_pct, nstages);
+        result_nums(res, "stage_cycles_per_msg", cpm, nstages);
+        result_nums(res, "stage_work_cycles_per_msg", wpm, nstages);
+        result_nums(res, "stage_capacity_mmsgs_per_sec", capacity, nstages);
+        result_nums(res, "hop_mean_depth", mean_depth, nhops);
+        result_nums(res, "hop_max_depth", max_depth, nhops);
+        result_int(res, "bottleneck_stage", bottleneck);
+        result_num(res, "latency_p50_nsec", lat[0]);
+        result_num(res, "latency_p90_nsec", lat[1]);
+        result_num(res, "latency_p99_nsec", lat[2]);
+        result_num(res, "latency_p999_nsec", lat[3]);
+        result_num(res, "latency_max_nsec", lat[4]);
+        result_str(res, "backoff", backoff_name(g_backoff));
+
+        for(g = 0; g < nstages; g++) {
+            snprintf(name, sizeof(name), "stage%d", g);
+            perf_record(res, name, &perf[g], g_total);
+        }
+
+        result_num(res, "tsc_ghz", g_tsc_per_nsec);
+        result_host(res, g_topo);
+
+        if(json)
+            result_write(res, json, RESULT_JSON);
+
+        if(csv)
+            result_write(res, csv, RESULT_CSV);
+
+        result_free(res);
+    }
+
+    if(folly_pipe)
+        g_folly_pipelines[nhops-1].destroy();
+    else
+        for(i = 0; i < N_HOP_ENTRIES; i++)
+            if(slots[i])
+                g_hop_entries[i].destroy(slots[i]);
+
+    pthread_barrier_destroy(&g_barrier);
+    hwloc_topology_destroy(g_topo);
+    return 0;
+}
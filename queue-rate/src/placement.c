@@ -0,0 +1,225 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <stdlib.h>
+#include <string.h>
+#include "placement.h"
+
+static const char *g_placement_names[PLACE_COUNT] = {
+    "legacy", "compact", "scatter", "l3pair", "xsocket", "smt"
+};
+
+int placement_lookup(const char *name)
+{
+    int i;
+
+    for(i = 0; i < PLACE_COUNT; i++)
+        if(strcmp(g_placement_names[i], name) == 0)
+            return i;
+
+    return -1;
+}
+
+const char *placement_name(int policy)
+{
+    return g_placement_names[policy];
+}
+
+void placement_usage(FILE *out)
+{
+    int i;
+
+    fprintf(out, "        --placement <policy> one of:");
+
+    for(i = 0; i < PLACE_COUNT; i++)
+        fprintf(out, " %s", g_placement_names[i]);
+
+    fprintf(out, "\n");
+}
+
+/* Depth of the L3 level, or of the sockets when there is no single one */
+static int l3_depth(hwloc_topology_t topo)
+{
+    int depth = hwloc_get_cache_type_depth(topo, 3, (hwloc_obj_cache_type_t)-1);
+
+    if(depth < 0)
+        depth = hwloc_get_type_or_above_depth(topo, HWLOC_OBJ_SOCKET);
+
+    return depth;
+}
+
+/* Least used unit (core or PU) inside a domain, in topology order */
+static hwloc_obj_t pick(hwloc_topology_t topo, hwloc_obj_t dom,
+                        int udepth, int *used)
+{
+    hwloc_obj_t obj = NULL, best = NULL;
+
+    while((obj = hwloc_get_next_obj_inside_cpuset_by_depth(topo, dom->cpuset,
+                                                           udepth, obj)) != NULL)
+        if(!best || used[obj->logical_index] < used[best->logical_index])
+            best = obj;
+
+    if(best)
+        used[best->logical_index]++;
+
+    return best;
+}
+
+static void map_legacy(hwloc_topology_t topo, int nproducers, int nconsumers,
+                       hwloc_obj_t *prod, hwloc_obj_t *cons)
+{
+    int i, j, ncores = hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_CORE);
+
+    for(i=0,j=1; i < nproducers; i++) {
+        prod[i] = hwloc_get_obj_by_type(topo, HWLOC_OBJ_CORE, j % ncores);
+
+        if(i<=(nconsumers-2)) j+=2;
+        else j+=1;
+    }
+
+    for(i=0, j=0; i < nconsumers; i++,j+=2)
+        cons[i] = hwloc_get_obj_by_type(topo, HWLOC_OBJ_CORE, j % ncores);
+}
+
+void placement_map(hwloc_topology_t topo, int policy,
+                   int nproducers, int nconsumers,
+                   hwloc_obj_t *prod, hwloc_obj_t *cons)
+{
+    int udepth, ddepth, ndom, i, j, t = 0;
+    int *used;
+
+    if(policy == PLACE_LEGACY) {
+        map_legacy(topo, nproducers, nconsumers, prod, cons);
+        return;
+    }
+
+    switch(policy) {
+        case PLACE_SCATTER:
+        case PLACE_XSOCKET:
+            ddepth = hwloc_get_type_or_above_depth(topo, HWLOC_OBJ_SOCKET);
+            break;
+
+        case PLACE_L3PAIR:
+            ddepth = l3_depth(topo);
+            break;
+
+        case PLACE_SMT:
+            ddepth = hwloc_get_type_or_above_depth(topo, HWLOC_OBJ_CORE);
+            break;
+
+        default:
+            ddepth = 0;
+            break;
+    }
+
+    if(policy == PLACE_SMT)
+        udepth = hwloc_get_type_depth(topo, HWLOC_OBJ_PU);
+    else
+        udepth = hwloc_get_type_or_below_depth(topo, HWLOC_OBJ_CORE);
+
+    ndom = hwloc_get_nbobjs_by_depth(topo, ddepth);
+    used = (int *)calloc(hwloc_get_nbobjs_by_depth(topo, udepth), sizeof(int));
+
+    /* Each consumer first, then the producers that feed it */
+    for(j = 0; j < nconsumers; j++) {
+        int dom = policy == PLACE_SCATTER ? t++ % ndom :
+                  policy == PLACE_COMPACT ? 0 : j % ndom;
+
+        cons[j] = pick(topo, hwloc_get_obj_by_depth(topo, ddepth, dom),
+                       udepth, used);
+
+        for(i = j; i < nproducers; i += nconsumers) {
+            int pdom = dom;
+
+            if(policy == PLACE_SCATTER)
+                pdom = t++ % ndom;
+            else if(policy == PLACE_XSOCKET)
+                pdom = (dom + 1) % ndom;
+
+            prod[i] = pick(topo, hwloc_get_obj_by_depth(topo, ddepth, pdom),
+                           udepth, used);
+        }
+    }
+
+    free(used);
+}
+
+int placement_node(hwloc_topology_t topo, hwloc_obj_t obj)
+{
+    int node = hwloc_bitmap_first(obj->nodeset);
+
+    return node < 0 ? 0 : node;
+}
+
+int placement_membind(hwloc_topology_t topo, hwloc_obj_t obj)
+{
+#if HWLOC_API_VERSION >= 0x00020000
+    return hwloc_set_membind(topo, obj->nodeset, HWLOC_MEMBIND_BIND,
+                             HWLOC_MEMBIND_THREAD | HWLOC_MEMBIND_BYNODESET);
+#else
+    return hwloc_set_membind_nodeset(topo, obj->nodeset, HWLOC_MEMBIND_BIND,
+                                     HWLOC_MEMBIND_THREAD);
+#endif
+}
+
+static int ancestor_index(hwloc_topology_t topo, hwloc_obj_t obj, int depth)
+{
+    hwloc_obj_t a;
+
+    if(depth < 0)
+        return -1;
+
+    if((int)obj->depth == depth)
+        return obj->logical_index;
+
+    a = hwloc_get_ancestor_obj_by_depth(topo, depth, obj);
+    return a ? (int)a->logical_index : -1;
+}
+
+static void print_one(FILE *out, hwloc_topology_t topo, const char *role,
+                      int index, hwloc_obj_t obj, int l3)
+{
+    hwloc_obj_t pu = hwloc_get_obj_inside_cpuset_by_type(topo, obj->cpuset,
+                                                         HWLOC_OBJ_PU, 0);
+
+    fprintf(out, "  %s %03d -> PU P#%u core %d L3 %d socket %d numa %d\n",
+            role, index, pu->os_index,
+            ancestor_index(topo, pu, hwloc_get_type_depth(topo, HWLOC_OBJ_CORE)),
+            ancestor_index(topo, pu, l3),
+            ancestor_index(topo, pu, hwloc_get_type_depth(topo, HWLOC_OBJ_SOCKET)),
+            placement_node(topo, obj));
+}
+
+void placement_print(FILE *out, hwloc_topology_t topo, int policy,
+                     int nproducers, int nconsumers,
+                     const hwloc_obj_t *prod, const hwloc_obj_t *cons)
+{
+    int i, l3 = l3_depth(topo);
+    int sdepth = hwloc_get_type_depth(topo, HWLOC_OBJ_SOCKET);
+    int cdepth = hwloc_get_type_depth(topo, HWLOC_OBJ_CORE);
+    int xsocket = 0, xnode = 0, samel3 = 0, samecore = 0;
+
+    fprintf(out, "Placement %s:\n", g_placement_names[policy]);
+
+    for(i = 0; i < nconsumers; i++)
+        print_one(out, topo, "consumer", i, cons[i], l3);
+
+    for(i = 0; i < nproducers; i++) {
+        hwloc_obj_t p = prod[i], c = cons[i % nconsumers];
+
+        print_one(out, topo, "producer", i, p, l3);
+
+        if(ancestor_index(topo, p, sdepth) != ancestor_index(topo, c, sdepth))
+            xsocket++;
+
+        if(placement_node(topo, p) != placement_node(topo, c))
+            xnode++;
+
+        if(ancestor_index(topo, p, l3) == ancestor_index(topo, c, l3))
+            samel3++;
+
+        if(ancestor_index(topo, p, cdepth) == ancestor_index(topo, c, cdepth))
+            samecore++;
+    }
+
+    fprintf(out, "Pairs: %d producers, %d cross socket, %d cross numa, %d same L3, "
+            "%d same core\n", nproducers, xsocket, xnode, samel3, samecore);
+}
@@ -0,0 +1,57 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __PLACEMENT_H__
+#define __PLACEMENT_H__
+
+#include <stdio.h>
+#include <hwloc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Thread placement policies.  Producer i always feeds consumer         */
+/* i % nconsumers, so the pairing policies place a producer relative to */
+/* the consumer it talks to.                                            */
+/*                                                                      */
+/*   legacy   producers on cores 1,3,5... then in order, consumers on   */
+/*            0,2,4... (the original hardcoded map, wrapped to the box) */
+/*   compact  each consumer followed by its producers on adjacent cores */
+/*   scatter  round robin over sockets, one thread at a time            */
+/*   l3pair   a consumer and its producers share an L3                  */
+/*   xsocket  producers on the socket after their consumer's            */
+/*   smt      a consumer and its producers on SMT siblings of one core  */
+typedef enum placement_t {
+    PLACE_LEGACY,
+    PLACE_COMPACT,
+    PLACE_SCATTER,
+    PLACE_L3PAIR,
+    PLACE_XSOCKET,
+    PLACE_SMT,
+    PLACE_COUNT
+} placement_t;
+
+/* Policy index for a name, -1 when unknown */
+extern int         placement_lookup(const char *name);
+extern const char *placement_name(int policy);
+extern void        placement_usage(FILE *out);
+
+/* Fill prod[nproducers] and cons[nconsumers] with the hwloc object */
+/* (core, or PU for smt) each thread should be bound to.  Threads   */
+/* wrap around when there are more of them than cores.              */
+extern void        placement_map(hwloc_topology_t topo, int policy,
+                                 int nproducers, int nconsumers,
+                                 hwloc_obj_t *prod, hwloc_obj_t *cons);
+/* NUMA node (OS index) of the memory nearest to obj */
+extern int         placement_node(hwloc_topology_t topo, hwloc_obj_t obj);
+/* Bind the calling thread's future allocations to obj's NUMA node */
+extern int         placement_membind(hwloc_topology_t topo, hwloc_obj_t obj);
+extern void        placement_print(FILE *out, hwloc_topology_t topo, int policy,
+                                   int nproducers, int nconsumers,
+                                   const hwloc_obj_t *prod,
+                                   const hwloc_obj_t *cons);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PLACEMENT_H__ */
@@ -0,0 +1,127 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include "pool.h"
+
+typedef struct pool_worker_t {
+    pool_t       *pool;
+    pthread_t     thread;
+    void       *(*fn)(void *);   /* NULL while idle */
+    void         *arg;
+    hwloc_obj_t   obj;
+} pool_worker_t;
+
+struct pool_t {
+    hwloc_topology_t  topo;
+    int               nthreads;
+    int               busy;      /* jobs started and not returned yet */
+    int               quit;
+    pthread_mutex_t   mutex;
+    pthread_cond_t    work;      /* main -> workers */
+    pthread_cond_t    done;      /* workers -> main */
+    pool_worker_t    *workers;
+};
+
+static void *pool_main(void *clientdata)
+{
+    pool_worker_t *w    = (pool_worker_t *)clientdata;
+    pool_t        *pool = w->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    for(;;) {
+        while(!w->fn && !pool->quit)
+            pthread_cond_wait(&pool->work, &pool->mutex);
+
+        if(!w->fn)
+            break;
+
+        pthread_mutex_unlock(&pool->mutex);
+        hwloc_set_cpubind(pool->topo, w->obj->cpuset, HWLOC_CPUBIND_THREAD);
+        w->fn(w->arg);
+        pthread_mutex_lock(&pool->mutex);
+
+        w->fn = NULL;
+
+        if(--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+pool_t *pool_create(hwloc_topology_t topo, int nthreads)
+{
+    pool_t *pool = (pool_t *)calloc(1, sizeof(pool_t));
+    int     i;
+
+    pool->topo     = topo;
+    pool->nthreads = nthreads;
+    pool->workers  = (pool_worker_t *)calloc(nthreads, sizeof(pool_worker_t));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for(i = 0; i < nthreads; i++) {
+        pool->workers[i].pool = pool;
+
+        if(pthread_create(&pool->workers[i].thread, NULL, pool_main,
+                          &pool->workers[i]) != 0)
+            exit(1);
+    }
+
+    return pool;
+}
+
+void pool_destroy(pool_t *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for(i = 0; i < pool->nthreads; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+    free(pool);
+}
+
+void pool_run(pool_t *pool, int index, hwloc_obj_t obj,
+              void *(*fn)(void *), void *arg)
+{
+    pool_worker_t *w = &pool->workers[index];
+
+    pthread_mutex_lock(&pool->mutex);
+    w->obj = obj;
+    w->arg = arg;
+    w->fn  = fn;
+    pool->busy++;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int pool_wait(pool_t *pool, const struct timespec *deadline)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    while(pool->busy && ret != ETIMEDOUT) {
+        if(deadline)
+            ret = pthread_cond_timedwait(&pool->done, &pool->mutex, deadline);
+        else
+            pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+
+    ret = pool->busy ? -1 : 0;
+    pthread_mutex_unlock(&pool->mutex);
+    return ret;
+}
@@ -0,0 +1,35 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <time.h>
+#include <hwloc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Persistent worker threads, so a sweep creates its threads once      */
+/* instead of once per run.  Each job rebinds its worker to the object */
+/* the placement map chose for it before calling fn(arg).              */
+/*                                                                     */
+/*     pool_t *pool = pool_create(topo, nthreads);                     */
+/*     pool_run(pool, 0, obj, fn, arg);      one call per thread       */
+/*     pool_wait(pool, &deadline);           -1 once deadline passed   */
+/*     pool_destroy(pool);                                             */
+typedef struct pool_t pool_t;
+
+extern pool_t *pool_create(hwloc_topology_t topo, int nthreads);
+extern void    pool_destroy(pool_t *pool);
+/* Start fn(arg) on worker index, bound to obj */
+extern void    pool_run(pool_t *pool, int index, hwloc_obj_t obj,
+                        void *(*fn)(void *), void *arg);
+/* Wait until every job has returned; deadline is CLOCK_REALTIME and   */
+/* NULL waits forever.  Returns -1 on timeout with jobs still running. */
+extern int     pool_wait(pool_t *pool, const struct timespec *deadline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POOL_H__ */
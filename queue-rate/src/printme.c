@@ -7,11 +7,14 @@
 #include <stdint.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include "rng.h"
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
 
 
+uint64_t g_seed;
+
 int urandom_init(){
         int urandom_fd = open("/dev/urandom", O_RDONLY);
         if(urandom_fd == -1){
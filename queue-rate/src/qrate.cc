@@ -1,27 +1,43 @@
 // -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
 #include <hwloc.h>
-#include <hwloc/glibc-sched.h>
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <pthread.h>
 #include <stdint.h>
-#include <sys/time.h>
+#include <time.h>
 #include <new>
+#include "timing.h"
+#include "placement.h"
+#include "histogram.h"
+#include "results.h"
+#include "pool.h"
+#include "stats.h"
+#include "backoff.h"
+#include "service.h"
+#include "perfctr.h"
+#include "rng.h"
+#include "qstats.h"
 /* -------------------------------------------------------------------  */
 /* |Facebook Folly  | https://github.com/facebook/folly               | */
 /* |Moody Camel     | https://github.com/cameron314/concurrentqueue   | */
 /* |Cloudius        | https://github.com/cloudius-systems/osv         | */
 /* |Natsys Queue    | https://github.com/natsys/blog                  | */
 /* -------------------------------------------------------------------  */
-#define FOLLY_QUEUE        1
-#define MOODY_CAMEL_QUEUE  2
-#define CLOUDIUS_QUEUE     3
-#define NATSYS_QUEUE       4
-#define VYUKOV_QUEUE       5
-#define TBB_QUEUE          6
 #define BULK_DEQUEUE       524288
+/* Longest sleep in a queue's own blocking dequeue (--wait blocking) */
+#define WAIT_USEC          10000
+/* Most nodes a consumer takes from a sibling's queue at once (--topology steal) */
+#define STEAL_DEQUEUE      256
+/* Largest -Q:  the preallocating queues build every queue at that size */
+#define CAPACITY_MAX       (1<<20)
+/* Largest --quasi:  every segment of the segmented queue has that many cells */
+#define QUASI_MAX          (1<<20)
 
 //#define DEBUG
 extern "C" {
@@ -44,44 +60,485 @@ typedef struct thread_data_t {
     hwloc_obj_t  obj;
     int          nconsumers;
     int          nproducers;
+    int          nqueues;       /* queues the producers spread over      */
+    int          topology;
+    int          pingpong;      /* round trips per pair, 0 for a stream  */
     int          messages_per_thread;
     int          total_messages;
+    int          queue_size;    /* newQ's nmessages:  -Q, or every message */
     int          randomize;
+    int          latency;
+    int          batch;
+    int          duration;
+    uint64_t     interval;
+    int          numa;
+    int          node;
+    uint64_t     local;
+    uint64_t     remote;
+    int          wait;
+    uint64_t     notify;        /* producer cycles spent waking consumers */
+    uint64_t     notifies;
+    uint64_t     parks;         /* times the consumer went to sleep       */
+    uint64_t     cpu_nsec;      /* consumer thread CPU time               */
+    uint64_t     waits;         /* failed attempts that went to backoff() */
+    uint64_t     stolen;        /* messages taken from a sibling's queue  */
+    uint64_t     corrupt;       /* messages whose payload did not match   */
+    uint64_t     work_cycles;   /* cycles of synthetic work (--work)      */
+    int          capacity;      /* -Q nodes per queue, 0 for unbounded    */
+    uint64_t     stall;         /* producer cycles spent on full queues   */
+    uint64_t     rejects;       /* enqueues refused by a full queue       */
+    perf_counters_t perf;       /* --perf hardware counters, timed region */
+    qstats_t     qstats;        /* --queue-stats counts, timed region     */
+    int          reorder;       /* --reorder:  check order per producer   */
+    uint64_t     reordered;     /* messages behind one already received   */
+    uint64_t     reorder_dist;  /* summed over them, in sends             */
+    uint64_t     reorder_max;
+    volatile uint64_t seen;     /* messages received, as of the last poll */
+    hist_t      *wake_hist;
+    hist_t      *hist;
+    phase_t      phase;
 } thread_data_t;
+/* The --payload bytes, if any, follow the node:  see node_at */
 typedef struct work_node_t {
     work_node_t *next;
+    work_node_t *origin;        /* the producer's node, in a by-value copy too */
     int          id;
     int          data;
+    uint64_t     ts;
+    volatile int inflight;
     char pad[64-sizeof(work_node_t *) -
+             sizeof(work_node_t *)    -
              sizeof(int)              -
+             sizeof(int)              -
+             sizeof(uint64_t)         -
              sizeof(int)];
 } work_node_t;
 
 pthread_mutex_t   g_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_barrier_t g_barrier;
+pthread_barrier_t g_end_barrier;
 hwloc_topology_t  g_topo;
 int               g_done;
+int              *g_producer_node;
 int               g_random_fd;
+double            g_tsc_per_nsec;
+volatile int      g_stop;
+volatile int      g_timeout;
+uint64_t          g_sent;       /* messages sent by the producers that are done */
+int               g_payload;    /* --payload bytes after each node header */
+size_t            g_node_size = sizeof(work_node_t);
+service_t         g_consumer_work;      /* --work         */
+service_t         g_producer_work;      /* --produce-work */
+
+/* ------------------------------------------------------------------- */
+/* Payload (--payload):  the producer fills every byte before each     */
+/* send and the consumer reads every byte back, so a message costs its */
+/* size at both ends whether the queue moves a pointer or a copy.      */
+/* ------------------------------------------------------------------- */
+static inline work_node_t *node_at(work_node_t *nodes, int i)
+{
+    return (work_node_t *)((char *)nodes + (size_t)i * g_node_size);
+}
+
+static inline work_node_t *nodes_alloc(int n)
+{
+    work_node_t *nodes = (work_node_t *)calloc(n, g_node_size);
 
+    for(int i = 0; i < n; i++)
+        node_at(nodes, i)->origin = node_at(nodes, i);
 
-#if  QUEUE_METHOD==FOLLY_QUEUE
-#include "folly_q.h"
-#elif QUEUE_METHOD==MOODY_CAMEL_QUEUE
-#include "moody_camel_q.h"
-#elif QUEUE_METHOD==CLOUDIUS_QUEUE
-#include "cloudius_q.h"
-#elif QUEUE_METHOD==NATSYS_QUEUE
-#include "natsys_q.h"
-#elif QUEUE_METHOD==VYUKOV_QUEUE
-#include "vyukov_q.h"
-#elif QUEUE_METHOD==TBB_QUEUE
-#include "tbb_q.h"
-#elif QUEUE_METHOD==BOOST_QUEUE
-#include "boost_q.h"
-#else
-#error "A valid queue method has not been chosen"
-#endif
+    return nodes;
+}
+
+static inline void payload_write(work_node_t *node)
+{
+    if(g_payload)
+        memset(node+1, (unsigned char)node->data, g_payload);
+}
+
+/* 0 when a byte differs from what its producer wrote */
+static inline int payload_read(const work_node_t *node)
+{
+    const uint64_t *word   = (const uint64_t *)(node+1);
+    uint64_t        expect = 0x0101010101010101ULL * (unsigned char)node->data;
+    uint64_t        diff   = 0;
+
+    for(int i = 0; i < g_payload/8; i++)
+        diff |= word[i] ^ expect;
+
+    return diff == 0;
+}
+
+/* Ready a node for sending:  the producer's own work first, as touch */
+/* would otherwise disturb the payload the consumer checks            */
+static inline void node_produce(work_node_t *node, uint64_t *rng,
+                                uint64_t *work)
+{
+    *work += service_run(&g_producer_work, node+1, rng);
+    payload_write(node);
+}
+
+/* Check and serve a received node; 0 when its payload was corrupt */
+static inline int node_consume(work_node_t *node, uint64_t *rng,
+                               uint64_t *work)
+{
+    int ok = !g_payload || payload_read(node);
+
+    *work += service_run(&g_consumer_work, node+1, rng);
+    return ok;
+}
+
+/* --topology:  how consumers are fed                                  */
+/*   sharded  each consumer owns Q[me], producers shard over them      */
+/*   shared   all producers and consumers use one MPMC queue           */
+/*   steal    sharded, but a consumer whose queue is empty takes up to */
+/*            STEAL_DEQUEUE nodes from the next non-empty sibling      */
+/*   pairs    p == c independent producer -> consumer pairs, each      */
+/*            producer ends its own queue:  the SPSC queues need it    */
+typedef enum topology_t {
+    TOPO_SHARDED,
+    TOPO_SHARED,
+    TOPO_STEAL,
+    TOPO_PAIRS,
+    TOPO_COUNT
+} topology_t;
+
+static const char *g_topology_names[TOPO_COUNT] = {
+    "sharded", "shared", "steal", "pairs"
+};
+
+
+#include "queues.h"
+#include "parking.h"
+#include "cds_q.h"
+
+parker_t         *g_parkers;
+thread_data_t    *g_consumer_data;
+
+/* ------------------------------------------------------------------- */
+/* Bounded capacity (-Q).  Every queue holds at most -Q nodes.  The    */
+/* queues with a refusing try_enqueue (bounded) are built at that      */
+/* size and enforce it themselves; for the others the driver keeps a   */
+/* count per queue that producers raise before they enqueue and        */
+/* consumers lower after they dequeue.  Either way a refused attempt   */
+/* is a rejection and the producer backs off and retries, and the     */
+/* time until a whole batch is in counts as stall time.                */
+/* ------------------------------------------------------------------- */
+typedef struct capacity_gate_t {
+    volatile long count __attribute__((aligned(64)));
+} capacity_gate_t;
+
+capacity_gate_t  *g_gates;
+long              g_capacity;
+
+static inline int gate_acquire(capacity_gate_t *g, int n)
+{
+    if(g->count + n > g_capacity)
+        return 0;
+
+    if(__atomic_add_fetch(&g->count, n, __ATOMIC_ACQ_REL) <= g_capacity)
+        return 1;
+
+    __atomic_sub_fetch(&g->count, n, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Consumer side, for nodes taken from queue q */
+template<class A>
+static inline void gate_release(int q, int n)
+{
+    if(!A::bounded && g_capacity && n)
+        __atomic_sub_fetch(&g_gates[q].count, n, __ATOMIC_RELEASE);
+}
+
+/* Enqueue n nodes on Q[q] within -Q; tok is NULL when the producer */
+/* does not use its token (-r)                                      */
+template<class A>
+static void send_bounded(int q, typename A::producer_token_t *tok,
+                         work_node_t **work, int n,
+                         uint64_t *stall, uint64_t *rejects)
+{
+    uint64_t t0    = 0;
+    unsigned fails = 0;
+    int      i     = 0;
+
+    if(A::bounded) {
+        while(i < n) {
+            if(A::try_enqueue(*A::Q[q], *work[i])) {
+                i++;
+                continue;
+            }
+
+            if(!t0)
+                t0 = rdtsc();
+
+            (*rejects)++;
+            backoff(BACKOFF_PAUSE, &fails);
+        }
+    } else {
+        while(!gate_acquire(&g_gates[q], n)) {
+            if(!t0)
+                t0 = rdtsc();
+
+            (*rejects)++;
+            backoff(BACKOFF_PAUSE, &fails);
+        }
+
+        if(n == 1) {
+            if(tok)
+                A::enqueue_tok(*A::Q[q], *tok, *work[0]);
+            else
+                A::enqueue(*A::Q[q], *work[0]);
+        } else {
+            if(tok)
+                A::enqueue_bulk_tok(*A::Q[q], *tok, work, n);
+            else
+                A::enqueue_bulk(*A::Q[q], work, n);
+        }
+    }
+
+    if(t0)
+        *stall += rdtsc() - t0;
+}
+
+/* A sentinel is not counted against -Q, but a full bounded queue  */
+/* still refuses it until the consumer makes room, -Q or not:  the */
+/* queue is built with exactly as many slots as there are messages */
+template<class A>
+static void send_sentinel(int q, work_node_t *node)
+{
+    unsigned fails = 0;
+
+    if(!A::bounded) {
+        A::enqueue(*A::Q[q], *node);
+        return;
+    }
+
+    while(!A::try_enqueue(*A::Q[q], *node))
+        backoff(BACKOFF_PAUSE, &fails);
+}
+
+/* Without sentinels (--topology shared, steal) the consumers are done */
+/* once every producer is and all it sent has been received            */
+static int drained(int nproducers, int nconsumers)
+{
+    uint64_t seen = 0;
+    int      i;
+
+    if(__atomic_load_n(&g_done, __ATOMIC_ACQUIRE) != nproducers)
+        return 0;
+
+    for(i=0; i < nconsumers; i++)
+        seen += g_consumer_data[i].seen;
+
+    return seen == g_sent;
+}
+
+/* Wake the consumer of queue q if it is parked (--wait).  The */
+/* blocking queues signal their own semaphore in enqueue.      */
+static inline void notify_consumer(int wait, int q, uint64_t *cycles,
+                                   uint64_t *calls)
+{
+    uint64_t t0;
 
+    if(wait == WAIT_SPIN || wait == WAIT_BLOCKING)
+        return;
+
+    t0 = rdtsc();
+    park_notify(&g_parkers[q], wait);
+    *cycles += rdtsc() - t0;
+    (*calls)++;
+}
+
+/* ------------------------------------------------------------------- */
+/* Paced and fixed-duration producer loop (-R, -d).                    */
+/*                                                                     */
+/* With -d the producer cycles through its -m/-p nodes until main      */
+/* raises g_stop; a node is reused only once its consumer has cleared  */
+/* inflight, so the pool bounds the messages in flight per producer.   */
+/*                                                                     */
+/* With -R message k is due at start + k*interval.  The producer never */
+/* skips ahead when it falls behind, and the node is stamped with its  */
+/* due time rather than the time it was actually sent, so a backlog    */
+/* shows up in the latency histogram instead of being hidden by the    */
+/* producer stalling (coordinated omission).                           */
+/* ------------------------------------------------------------------- */
+template<class A>
+static uint64_t produce_open(thread_data_t                *tdata,
+                             work_node_t                  *nodes,
+                             int                          *permute,
+                             int                           q,
+                             typename A::producer_token_t &prodTok,
+                             uint64_t                      start,
+                             uint64_t                     *idle,
+                             uint64_t                     *notify,
+                             uint64_t                     *notifies,
+                             uint64_t                     *rng,
+                             uint64_t                     *work,
+                             uint64_t                     *stall,
+                             uint64_t                     *rejects)
+{
+    int           pool     = tdata->messages_per_thread;
+    int           nbatch   = tdata->batch;
+    uint64_t      interval = tdata->interval;
+    uint64_t      sent     = 0;
+    int           i        = pool-1;
+    work_node_t **batch    = (work_node_t **)malloc(sizeof(work_node_t *) * nbatch);
+
+    *idle = 0;
+
+    while(tdata->duration ? !g_stop : i >= 0) {
+        int      k, n = nbatch;
+        uint64_t now;
+
+        if(!tdata->duration && i+1 < n)
+            n = i+1;
+
+        if(interval) {
+            uint64_t due = start + (sent+n-1)*interval;
+            uint64_t t0  = now = rdtsc();
+
+            while(now < due && !g_stop) {
+                __builtin_ia32_pause();
+                now = rdtsc();
+            }
+
+            *idle += now - t0;
+        }
+
+        now = rdtsc();
+
+        for(k = 0; k < n; k++) {
+            work_node_t *node = node_at(nodes, i);
+
+            while(node->inflight && !g_timeout)
+                __builtin_ia32_pause();
+
+            /* Timed out with the node still queued:  send what we have */
+            if(node->inflight)
+                break;
+
+            node->inflight = tdata->duration;
+
+            if(interval)
+                node->ts = start + (sent+k)*interval;
+            else if(tdata->latency)
+                node->ts = now;
+
+            node_produce(node, rng, work);
+            batch[k] = node;
+
+            if(--i < 0 && tdata->duration)
+                i = pool-1;
+        }
+
+        if((n = k) == 0)
+            break;
+
+        if(tdata->capacity) {
+            if(tdata->randomize)
+                q = (q+1) % tdata->nqueues;
+
+            send_bounded<A>(tdata->randomize ? permute[q] : q,
+                            tdata->randomize ? NULL : &prodTok,
+                            batch, n, stall, rejects);
+        } else if(n == 1) {
+            if(tdata->randomize) {
+                q = (q+1) % tdata->nqueues;
+                A::enqueue(*A::Q[permute[q]], *batch[0]);
+            } else
+                A::enqueue_tok(*A::Q[q], prodTok, *batch[0]);
+        } else {
+            if(tdata->randomize) {
+                q = (q+1) % tdata->nqueues;
+                A::enqueue_bulk(*A::Q[permute[q]], batch, n);
+            } else
+                A::enqueue_bulk_tok(*A::Q[q], prodTok, batch, n);
+        }
+
+        notify_consumer(tdata->wait, tdata->randomize ? permute[q] : q,
+                        notify, notifies);
+
+        sent += n;
+    }
+
+    free(batch);
+    return sent;
+}
+
+/* ------------------------------------------------------------------- */
+/* Ping-pong (--pingpong, --topology pairs):  producer i sends one     */
+/* message on Q[i] and waits for consumer i to send it back on         */
+/* Q[nconsumers+i], so the histogram holds full round trips.  Both     */
+/* sides use the tokenless enqueue, which never holds a message back.  */
+/* ------------------------------------------------------------------- */
+template<class A>
+static uint64_t ping(thread_data_t *tdata, work_node_t *nodes, int q,
+                     uint64_t *rng, uint64_t *work)
+{
+    typename A::consumer_token_t backTok(*A::Q[tdata->nconsumers+q]);
+    work_node_t *back[1];
+    uint64_t     rounds;
+
+    for(rounds = 0; rounds < (uint64_t)tdata->pingpong && !g_stop; rounds++) {
+        work_node_t *node  = node_at(nodes, rounds % tdata->messages_per_thread);
+        unsigned     fails = 0;
+
+        node_produce(node, rng, work);
+        node->ts = rdtsc();
+        A::enqueue(*A::Q[q], *node);
+
+        while(A::try_dequeue_bulk_tok(*A::Q[tdata->nconsumers+q], backTok,
+                                      back[0], 1) == 0) {
+            if(g_timeout)
+                return rounds;
+
+            backoff(BACKOFF_NONE, &fails);
+        }
+
+        hist_record(tdata->hist, rdtsc() - back[0]->ts);
+    }
+
+    return rounds;
+}
+
+template<class A>
+static uint64_t pong(thread_data_t                *tdata,
+                     typename A::consumer_token_t &consTok,
+                     uint64_t                     *corrupt,
+                     uint64_t                     *rng,
+                     uint64_t                     *work)
+{
+    int          me   = tdata->index;
+    work_node_t *node[1];
+    uint64_t     msgs = 0;
+    unsigned     fails = 0;
+
+    while(1) {
+        if(A::try_dequeue_bulk_tok(*A::Q[me], consTok, node[0], 1) == 0) {
+            if(g_timeout)
+                break;
+
+            backoff(BACKOFF_NONE, &fails);
+            continue;
+        }
+
+        fails = 0;
+
+        if(node[0]->data == 0)
+            break;
+
+        if(!node_consume(node[0], rng, work))
+            (*corrupt)++;
+
+        A::enqueue(*A::Q[tdata->nconsumers+me], *node[0]);
+        msgs++;
+    }
+
+    return msgs;
+}
+
+template<class A>
 void *do_produce(void *clientdata)
 {
     int i;
@@ -89,12 +546,16 @@ void *do_produce(void *clientdata)
     char *str1;
     thread_data_t *tdata  = (thread_data_t *)clientdata;
     int            me     = tdata->index;
-    int            q      = me % tdata->nconsumers;
+    int            q      = me % tdata->nqueues;
     hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
     hwloc_bitmap_zero(cpuset);
     hwloc_get_cpubind(g_topo, cpuset, HWLOC_CPUBIND_THREAD);
     hwloc_bitmap_asprintf(&str, cpuset);
 
+    /* Node pool on the producer's own node */
+    if(tdata->numa)
+        placement_membind(g_topo, tdata->obj);
+
     asprintf(&str1, "Producer %03d: token=%03d:", tdata->index,q);
 
     /* staged printf barrier */
@@ -107,86 +568,196 @@ void *do_produce(void *clientdata)
             printme(str1);
     }
     work_node_t *nodes_tmp = NULL;
-    work_node_t *nodes     = (work_node_t *)malloc(sizeof(work_node_t) * tdata->messages_per_thread);
-    int         *permute   = (int *)malloc(sizeof(int) *tdata->nconsumers);
+    work_node_t *nodes     = nodes_alloc(tdata->messages_per_thread);
+    int         *permute   = (int *)malloc(sizeof(int) *tdata->nqueues);
+    uint64_t     rng       = rng_seed(g_seed, 0, me);
 
-    for(i=0; i<tdata->nconsumers; i++)
+    for(i=0; i<tdata->nqueues; i++)
         permute[i]=i;
 
-    for(i=0; i<tdata->nconsumers; i++) {
+    for(i=0; i<tdata->nqueues; i++) {
         int swapme, index;
-        index=urandom(g_random_fd)%tdata->nconsumers;
+        index=rng_below(&rng, tdata->nqueues);
         swapme = permute[i];
         permute[i] = permute[index];
         permute[index] = swapme;
     }
 
     for(i = tdata->messages_per_thread-1; i >= 0; --i) {
-        nodes[i].id   = me;
-        nodes[i].data = 1+i;
+        node_at(nodes, i)->id       = me;
+        node_at(nodes, i)->data     = 1+i;
+        node_at(nodes, i)->inflight = 0;
     }
 
-    producer_token_t prodTok(Q[q]);
+    A::thread_init(me);
+    typename A::producer_token_t prodTok(*A::Q[q]);
+    perf_open(&tdata->perf);
     /* Start Timer Barrier */
     pthread_barrier_wait(&g_barrier);
     pthread_barrier_wait(&g_barrier);
 
     /* End Timer Barrier */
     pthread_barrier_wait(&g_barrier);
+    perf_start(&tdata->perf);
+    uint64_t start = rdtsc(), sent = tdata->messages_per_thread, idle = 0;
+    uint64_t work = 0, stall = 0, rejects = 0;
+    uint64_t notify = 0, notifies = 0;
+    t_backoff_waits = 0;
+    memset(&t_qstats, 0, sizeof(t_qstats));
     DEBUG_PRINT("Thread %d beginning, using q=%d\n",me,q);
 
-    for(i = tdata->messages_per_thread-1; i >= 0; --i) {
-        if(tdata->randomize) {
-            q = (q+1) % tdata->nconsumers;
-            enqueue(Q[permute[q]],nodes[i]);
-        } else
-            enqueue_tok(Q[q],prodTok, nodes[i]);
+    if(tdata->pingpong) {
+        sent = ping<A>(tdata, nodes, q, &rng, &work);
+    } else if(tdata->duration || tdata->interval) {
+        sent = produce_open<A>(tdata, nodes, permute, q, prodTok, start, &idle,
+                               &notify, &notifies, &rng, &work, &stall, &rejects);
+    } else if(tdata->batch > 1) {
+        work_node_t **batch = (work_node_t **)malloc(sizeof(work_node_t *) * tdata->batch);
+
+        for(i = tdata->messages_per_thread-1; i >= 0 && !g_stop; i -= tdata->batch) {
+            int k, n = (i+1 < tdata->batch) ? i+1 : tdata->batch;
+            uint64_t now = tdata->latency ? rdtsc() : 0;
+
+            for(k = 0; k < n; k++) {
+                batch[k] = node_at(nodes, i-k);
+                node_produce(batch[k], &rng, &work);
+
+                if(tdata->latency)
+                    batch[k]->ts = now;
+            }
+
+            if(tdata->capacity) {
+                if(tdata->randomize)
+                    q = (q+1) % tdata->nqueues;
+
+                send_bounded<A>(tdata->randomize ? permute[q] : q,
+                                tdata->randomize ? NULL : &prodTok,
+                                batch, n, &stall, &rejects);
+            } else if(tdata->randomize) {
+                q = (q+1) % tdata->nqueues;
+                A::enqueue_bulk(*A::Q[permute[q]], batch, n);
+            } else
+                A::enqueue_bulk_tok(*A::Q[q], prodTok, batch, n);
+
+            notify_consumer(tdata->wait, tdata->randomize ? permute[q] : q,
+                            &notify, &notifies);
+        }
+
+        free(batch);
+    } else {
+        for(i = tdata->messages_per_thread-1; i >= 0 && !g_stop; --i) {
+            work_node_t *node = node_at(nodes, i);
+
+            node_produce(node, &rng, &work);
+
+            if(tdata->latency)
+                node->ts = rdtsc();
+
+            if(tdata->capacity) {
+                if(tdata->randomize)
+                    q = (q+1) % tdata->nqueues;
+
+                send_bounded<A>(tdata->randomize ? permute[q] : q,
+                                tdata->randomize ? NULL : &prodTok,
+                                &node, 1, &stall, &rejects);
+            } else if(tdata->randomize) {
+                q = (q+1) % tdata->nqueues;
+                A::enqueue(*A::Q[permute[q]],*node);
+            } else
+                A::enqueue_tok(*A::Q[q],prodTok, *node);
+
+            notify_consumer(tdata->wait, tdata->randomize ? permute[q] : q,
+                            &notify, &notifies);
+        }
     }
 
-    DEBUG_PRINT("Thread %d finished producing!\n", nodes[0].id);
+    /* A fixed count run cut short by --timeout */
+    if(!tdata->pingpong && !tdata->duration && !tdata->interval && i >= 0)
+        sent = tdata->messages_per_thread-1 - i;
+
+    /* The producer never waits on an empty queue:  its whole loop is */
+    /* busy, apart from the time spent pacing itself under -R         */
+    tdata->phase.start = start;
+    tdata->phase.stop  = rdtsc();
+    perf_stop(&tdata->perf);
+    tdata->phase.busy  = tdata->phase.stop - start - idle;
+    tdata->phase.empty = 0;
+    tdata->phase.msgs  = sent;
+    tdata->notify      = notify;
+    tdata->notifies    = notifies;
+    tdata->waits       = t_backoff_waits;
+    tdata->work_cycles = work;
+    tdata->stall       = stall;
+    tdata->rejects     = rejects;
+    tdata->qstats      = t_qstats;
+
+    DEBUG_PRINT("Thread %d finished producing!\n", nodes->id);
     hwloc_bitmap_free(cpuset);
     free(str);
 
     pthread_mutex_lock(&g_mutex);
-    g_done++;
+    g_sent += sent;
+    int last = ++g_done == tdata->nproducers;
     pthread_mutex_unlock(&g_mutex);
 
     /* Signal the consumers to stop                        */
     /* Use temporary nodes...yours might still be enqueued */
-    if(g_done == tdata->nproducers) {
-        DEBUG_PRINT("Thread %d finished producing!\n", nodes[0].id);
-        nodes_tmp = (work_node_t *)malloc(sizeof(work_node_t) *
-                                          tdata->messages_per_thread);
+    /* Shared and stealing consumers count instead:  any   */
+    /* of them could take a sentinel meant for another     */
+    if(tdata->topology == TOPO_PAIRS) {
+        nodes_tmp       = nodes_alloc(1);
+        nodes_tmp->data = 0;
+        send_sentinel<A>(q, nodes_tmp);
+        park_wake(&g_parkers[q], tdata->wait);
+    } else if(last && tdata->topology == TOPO_SHARDED) {
+        DEBUG_PRINT("Thread %d finished producing!\n", nodes->id);
+        nodes_tmp = nodes_alloc(tdata->nconsumers);
         for(i=0; i<tdata->nconsumers; i++) {
-            nodes_tmp[i].data = 0;
-            enqueue(Q[i],nodes_tmp[i]);
+            node_at(nodes_tmp, i)->data = 0;
+            send_sentinel<A>(i, node_at(nodes_tmp, i));
+            park_wake(&g_parkers[i], tdata->wait);
         }
     }
 
     /* End of job barrier for timing */
-    pthread_barrier_wait(&g_barrier);
+    pthread_barrier_wait(&g_end_barrier);
 
     /* End of job barrier for printing */
-    pthread_barrier_wait(&g_barrier);
+    pthread_barrier_wait(&g_end_barrier);
 
     if(nodes_tmp)free(nodes_tmp);
     free(nodes);
     free(permute);
-    pthread_exit(NULL);
     return NULL;
 }
 
+template<class A>
 void *do_consume(void *clientdata)
 {
     char *str;
     char *str1;
-    struct timeval ti, tf;
     int            i,me;
     hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
     thread_data_t *tdata = (thread_data_t *)clientdata;
     double         calls=0.0, sum=0.0;
     me = tdata->index;
-    consumer_token_t consTok(Q[me]);
+
+    /* Build this consumer's queue from its own thread, so the queue */
+    /* and everything it allocates lands on the consumer's node.     */
+    /* If membind is refused, first touch from the bound thread      */
+    /* still places it locally.                                      */
+    /* (main builds the shared queue:  it has no home node)           */
+    int qme = tdata->topology == TOPO_SHARED ? 0 : me;
+
+    if(tdata->numa && tdata->topology != TOPO_SHARED) {
+        placement_membind(g_topo, tdata->obj);
+        create_queue<A>(me, tdata->nconsumers, tdata->nproducers,
+                        tdata->queue_size);
+    }
+
+    A::thread_init(me);
+    typename A::consumer_token_t consTok(*A::Q[qme]);
+    perf_open(&tdata->perf);
 
     hwloc_bitmap_zero(cpuset);
     hwloc_get_cpubind(g_topo, cpuset, HWLOC_CPUBIND_THREAD);
@@ -210,11 +781,39 @@ void *do_consume(void *clientdata)
     /* Start timer Barrier */
     pthread_barrier_wait(&g_barrier);
     pthread_barrier_wait(&g_barrier);
-    gettimeofday(&ti, NULL);
 
     /* End Timer Barrier */
     pthread_barrier_wait(&g_barrier);
-    int done=0;
+    perf_start(&tdata->perf);
+    uint64_t start = rdtsc(), last = start, busy = 0, empty = 0, msgs = 0;
+    uint64_t local = 0, parks = 0, stolen = 0, corrupt = 0;
+    uint64_t rng = rng_seed(g_seed, 1, me), work = 0;
+    uint64_t reordered = 0, reorder_dist = 0, reorder_max = 0;
+    unsigned fails = 0;
+    int done=0, ending=0;
+    int *newest = NULL;
+
+    /* --reorder:  producers count data down from -m/-p to 1, so the */
+    /* newest message seen from each has the lowest data             */
+    if(tdata->reorder) {
+        newest = (int *)malloc(sizeof(int) * tdata->nproducers);
+
+        for(i=0; i < tdata->nproducers; i++)
+            newest[i] = INT_MAX;
+    }
+    struct timespec cpu0, cpu1;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu0);
+    t_backoff_waits = 0;
+    memset(&t_qstats, 0, sizeof(t_qstats));
+
+    /* Echoing is all busy:  the round trip is the measurement */
+    if(tdata->pingpong) {
+        msgs = pong<A>(tdata, consTok, &corrupt, &rng, &work);
+        last = rdtsc();
+        busy = last - start;
+        done = 1;
+    }
 
     while(!done) {
         work_node_t *node[BULK_DEQUEUE];
@@ -222,59 +821,1178 @@ void *do_consume(void *clientdata)
         size_t result;
 
         if(tdata->nproducers==tdata->nconsumers)
-            result = try_dequeue_bulk_tok(Q[me],consTok,node[0],BULK_DEQUEUE);
+            result = A::try_dequeue_bulk_tok(*A::Q[qme],consTok,node[0],BULK_DEQUEUE);
         else
-            result = try_dequeue_bulk(Q[me], node[0],BULK_DEQUEUE);
+            result = A::try_dequeue_bulk(*A::Q[qme], node[0],BULK_DEQUEUE);
+
+        gate_release<A>(qme, result);
+
+        /* --topology steal:  the next sibling that has work */
+        for(int k = 1; result == 0 && tdata->topology == TOPO_STEAL &&
+                k < tdata->nconsumers; k++) {
+            result  = A::try_dequeue_bulk(*A::Q[(me+k) % tdata->nconsumers],
+                                          node[0], STEAL_DEQUEUE);
+            stolen += result;
+            gate_release<A>((me+k) % tdata->nconsumers, result);
+        }
 
         sum+=result;
         calls++;
 
+        /* One stamp per dequeue call:  every node in the batch left */
+        /* the queue at the same time                                */
+        uint64_t now = rdtsc();
+        int      slept = 0;
+
+        /* Sleeping is charged as empty time, like polling */
+        if(result==0 && tdata->wait != WAIT_SPIN && !g_timeout && !ending) {
+            result = park<A>(&g_parkers[me], tdata->wait, *A::Q[me], consTok,
+                             node[0], BULK_DEQUEUE, WAIT_USEC, &slept);
+            gate_release<A>(me, result);
+            now    = rdtsc();
+            parks += slept;
+
+            if(slept) {
+                empty += now - last;
+                last   = now;
+            }
+        }
+
         if(result==0) {
+            empty += now - last;
+            last   = now;
+            QSTAT(empty_pops);
+
+            /* --timeout:  leave whatever is still on its way.  After  */
+            /* the sentinel, everything sent is already in the queue  */
+            if(g_timeout || ending)
+                done = 1;
+            else if(tdata->topology != TOPO_SHARDED) {
+                tdata->seen = msgs;
+                done        = drained(tdata->nproducers, tdata->nconsumers);
+            }
+
+            if(!done && !slept)
+                backoff(BACKOFF_NONE, &fails);
+
             continue;
         }
 
+        fails = 0;
+
+        /* Wake latency:  oldest message of the batch that woke us */
+        if(slept) {
+            uint64_t oldest = now;
+
+            for(i=0; i< result; i++)
+                if(node[i]->data != 0 && node[i]->ts < oldest)
+                    oldest = node[i]->ts;
+
+            hist_record(tdata->wake_hist, now - oldest);
+        }
+
         for(i=0; i< result; i++) {
             DEBUG_PRINT("Consumer:  (tid=%d node data = %d\n",
                         node[i]->id, node[i]->data);
 
+            /* The sentinel can overtake other producers' messages in */
+            /* a queue that is FIFO per producer only (mc), so drain  */
+            /* until empty rather than stopping here                  */
             if(node[i]->data == 0) {
                 DEBUG_PRINT("Got 0 from node! assuming finished!\n");
-                done=1;
+                ending=1;
+                continue;
             }
+
+            msgs++;
+
+            if(tdata->numa && g_producer_node[node[i]->id] == tdata->node)
+                local++;
+
+            if(tdata->latency && now > node[i]->ts)
+                hist_record(tdata->hist, now - node[i]->ts);
+
+            if(!node_consume(node[i], &rng, &work))
+                corrupt++;
+
+            /* Out of order:  sent before the newest message already */
+            /* received from its producer, by that many sends        */
+            if(newest) {
+                int id = node[i]->id;
+
+                if(node[i]->data < newest[id])
+                    newest[id] = node[i]->data;
+                else {
+                    uint64_t dist = node[i]->data - newest[id];
+
+                    reordered++;
+                    reorder_dist += dist;
+
+                    if(dist > reorder_max)
+                        reorder_max = dist;
+                }
+            }
+
+            /* Hand the node back to its producer:  last touch.  A  */
+            /* by-value copy releases the original it was made from */
+            if(tdata->duration)
+                node[i]->origin->inflight = 0;
         }
+
+        /* A successful call is charged up to the end of its processing */
+        now   = rdtsc();
+        busy += now - last;
+        last  = now;
     }
 
     DEBUG_PRINT("Consumer finished!\n");
-    gettimeofday(&tf, NULL);
+    perf_stop(&tdata->perf);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+    tdata->cpu_nsec    = (cpu1.tv_sec - cpu0.tv_sec) * 1000000000UL +
+                         cpu1.tv_nsec - cpu0.tv_nsec;
+    tdata->parks       = parks;
+    tdata->waits       = t_backoff_waits;
+    tdata->stolen      = stolen;
+    tdata->corrupt     = corrupt;
+    tdata->work_cycles = work;
+    tdata->reordered    = reordered;
+    tdata->reorder_dist = reorder_dist;
+    tdata->reorder_max  = reorder_max;
+    tdata->phase.start = start;
+    tdata->phase.stop  = last;
+    tdata->phase.busy  = busy;
+    tdata->phase.empty = empty;
+    tdata->phase.msgs  = msgs;
+    tdata->local       = local;
+    tdata->remote      = tdata->numa ? msgs - local : 0;
+    tdata->qstats      = t_qstats;
     /* End of job barrier for timing */
-    pthread_barrier_wait(&g_barrier);
+    pthread_barrier_wait(&g_end_barrier);
 
     /* End of job barrier for printing */
-    pthread_barrier_wait(&g_barrier);
-    long usec = ((tf.tv_sec - ti.tv_sec)*1000000L+tf.tv_usec) - ti.tv_usec;
-    double usecF       = (double) usec;
+    pthread_barrier_wait(&g_end_barrier);
+    double usecF       = (last - start) / g_tsc_per_nsec / 1000.0;
     double n_producers = (double) tdata->nproducers/tdata->nconsumers;
-    double n_msgs      = (double) tdata->messages_per_thread*n_producers;
+    double n_msgs      = (double) msgs;
     printf("Consumer %03d:  n_msgs=%f in %f usec n_producers handled=%f:  mmsgs/s=%f nmsg/call=%f\n",
            tdata->index, n_msgs, usecF,n_producers, n_msgs/usecF, sum/calls);
     hwloc_bitmap_free(cpuset);
     free(str);
+    free(newest);
 
-    pthread_exit(NULL);
     return NULL;
 }
 
+static const queue_entry_t g_queues[] = {
+    QUEUE_LIST(QUEUE_ENTRY)
+    CDS_GC_QUEUE_LIST(QUEUE_ENTRY, cds_hp)
+    CDS_QUEUE_LIST(QUEUE_ENTRY, cds_hp)
+};
+#define N_QUEUES ((int)(sizeof(g_queues)/sizeof(g_queues[0])))
+
+static const queue_entry_t g_value_queues[] = {
+    PAYLOAD_LIST(VALUE_ENTRIES)
+};
+#define N_VALUE_QUEUES ((int)(sizeof(g_value_queues)/sizeof(g_value_queues[0])))
+
+/* The libcds lock-free queues again, for --gc dhp */
+static const queue_entry_t g_dhp_queues[] = {
+    CDS_GC_QUEUE_LIST(QUEUE_ENTRY, cds_dhp)
+};
+#define N_DHP_QUEUES ((int)(sizeof(g_dhp_queues)/sizeof(g_dhp_queues[0])))
+
+/* And with their stat policies on, for --queue-stats */
+static const queue_entry_t g_stat_queues[] = {
+    CDS_GC_QUEUE_LIST(QUEUE_ENTRY, cds_hp_stat)
+    CDS_QUEUE_LIST(QUEUE_ENTRY, cds_hp_stat)
+};
+#define N_STAT_QUEUES ((int)(sizeof(g_stat_queues)/sizeof(g_stat_queues[0])))
+
+static const queue_entry_t g_dhp_stat_queues[] = {
+    CDS_GC_QUEUE_LIST(QUEUE_ENTRY, cds_dhp_stat)
+};
+#define N_DHP_STAT_QUEUES ((int)(sizeof(g_dhp_stat_queues)/sizeof(g_dhp_stat_queues[0])))
+
+/* fcqueue per --fc-wait, plain and for --queue-stats */
+static const queue_entry_t g_fc_queues[2][FC_WAIT_COUNT] = {
+    {
+        QUEUE_ENTRY(fcqueue, cds_fcqueue<cds_hp>, "libcds FCQueue (flat combining)")
+        QUEUE_ENTRY(fcqueue, cds_fcqueue<cds_fc_condvar>, "libcds FCQueue (flat combining)")
+        QUEUE_ENTRY(fcqueue, cds_fcqueue<cds_fc_multi_condvar>, "libcds FCQueue (flat combining)")
+        QUEUE_ENTRY(fcqueue, cds_fcqueue<cds_fc_multi_mutex>, "libcds FCQueue (flat combining)")
+    }, {
+        QUEUE_ENTRY(fcqueue, cds_fcqueue<cds_hp_stat>, "libcds FCQueue (flat combining)")
+        QUEUE_ENTRY(fcqueue, cds_fcqueue<cds_fc_condvar_stat>, "libcds FCQueue (flat combining)")
+        QUEUE_ENTRY(fcqueue, cds_fcqueue<cds_fc_multi_condvar_stat>, "libcds FCQueue (flat combining)")
+        QUEUE_ENTRY(fcqueue, cds_fcqueue<cds_fc_multi_mutex_stat>, "libcds FCQueue (flat combining)")
+    }
+};
+
+/* The pointer queues behind the --eliminate slots, over HP, plain and */
+/* for --queue-stats                                                   */
+static const queue_entry_t g_elim_queues[] = {
+    QUEUE_LIST(ELIM_ENTRY)
+    CDS_GC_QUEUE_LIST(ELIM_ENTRY, cds_hp)
+    CDS_QUEUE_LIST(ELIM_ENTRY, cds_hp)
+};
+#define N_ELIM_QUEUES ((int)(sizeof(g_elim_queues)/sizeof(g_elim_queues[0])))
+
+static const queue_entry_t g_elim_stat_queues[] = {
+    CDS_GC_QUEUE_LIST(ELIM_ENTRY, cds_hp_stat)
+    CDS_QUEUE_LIST(ELIM_ENTRY, cds_hp_stat)
+};
+#define N_ELIM_STAT_QUEUES ((int)(sizeof(g_elim_stat_queues)/sizeof(g_elim_stat_queues[0])))
+
+/* Options shared by every run of a sweep */
+typedef struct config_t {
+    const queue_entry_t *queue;
+    int                  nmessages;
+    int                  randomize;
+    int                  latency;
+    int                  batch;
+    int                  placement;
+    int                  numa;
+    int                  wait;
+    int                  topology;
+    int                  pingpong;
+    int                  payload;
+    int                  capacity;
+    int                  gc;        /* CDS_GC_*, -1 when the queue has none */
+    int                  fc;        /* a flat combining queue, with --fc-* */
+    int                  eliminate; /* --eliminate slots, 0 without */
+    int                  quasi;     /* segmented's quasi factor, 0 for others */
+    int                  reorder;
+    double               duration;
+    double               rate;
+    double               timeout;
+} config_t;
+
+/* What one run measured */
+typedef struct run_t {
+    int              nproducers;
+    int              nconsumers;
+    int              timed_out;
+    long             received;
+    double           usecF;
+    phase_summary_t  phases;
+    double           lat[5];        /* p50 p90 p99 p99.9 max, in nsec */
+    double           rtt[5];        /* the same for --pingpong round trips */
+    unsigned long    local;
+    unsigned long    remote;
+    double          *consumer_rate;
+    double          *consumer_msgs;
+    double           imbalance;     /* busiest consumer / mean           */
+    double           stolen_pct;    /* messages a sibling consumer took  */
+    unsigned long    corrupt;       /* payloads that did not match       */
+    double           cons_work;     /* consumer work cycles per message  */
+    double           prod_work;     /* producer work cycles per message  */
+    double           work_util;     /* consumer work / consumer wall, %  */
+    double           stall_pct;     /* producer time on full queues, %   */
+    double           reject_rate;   /* refused enqueues / attempts       */
+    perf_counters_t  prod_perf;     /* --perf, summed over each role     */
+    perf_counters_t  cons_perf;
+    qstats_t         qstats;        /* --queue-stats, queues and threads */
+    double           reorder_frac;  /* --reorder:  messages out of order */
+    double           reorder_mean;  /* sends they were behind, on average */
+    unsigned long    reorder_max;
+    unsigned long    parks;
+    double           wake[3];       /* p50 p99 max wake latency, in nsec */
+    double           notify_cpc;    /* producer cycles per notify call   */
+    double           cpu_pct;       /* consumer CPU time / wall time     */
+    double           prod_wpm;      /* producer backoff waits per message */
+    double           cons_wpm;      /* consumer backoff waits per message */
+} run_t;
+
+/* Repeats of one (p, c) point */
+typedef struct point_t {
+    int              repeats;
+    int              timeouts;
+    double          *samples;       /* mmsgs/s of the runs that finished */
+    int              nsamples;
+    double           median;
+    double           lo;
+    double           hi;
+} point_t;
+
+/* CLOCK_REALTIME sec seconds from now, for pool_wait */
+static void deadline_after(struct timespec *ts, double sec)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec  += (time_t)sec;
+    ts->tv_nsec += (long)((sec - (time_t)sec) * 1e9);
+
+    if(ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/* ------------------------------------------------------------------- */
+/* One run on the pool:  worker i < nproducers produces, the others    */
+/* consume.  With --timeout main waits for the workers until the       */
+/* deadline, then raises g_timeout and g_stop:  producers stop sending */
+/* and consumers leave as soon as their queue is empty, so the run     */
+/* ends cooperatively and the pool stays usable for the next point.    */
+/* ------------------------------------------------------------------- */
+static void run_once(pool_t *pool, const config_t *cfg,
+                     int nproducers, int nconsumers,
+                     const hwloc_obj_t *producer_obj,
+                     const hwloc_obj_t *consumer_obj,
+                     run_t *run)
+{
+    const queue_entry_t *queue = cfg->queue;
+    thread_data_t    producer_data[nproducers];
+    thread_data_t    consumer_data[nconsumers];
+    int              messages_per_thread = cfg->nmessages/nproducers;
+    int              total_messages      = messages_per_thread*nproducers;
+    double           tsc_per_nsec        = g_tsc_per_nsec;
+    struct timespec  deadline;
+    int              i;
+
+    int              nqueues             = cfg->topology == TOPO_SHARED ? 1 : nconsumers;
+    /* Ping-pong adds a queue back from each consumer */
+    int              nalloc              = cfg->pingpong ? 2*nconsumers : nconsumers;
+    /* -Q builds every queue at its capacity */
+    int              queue_size          = cfg->capacity ? cfg->capacity : total_messages;
+
+    printf("Starting mpsc with %s queue P:%d C:%d NM:%d B:%d D:%g R:%g T:%s\n",
+           queue->description,nproducers, nconsumers,cfg->nmessages,cfg->batch,
+           cfg->duration,cfg->rate,g_topology_names[cfg->topology]);
+
+    g_done    = 0;
+    g_sent    = 0;
+    g_stop    = 0;
+    g_timeout = 0;
+    queue->init(nalloc);
+
+    /* --numa leaves construction to the consumer threads */
+    if(!cfg->numa || cfg->topology == TOPO_SHARED)
+        for(i=0; i < nqueues; i++)
+            queue->create(i, nconsumers, nproducers, queue_size);
+
+    for(i=nconsumers; i < nalloc; i++)
+        queue->create(i, nconsumers, nproducers, total_messages);
+
+    /* Cycles between two sends of one producer */
+    uint64_t interval = 0;
+
+    if(cfg->rate > 0.0) {
+        interval = (uint64_t)(tsc_per_nsec * 1e9 * nproducers / cfg->rate);
+
+        if(interval == 0)
+            interval = 1;
+    }
+
+    /* main takes part in the start barriers only */
+    pthread_barrier_init(&g_barrier, NULL, nproducers+nconsumers+1);
+    pthread_barrier_init(&g_end_barrier, NULL, nproducers+nconsumers);
+
+    g_producer_node = (int *)malloc(sizeof(int) * nproducers);
+    g_consumer_data = consumer_data;
+    g_parkers       = parkers_new(nconsumers);
+    g_capacity      = cfg->capacity;
+
+    if(posix_memalign((void **)&g_gates, 64, sizeof(capacity_gate_t) * nqueues) != 0)
+        abort();
+
+    memset(g_gates, 0, sizeof(capacity_gate_t) * nqueues);
+
+    for(i=0; i < nproducers; i++)
+        g_producer_node[i] = placement_node(g_topo, producer_obj[i]);
+
+    for(i=0; i < nproducers; i++) {
+        producer_data[i].index               = i;
+        producer_data[i].obj                 = producer_obj[i];
+        producer_data[i].nconsumers          = nconsumers;
+        producer_data[i].nproducers          = nproducers;
+        producer_data[i].nqueues             = nqueues;
+        producer_data[i].topology            = cfg->topology;
+        producer_data[i].pingpong            = cfg->pingpong;
+        producer_data[i].messages_per_thread = messages_per_thread;
+        producer_data[i].total_messages      = total_messages;
+        producer_data[i].queue_size          = queue_size;
+        producer_data[i].capacity            = cfg->capacity;
+        producer_data[i].randomize           = cfg->randomize;
+        /* Send stamps also feed the wake latency */
+        producer_data[i].latency             = cfg->latency || cfg->wait != WAIT_SPIN;
+        producer_data[i].batch               = cfg->batch;
+        producer_data[i].duration            = cfg->duration > 0.0;
+        producer_data[i].interval            = interval;
+        producer_data[i].numa                = cfg->numa;
+        producer_data[i].node                = g_producer_node[i];
+        producer_data[i].wait                = cfg->wait;
+        producer_data[i].wake_hist           = NULL;
+        producer_data[i].hist                = cfg->pingpong ? hist_alloc() : NULL;
+
+        pool_run(pool, i, producer_obj[i], queue->produce, &producer_data[i]);
+        DEBUG_PRINT("Started producer thread %d\n", i);
+    }
+
+    for(i=0; i < nconsumers; i++) {
+        consumer_data[i].index               = i;
+        consumer_data[i].obj                 = consumer_obj[i];
+        consumer_data[i].nconsumers          = nconsumers;
+        consumer_data[i].nproducers          = nproducers;
+        consumer_data[i].nqueues             = nqueues;
+        consumer_data[i].topology            = cfg->topology;
+        consumer_data[i].pingpong            = cfg->pingpong;
+        consumer_data[i].messages_per_thread = messages_per_thread;
+        consumer_data[i].total_messages      = total_messages;
+        consumer_data[i].queue_size          = queue_size;
+        consumer_data[i].capacity            = cfg->capacity;
+        consumer_data[i].randomize           = cfg->randomize;
+        consumer_data[i].latency             = cfg->latency;
+        consumer_data[i].batch               = cfg->batch;
+        consumer_data[i].duration            = cfg->duration > 0.0;
+        consumer_data[i].interval            = interval;
+        consumer_data[i].numa                = cfg->numa;
+        consumer_data[i].node                = placement_node(g_topo, consumer_obj[i]);
+        consumer_data[i].wait                = cfg->wait;
+        consumer_data[i].wake_hist           = hist_alloc();
+        consumer_data[i].hist                = cfg->latency ? hist_alloc() : NULL;
+        consumer_data[i].seen                = 0;
+        consumer_data[i].reorder             = cfg->reorder;
+
+        pool_run(pool, nproducers+i, consumer_obj[i], queue->consume,
+                 &consumer_data[i]);
+        DEBUG_PRINT("Started consumer thread %d\n", i);
+    }
+
+    deadline_after(&deadline, cfg->timeout);
+
+    /* staged printf Barrier */
+    for(i=0; i<nconsumers+nproducers+PRINT_BATCH; i+=PRINT_BATCH)
+        pthread_barrier_wait(&g_barrier);
+
+    /* Start timer Barrier */
+    pthread_barrier_wait(&g_barrier);
+    pthread_barrier_wait(&g_barrier);
+
+    /* End timer Barrier */
+    pthread_barrier_wait(&g_barrier);
+
+    if(cfg->duration > 0.0) {
+        struct timespec ts;
+        ts.tv_sec  = (time_t)cfg->duration;
+        ts.tv_nsec = (long)((cfg->duration - ts.tv_sec) * 1e9);
+
+        while(nanosleep(&ts, &ts) != 0)
+            ;
+
+        g_stop = 1;
+    }
+
+    run->timed_out = 0;
+
+    if(pool_wait(pool, cfg->timeout > 0.0 ? &deadline : NULL) < 0) {
+        run->timed_out = 1;
+        g_timeout      = 1;
+        g_stop         = 1;
+
+        /* Keep kicking parked consumers until they have all seen it */
+        do {
+            for(i=0; i < nconsumers; i++)
+                park_wake(&g_parkers[i], cfg->wait);
+
+            deadline_after(&deadline, 0.01);
+        } while(pool_wait(pool, &deadline) < 0);
+    }
+
+    pthread_barrier_destroy(&g_end_barrier);
+    pthread_barrier_destroy(&g_barrier);
+
+    /* --queue-stats:  what the queues counted themselves */
+    memset(&run->qstats, 0, sizeof(run->qstats));
+
+    if(g_qstats)
+        queue->stats(nalloc, &run->qstats);
+
+    queue->destroy(nalloc);
+
+    phase_t producer_phase[nproducers];
+    phase_t consumer_phase[nconsumers];
+
+    for(i=0; i < nproducers; i++)
+        producer_phase[i] = producer_data[i].phase;
+
+    for(i=0; i < nconsumers; i++)
+        consumer_phase[i] = consumer_data[i].phase;
+
+    phase_summarize(&run->phases, producer_phase, nproducers,
+                    consumer_phase, nconsumers);
+
+    /* Under -d the count is whatever the consumers received */
+    long received = 0;
+
+    for(i=0; i < nconsumers; i++)
+        received += consumer_phase[i].msgs;
+
+    double usecF       = run->phases.window / tsc_per_nsec / 1000.0;
+    double n_msgs      = (double) received;
+    double n_producers = (double) nproducers;
+    printf("Time in microseconds: %f\n",usecF);
+    printf("n_msgs=%f n_producers=%f:  mmsgs/s=%f  mmsgs/s/producer=%f\n",
+           n_msgs, n_producers, n_msgs/usecF,
+           n_msgs/usecF/n_producers);
+
+    if(cfg->rate > 0.0)
+        printf("Offered mmsgs/s=%f achieved mmsgs/s=%f\n",
+               cfg->rate/1e6, n_msgs/usecF);
+
+    /* A timed out run reports -1, as run.sh used to when it killed one */
+    if(run->timed_out) {
+        printf("Timed out after %g sec\n", cfg->timeout);
+        printf("DATAOUT %d %d %ld %f %f %d\n",
+               nproducers,nconsumers,received,-1.0,-1.0,cfg->batch);
+    } else
+        printf("DATAOUT %d %d %ld %f %f %d\n",
+               nproducers,nconsumers,received,
+               n_msgs/usecF,n_msgs/usecF/n_producers,cfg->batch);
+
+    phase_print(stdout, &run->phases, nproducers, nconsumers, received,
+                tsc_per_nsec);
+
+    /* --payload:  the same rate in payload bytes */
+    run->corrupt = 0;
+
+    for(i=0; i < nconsumers; i++)
+        run->corrupt += consumer_data[i].corrupt;
+
+    if(cfg->payload) {
+        printf("Payload %d bytes by %s: mbytes/s=%f corrupt=%lu\n",
+               cfg->payload, cfg->queue->payload ? "value" : "pointer",
+               n_msgs*cfg->payload/usecF, run->corrupt);
+        printf("BYTESOUT %d %d %ld %d %f\n",
+               nproducers,nconsumers,received,cfg->payload,
+               run->timed_out ? -1.0 : n_msgs*cfg->payload/usecF);
+    }
+
+    if(cfg->latency) {
+        hist_t *hist = hist_alloc();
+
+        for(i=0; i < nconsumers; i++) {
+            hist_merge(hist, consumer_data[i].hist);
+            hist_free(consumer_data[i].hist);
+        }
+
+        run->lat[0] = hist_percentile(hist, 50.0)/tsc_per_nsec;
+        run->lat[1] = hist_percentile(hist, 90.0)/tsc_per_nsec;
+        run->lat[2] = hist_percentile(hist, 99.0)/tsc_per_nsec;
+        run->lat[3] = hist_percentile(hist, 99.9)/tsc_per_nsec;
+        run->lat[4] = hist->max/tsc_per_nsec;
+
+        printf("Latency (nsec): n=%lu p50=%.0f p90=%.0f p99=%.0f p99.9=%.0f max=%.0f\n",
+               (unsigned long)hist->count,
+               run->lat[0], run->lat[1], run->lat[2], run->lat[3], run->lat[4]);
+        printf("LATOUT %d %d %ld %f %f %f %f %f\n",
+               nproducers,nconsumers,received,
+               run->lat[0], run->lat[1], run->lat[2], run->lat[3], run->lat[4]);
+        hist_free(hist);
+    }
+
+    if(cfg->pingpong) {
+        hist_t *hist = hist_alloc();
+
+        for(i=0; i < nproducers; i++) {
+            hist_merge(hist, producer_data[i].hist);
+            hist_free(producer_data[i].hist);
+        }
+
+        run->rtt[0] = hist->count ? hist_percentile(hist, 50.0)/tsc_per_nsec : NAN;
+        run->rtt[1] = hist->count ? hist_percentile(hist, 90.0)/tsc_per_nsec : NAN;
+        run->rtt[2] = hist->count ? hist_percentile(hist, 99.0)/tsc_per_nsec : NAN;
+        run->rtt[3] = hist->count ? hist_percentile(hist, 99.9)/tsc_per_nsec : NAN;
+        run->rtt[4] = hist->count ? hist->max/tsc_per_nsec : NAN;
+
+        printf("Round trip (nsec): n=%lu p50=%.0f p90=%.0f p99=%.0f p99.9=%.0f max=%.0f\n",
+               (unsigned long)hist->count,
+               run->rtt[0], run->rtt[1], run->rtt[2], run->rtt[3], run->rtt[4]);
+        printf("PINGOUT %d %d %lu %f %f %f %f %f\n",
+               nproducers,nconsumers,(unsigned long)hist->count,
+               run->rtt[0], run->rtt[1], run->rtt[2], run->rtt[3], run->rtt[4]);
+        hist_free(hist);
+    }
+
+    run->local  = 0;
+    run->remote = 0;
+
+    if(cfg->numa) {
+        for(i=0; i < nconsumers; i++) {
+            run->local  += consumer_data[i].local;
+            run->remote += consumer_data[i].remote;
+        }
+
+        printf("NUMA handoff: local=%lu (%f mmsgs/s) remote=%lu (%f mmsgs/s)\n",
+               run->local, run->local/usecF, run->remote, run->remote/usecF);
+        printf("NUMAOUT %d %d %ld %f %f\n",
+               nproducers,nconsumers,received,
+               run->local/usecF, run->remote/usecF);
+    }
+
+    /* --wait:  how long a parked consumer took to notice a message, */
+    /* what waking it cost the producers, and how much CPU the       */
+    /* consumers burnt over the run                                  */
+    hist_t  *wake = hist_alloc();
+    uint64_t notify = 0, notifies = 0;
+    double   cpu = 0.0, wall = 0.0;
+
+    run->parks = 0;
+
+    for(i=0; i < nconsumers; i++) {
+        hist_merge(wake, consumer_data[i].wake_hist);
+        hist_free(consumer_data[i].wake_hist);
+        run->parks += consumer_data[i].parks;
+        cpu        += consumer_data[i].cpu_nsec;
+        wall       += (consumer_phase[i].stop - consumer_phase[i].start) / tsc_per_nsec;
+    }
+
+    for(i=0; i < nproducers; i++) {
+        notify   += producer_data[i].notify;
+        notifies += producer_data[i].notifies;
+    }
+
+    run->wake[0]    = wake->count ? hist_percentile(wake, 50.0)/tsc_per_nsec : NAN;
+    run->wake[1]    = wake->count ? hist_percentile(wake, 99.0)/tsc_per_nsec : NAN;
+    run->wake[2]    = wake->count ? wake->max/tsc_per_nsec : NAN;
+    run->notify_cpc = notifies ? (double)notify/notifies : NAN;
+    run->cpu_pct    = wall > 0.0 ? 100.0 * cpu / wall : NAN;
+    hist_free(wake);
+
+    if(cfg->wait != WAIT_SPIN) {
+        printf("Wait %s: parks=%lu wake latency (nsec) p50=%.0f p99=%.0f max=%.0f "
+               "notify cycles/call=%.1f consumer cpu=%.1f%%\n",
+               g_wait_names[cfg->wait], run->parks,
+               run->wake[0], run->wake[1], run->wake[2],
+               run->notify_cpc, run->cpu_pct);
+        printf("WAITOUT %d %d %ld %lu %f %f %f %f\n",
+               nproducers,nconsumers,received,run->parks,
+               run->wake[0], run->wake[1], run->notify_cpc, run->cpu_pct);
+    }
+
+    /* --backoff:  every failed poll or full ring check is one more  */
+    /* read of a line another core is writing, so waits per message  */
+    /* stand in for the coherence traffic the policy saves or costs  */
+    uint64_t prod_waits = 0, cons_waits = 0;
+
+    for(i=0; i < nproducers; i++)
+        prod_waits += producer_data[i].waits;
+
+    for(i=0; i < nconsumers; i++)
+        cons_waits += consumer_data[i].waits;
+
+    run->prod_wpm = received ? (double)prod_waits/received : NAN;
+    run->cons_wpm = received ? (double)cons_waits/received : NAN;
+    printf("Backoff %s: producer waits/msg=%.3f consumer waits/msg=%.3f\n",
+           backoff_name(g_backoff), run->prod_wpm, run->cons_wpm);
+    printf("BACKOFFOUT %d %d %ld %f %f\n",
+           nproducers,nconsumers,received,run->prod_wpm,run->cons_wpm);
+
+    /* -Q:  what the bound cost the producers */
+    uint64_t stall = 0, rejects = 0, prod_wall = 0;
+
+    for(i=0; i < nproducers; i++) {
+        stall     += producer_data[i].stall;
+        rejects   += producer_data[i].rejects;
+        prod_wall += producer_phase[i].stop - producer_phase[i].start;
+    }
+
+    run->stall_pct   = prod_wall ? 100.0*stall/prod_wall : NAN;
+    run->reject_rate = received+rejects ? (double)rejects/(received+rejects) : NAN;
+
+    if(cfg->capacity) {
+        printf("Capacity %d: producer stall=%.1f%% rejected enqueues=%lu (%.3f of attempts)\n",
+               cfg->capacity, run->stall_pct, (unsigned long)rejects,
+               run->reject_rate);
+        printf("CAPOUT %d %d %ld %d %f %f\n",
+               nproducers,nconsumers,received,cfg->capacity,
+               run->stall_pct, run->reject_rate);
+    }
+
+    /* --work:  how much of the consumers' time the service model took */
+    uint64_t prod_work = 0, cons_work = 0, cons_wall = 0;
+    char     cname[64], pname[64];
+
+    for(i=0; i < nproducers; i++)
+        prod_work += producer_data[i].work_cycles;
+
+    for(i=0; i < nconsumers; i++) {
+        cons_work += consumer_data[i].work_cycles;
+        cons_wall += consumer_phase[i].stop - consumer_phase[i].start;
+    }
+
+    run->cons_work = received ? (double)cons_work/received : NAN;
+    run->prod_work = received ? (double)prod_work/received : NAN;
+    run->work_util = cons_wall ? 100.0*cons_work/cons_wall : NAN;
+
+    if(g_consumer_work.kind != SERVICE_NONE || g_producer_work.kind != SERVICE_NONE) {
+        printf("Work consumer %s producer %s: consumer work cycles/msg=%.1f "
+               "utilization=%.1f%% producer work cycles/msg=%.1f\n",
+               service_name(&g_consumer_work, cname, sizeof(cname)),
+               service_name(&g_producer_work, pname, sizeof(pname)),
+               run->cons_work, run->work_util, run->prod_work);
+        printf("WORKOUT %d %d %ld %f %f %f\n",
+               nproducers,nconsumers,received,
+               run->cons_work, run->work_util, run->prod_work);
+    }
+
+    /* --perf:  each role's counters over its own timed region */
+    perf_sum_init(&run->prod_perf);
+    perf_sum_init(&run->cons_perf);
+
+    for(i=0; i < nproducers; i++)
+        perf_sum(&run->prod_perf, &producer_data[i].perf);
+
+    for(i=0; i < nconsumers; i++)
+        perf_sum(&run->cons_perf, &consumer_data[i].perf);
+
+    perf_print(stdout, "producer", nproducers, nconsumers, &run->prod_perf, received);
+    perf_print(stdout, "consumer", nproducers, nconsumers, &run->cons_perf, received);
+
+    /* --queue-stats:  and what the threads counted in them */
+    for(i=0; i < nproducers; i++)
+        qstats_sum(&run->qstats, &producer_data[i].qstats);
+
+    for(i=0; i < nconsumers; i++)
+        qstats_sum(&run->qstats, &consumer_data[i].qstats);
+
+    qstats_print(stdout, nproducers, nconsumers, &run->qstats, received);
+
+    /* --reorder:  how far the queue let messages of one producer */
+    /* overtake each other, as each consumer received them         */
+    uint64_t reordered = 0, reorder_dist = 0;
+
+    run->reorder_max = 0;
+
+    for(i=0; i < nconsumers; i++) {
+        reordered    += consumer_data[i].reordered;
+        reorder_dist += consumer_data[i].reorder_dist;
+
+        if(consumer_data[i].reorder_max > run->reorder_max)
+            run->reorder_max = consumer_data[i].reorder_max;
+    }
+
+    run->reorder_frac = received ? (double)reordered/received : NAN;
+    run->reorder_mean = reordered ? (double)reorder_dist/reordered : 0.0;
+
+    if(cfg->reorder) {
+        printf("Reorder quasi=%d: out of order=%.4f of msgs, behind by mean=%.2f "
+               "max=%lu sends\n", cfg->quasi, run->reorder_frac,
+               run->reorder_mean, run->reorder_max);
+        printf("REORDEROUT %d %d %ld %d %f %f %f %lu\n",
+               nproducers,nconsumers,received,cfg->quasi,
+               run->timed_out ? -1.0 : n_msgs/usecF,
+               run->reorder_frac, run->reorder_mean, run->reorder_max);
+    }
+
+    run->nproducers    = nproducers;
+    run->nconsumers    = nconsumers;
+    run->received      = received;
+    run->usecF         = usecF;
+    run->consumer_rate = (double *)malloc(sizeof(double) * nconsumers);
+
+    for(i=0; i < nconsumers; i++)
+        run->consumer_rate[i] = consumer_phase[i].msgs * tsc_per_nsec * 1000.0 /
+                                (consumer_phase[i].stop - consumer_phase[i].start);
+
+    /* --topology:  how evenly the work was spread over the consumers */
+    uint64_t stolen = 0, most = 0, least = received;
+    double   mean   = (double)received/nconsumers;
+
+    run->consumer_msgs = (double *)malloc(sizeof(double) * nconsumers);
+
+    for(i=0; i < nconsumers; i++) {
+        run->consumer_msgs[i] = consumer_phase[i].msgs;
+        stolen               += consumer_data[i].stolen;
+
+        if(consumer_phase[i].msgs > most)
+            most = consumer_phase[i].msgs;
+
+        if(consumer_phase[i].msgs < least)
+            least = consumer_phase[i].msgs;
+    }
+
+    run->imbalance  = received ? most/mean : NAN;
+    run->stolen_pct = received ? 100.0*stolen/received : NAN;
+    printf("Topology %s: consumer msgs min=%lu max=%lu mean=%.0f imbalance=%.3f "
+           "stolen=%.1f%%\n", g_topology_names[cfg->topology],
+           (unsigned long)least, (unsigned long)most, mean, run->imbalance,
+           run->stolen_pct);
+    printf("TOPOOUT %d %d %ld %f %f %f\n",
+           nproducers,nconsumers,received,
+           received ? least/mean : NAN, run->imbalance, run->stolen_pct);
+
+    /* Pairs share nothing, so each pair's rate is its own result */
+    if(cfg->topology == TOPO_PAIRS)
+        for(i=0; i < nconsumers; i++)
+            printf("PAIROUT %d %d %d %lu %f\n",
+                   nproducers,nconsumers,i,
+                   (unsigned long)consumer_phase[i].msgs,
+                   run->consumer_rate[i]);
+
+    parkers_free(g_parkers, nconsumers);
+    free(g_gates);
+    free(g_producer_node);
+}
+
+/* One record per point, detailed from its median run */
+static void run_record(const config_t *cfg, const run_t *run,
+                       const point_t *point,
+                       const char *json, const char *csv)
+{
+    result_t *res    = result_new("qrate");
+    double    n_msgs = (double) run->received;
+    char      seed[24];     /* as a string:  JSON numbers lose 64 bit seeds */
+
+    snprintf(seed, sizeof(seed), "%llu", (unsigned long long)g_seed);
+
+    result_str(res, "queue", cfg->queue->name);
+    result_int(res, "producers", run->nproducers);
+    result_int(res, "consumers", run->nconsumers);
+    result_int(res, "messages", run->received);
+    result_str(res, "placement", placement_name(cfg->placement));
+    result_str(res, "seed", seed);
+    result_int(res, "numa", cfg->numa);
+    result_int(res, "message_size", g_node_size);
+    result_int(res, "payload_bytes", cfg->payload);
+    result_str(res, "transport", cfg->queue->payload ? "value" : "pointer");
+    result_str(res, "gc", cfg->gc < 0 ? "none" : g_cds_gc_names[cfg->gc]);
+
+    if(cfg->fc) {
+        result_int(res, "fc_passes", g_fc_passes);
+        result_int(res, "fc_compact", g_fc_compact);
+        result_str(res, "fc_wait", fc_wait_name(g_fc_wait));
+    }
+
+    result_int(res, "eliminate", cfg->eliminate);
+
+    if(cfg->quasi)
+        result_int(res, "quasi_factor", cfg->quasi);
+
+    result_int(res, "batch", cfg->batch);
+    result_int(res, "randomize", cfg->randomize);
+    result_num(res, "duration", cfg->duration);
+    result_num(res, "offered_msgs_per_sec", cfg->rate);
+    result_num(res, "usec", run->usecF);
+    result_num(res, "mmsgs_per_sec", n_msgs/run->usecF);
+    result_num(res, "mmsgs_per_sec_per_producer",
+               n_msgs/run->usecF/run->nproducers);
+
+    if(cfg->payload) {
+        result_num(res, "mbytes_per_sec", n_msgs*cfg->payload/run->usecF);
+        result_int(res, "corrupt", run->corrupt);
+    }
+    result_nums(res, "consumer_mmsgs_per_sec", run->consumer_rate,
+                run->nconsumers);
+    result_str(res, "topology", g_topology_names[cfg->topology]);
+    result_nums(res, "consumer_msgs", run->consumer_msgs, run->nconsumers);
+    result_num(res, "consumer_imbalance", run->imbalance);
+    result_num(res, "stolen_pct", run->stolen_pct);
+    result_num(res, "producer_cycles_per_msg", run->phases.prod_cpm);
+    result_num(res, "consumer_cycles_per_msg", run->phases.cons_cpm);
+    result_num(res, "consumer_empty_pct", run->phases.empty_pct);
+    result_num(res, "barrier_skew_nsec", run->phases.skew / g_tsc_per_nsec);
+
+    if(cfg->latency) {
+        result_num(res, "latency_p50_nsec", run->lat[0]);
+        result_num(res, "latency_p90_nsec", run->lat[1]);
+        result_num(res, "latency_p99_nsec", run->lat[2]);
+        result_num(res, "latency_p999_nsec", run->lat[3]);
+        result_num(res, "latency_max_nsec", run->lat[4]);
+    }
+
+    if(cfg->pingpong) {
+        result_int(res, "pingpong_rounds", cfg->pingpong);
+        result_num(res, "rtt_p50_nsec", run->rtt[0]);
+        result_num(res, "rtt_p90_nsec", run->rtt[1]);
+        result_num(res, "rtt_p99_nsec", run->rtt[2]);
+        result_num(res, "rtt_p999_nsec", run->rtt[3]);
+        result_num(res, "rtt_max_nsec", run->rtt[4]);
+    }
+
+    if(cfg->numa) {
+        result_num(res, "local_mmsgs_per_sec", run->local/run->usecF);
+        result_num(res, "remote_mmsgs_per_sec", run->remote/run->usecF);
+    }
+
+    result_str(res, "wait", g_wait_names[cfg->wait]);
+
+    if(cfg->wait != WAIT_SPIN) {
+        result_int(res, "parks", run->parks);
+        result_num(res, "wake_p50_nsec", run->wake[0]);
+        result_num(res, "wake_p99_nsec", run->wake[1]);
+        result_num(res, "wake_max_nsec", run->wake[2]);
+        result_num(res, "notify_cycles_per_call", run->notify_cpc);
+    }
+
+    result_num(res, "consumer_cpu_pct", run->cpu_pct);
+    result_str(res, "backoff", backoff_name(g_backoff));
+    result_num(res, "producer_waits_per_msg", run->prod_wpm);
+    result_num(res, "consumer_waits_per_msg", run->cons_wpm);
+
+    char cname[64], pname[64];
+
+    result_str(res, "consumer_work", service_name(&g_consumer_work, cname, sizeof(cname)));
+    result_str(res, "producer_work", service_name(&g_producer_work, pname, sizeof(pname)));
+    result_num(res, "consumer_work_cycles_per_msg", run->cons_work);
+    result_num(res, "producer_work_cycles_per_msg", run->prod_work);
+    result_num(res, "consumer_work_pct", run->work_util);
+    result_int(res, "capacity", cfg->capacity);
+
+    if(cfg->capacity) {
+        result_num(res, "producer_stall_pct", run->stall_pct);
+        result_num(res, "reject_rate", run->reject_rate);
+    }
+
+    perf_record(res, "producer", &run->prod_perf, run->received);
+    perf_record(res, "consumer", &run->cons_perf, run->received);
+    qstats_record(res, &run->qstats, run->received);
+
+    if(cfg->reorder) {
+        result_num(res, "reorder_frac", run->reorder_frac);
+        result_num(res, "reorder_mean_sends", run->reorder_mean);
+        result_int(res, "reorder_max_sends", run->reorder_max);
+    }
+
+    result_int(res, "repeats", point->repeats);
+    result_int(res, "timeouts", point->timeouts);
+    result_num(res, "timeout", cfg->timeout);
+    result_num(res, "mmsgs_per_sec_median", point->median);
+    result_num(res, "mmsgs_per_sec_ci95_low", point->lo);
+    result_num(res, "mmsgs_per_sec_ci95_high", point->hi);
+    result_nums(res, "mmsgs_per_sec_samples", point->samples, point->nsamples);
+
+    result_num(res, "tsc_ghz", g_tsc_per_nsec);
+    result_host(res, g_topo);
+
+    if(json)
+        result_write(res, json, RESULT_JSON);
+
+    if(csv)
+        result_write(res, csv, RESULT_CSV);
+
+    result_free(res);
+}
+
 int main(int argc, char *argv[])
 {
-    struct timeval   ti, tf;
-    pthread_attr_t   attr;
-    cpu_set_t        cpus;
-    int              i, j, n, d, depth;
-    hwloc_obj_t      obj;
-    int c, nproducers = 0, nconsumers=0, nmessages=0, randomize=0;
-
-    while((c = getopt(argc, argv, "rp:c:m:")) != -1)
+    int              i, j, k, r;
+    const queue_entry_t *queue = NULL;
+    int c, nproducers = 0, nconsumers=0, nmessages=0, randomize=0, latency=0, batch=1;
+    int              placement = PLACE_LEGACY, numa = 0;
+    int              sweep = 0, repeats = 1, wait = WAIT_SPIN;
+    int              topology = TOPO_SHARDED, pingpong = 0, seeded = 0;
+    int              payload = 0, byvalue = 0, capacity = 0, gc = -1, fc = 0;
+    int              quasi = -1, quasi_sweep = 0, reorder = 0, segmented = 0;
+    double           duration = 0.0, rate = 0.0, timeout = 0.0;
+    const char      *json = NULL, *csv = NULL;
+
+    static struct option long_options[] = {
+        {"placement", required_argument, NULL, 'P'},
+        {"numa",      no_argument,       NULL, 'N'},
+        {"json",      required_argument, NULL, 'J'},
+        {"csv",       required_argument, NULL, 'C'},
+        {"sweep",     required_argument, NULL, 'S'},
+        {"repeat",    required_argument, NULL, 'E'},
+        {"timeout",   required_argument, NULL, 'T'},
+        {"wait",      required_argument, NULL, 'W'},
+        {"backoff",   required_argument, NULL, 'B'},
+        {"topology",  required_argument, NULL, 'O'},
+        {"pingpong",  required_argument, NULL, 'G'},
+        {"payload",   required_argument, NULL, 'Y'},
+        {"by-value",  no_argument,       NULL, 'V'},
+        {"work",      required_argument, NULL, 'X'},
+        {"produce-work", required_argument, NULL, 'Z'},
+        {"perf",      no_argument,       NULL, 'F'},
+        {"perf-raw",  required_argument, NULL, 'H'},
+        {"seed",      required_argument, NULL, 'D'},
+        {"gc",        required_argument, NULL, 'K'},
+        {"queue-stats", no_argument,     NULL, 'U'},
+        {"fc-passes", required_argument, NULL, 'A'},
+        {"fc-compact", required_argument, NULL, 'I'},
+        {"fc-wait",   required_argument, NULL, 'M'},
+        {"eliminate", required_argument, NULL, 'L'},
+        {"quasi",     required_argument, NULL, 'k'},
+        {"quasi-sweep", no_argument,     NULL, 's'},
+        {"reorder",   no_argument,       NULL, 'o'},
+        {NULL,        0,                 NULL, 0}
+    };
+
+    while((c = getopt_long(argc, argv, "lrq:p:c:m:b:d:R:Q:", long_options, NULL)) != -1)
         switch(c) {
+            case 'N':
+                numa = 1;
+                break;
+
+            case 'J':
+                json = optarg;
+                break;
+
+            case 'C':
+                csv = optarg;
+                break;
+
+            case 'S':
+                sweep = atoi(optarg);
+                break;
+
+            case 'E':
+                repeats = atoi(optarg);
+                break;
+
+            case 'T':
+                timeout = atof(optarg);
+                break;
+
+            case 'W':
+                wait = wait_lookup(optarg);
+
+                if(wait < 0) {
+                    fprintf(stderr, "Unknown wait mode `%s'.\n", optarg);
+                    wait_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'O':
+                for(topology = 0; topology < TOPO_COUNT; topology++)
+                    if(strcmp(g_topology_names[topology], optarg) == 0)
+                        break;
+
+                if(topology == TOPO_COUNT) {
+                    fprintf(stderr, "Unknown topology `%s'.\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            case 'G':
+                pingpong = atoi(optarg);
+                break;
+
+            case 'Y':
+                payload = atoi(optarg);
+                break;
+
+            case 'V':
+                byvalue = 1;
+                break;
+
+            case 'F':
+                g_perf = 1;
+                break;
+
+            case 'D':
+                g_seed = strtoull(optarg, NULL, 0);
+                seeded = 1;
+                break;
+
+            case 'U':
+                g_qstats = 1;
+                break;
+
+            case 'K':
+                gc = cds_gc_lookup(optarg);
+
+                if(gc < 0) {
+                    fprintf(stderr, "Unknown gc `%s'.\n", optarg);
+                    cds_gc_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'H':
+                g_perf     = 1;
+                g_perf_raw = strtoull(optarg, NULL, 16);
+                break;
+
+            case 'A':
+                g_fc_passes = atoi(optarg);
+                fc = 1;
+                break;
+
+            case 'I':
+                g_fc_compact = atoi(optarg);
+                fc = 1;
+                break;
+
+            case 'M':
+                g_fc_wait = fc_wait_lookup(optarg);
+                fc = 1;
+
+                if(g_fc_wait < 0) {
+                    fprintf(stderr, "Unknown fc wait `%s'.\n", optarg);
+                    fc_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'L':
+                g_elim_slots = atoi(optarg);
+                break;
+
+            case 'k':
+                quasi = atoi(optarg);
+                break;
+
+            case 's':
+                quasi_sweep = 1;
+                break;
+
+            case 'o':
+                reorder = 1;
+                break;
+
+            case 'X':
+            case 'Z':
+                if(service_parse(optarg, c == 'X' ? &g_consumer_work
+                                                  : &g_producer_work) < 0) {
+                    fprintf(stderr, "Unknown work model `%s'.\n", optarg);
+                    service_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'B':
+                g_backoff = backoff_lookup(optarg);
+
+                if(g_backoff < 0) {
+                    fprintf(stderr, "Unknown backoff `%s'.\n", optarg);
+                    backoff_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'P':
+                placement = placement_lookup(optarg);
+
+                if(placement < 0) {
+                    fprintf(stderr, "Unknown placement `%s'.\n", optarg);
+                    placement_usage(stderr);
+                    return 1;
+                }
+
+                break;
+
+            case 'q':
+                queue = queue_lookup(g_queues, N_QUEUES, optarg);
+
+                if(!queue) {
+                    fprintf(stderr, "Unknown queue `%s'.\n", optarg);
+                    queue_usage(stderr, g_queues, N_QUEUES);
+                    return 1;
+                }
+
+                break;
+
+            case 'l':
+                latency = 1;
+                break;
+
             case 'r':
                 randomize = 1;
                 break;
@@ -291,6 +2009,22 @@ int main(int argc, char *argv[])
                 nmessages = atoi(optarg);
                 break;
 
+            case 'b':
+                batch = atoi(optarg);
+                break;
+
+            case 'd':
+                duration = atof(optarg);
+                break;
+
+            case 'R':
+                rate = atof(optarg);
+                break;
+
+            case 'Q':
+                capacity = atoi(optarg);
+                break;
+
             case '?':
                 if(optopt == 'p')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
@@ -298,6 +2032,21 @@ int main(int argc, char *argv[])
                 if(optopt == 'c')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
 
+                if(optopt == 'b')
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+
+                if(optopt == 'd')
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+
+                if(optopt == 'R')
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+
+                if(optopt == 'Q')
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+
+                if(optopt == 'q')
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+
                 if(optopt == 'm')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 else if(isprint(optopt))
@@ -312,134 +2061,310 @@ int main(int argc, char *argv[])
             default:
                 abort();
         }
+    /* --payload rounds up to a size the by-value queues are built for */
+    if(payload > 0 && payload <= PAYLOAD_MAX) {
+        int size = 8;
 
-    if(nproducers < 1 || nconsumers < 1 || (nproducers < nconsumers) ||
-       nmessages < nconsumers) {
-        fprintf(stderr, "Usage:  -p <num> -c <num> -m with (p <= c) and (m >= c)\n");
-        return 1;
-    }
+        while(size < payload)
+            size <<= 1;
 
-    printf("Starting mpsc with %s queue P:%d C:%d NM:%d\n",
-           QUEUE_NAME,nproducers, nconsumers,nmessages);
-    pthread_t        producers[nproducers];
-    pthread_t        consumers[nconsumers];
-    thread_data_t    producer_data[nproducers];
-    thread_data_t    consumer_data[nconsumers];
-    int              messages_per_thread = nmessages/nproducers;
-    int              total_messages      = messages_per_thread*nproducers;
-    Q = initQ(nconsumers, nproducers, nmessages);
-    g_random_fd = urandom_init();
-    hwloc_topology_init(&g_topo);
-    hwloc_topology_load(g_topo);
-
-    depth=hwloc_topology_get_depth(g_topo);
+        payload = size;
+    }
 
-    for(d=0; d<depth; d++) {
-        n=hwloc_get_nbobjs_by_depth(g_topo,d);
+    if(byvalue && queue && payload > 0 && payload <= PAYLOAD_MAX) {
+        const queue_entry_t *value = value_queue_lookup(g_value_queues, N_VALUE_QUEUES,
+                                                        queue->name, payload);
 
-        for(i=0; i<n; i++) {
-            obj=hwloc_get_obj_by_depth(g_topo,d,i);
+        if(!value) {
+            fprintf(stderr, "Queue `%s' has no by-value mode.\n", queue->name);
+            return 1;
         }
-    }
 
-    n   = hwloc_get_nbobjs_by_type(g_topo, HWLOC_OBJ_CORE);
+        queue = value;
+    }
 
-    for(i=0; i<n; i++) {
-        obj = hwloc_get_obj_by_type(g_topo, HWLOC_OBJ_CORE, i);
+    /* --gc:  the same libcds queue built over the other reclamation, */
+    /* and --queue-stats:  with its stat policies on                   */
+    if(queue && queue_lookup(g_dhp_queues, N_DHP_QUEUES, queue->name)) {
+        if(gc == CDS_GC_DHP)
+            queue = g_qstats ?
+                    queue_lookup(g_dhp_stat_queues, N_DHP_STAT_QUEUES, queue->name) :
+                    queue_lookup(g_dhp_queues, N_DHP_QUEUES, queue->name);
+        else if(g_qstats)
+            queue = queue_lookup(g_stat_queues, N_STAT_QUEUES, queue->name);
+
+        if(gc < 0)
+            gc = CDS_GC_HP;
+    } else if(queue && gc >= 0) {
+        fprintf(stderr, "Queue `%s' has no --gc, only the libcds lock-free queues do.\n",
+                queue->name);
+        return 1;
+    } else if(queue && g_qstats &&
+              queue_lookup(g_stat_queues, N_STAT_QUEUES, queue->name))
+        queue = queue_lookup(g_stat_queues, N_STAT_QUEUES, queue->name);
+
+    /* --fc-wait:  fcqueue built with that wait strategy */
+    if(queue && queue_lookup(g_fc_queues[0], FC_WAIT_COUNT, queue->name)) {
+        queue = &g_fc_queues[g_qstats][g_fc_wait];
+        fc    = 1;
+    } else if(queue && fc) {
+        fprintf(stderr, "Queue `%s' has no --fc-* options, only fcqueue does.\n",
+                queue->name);
+        return 1;
     }
 
-    pthread_attr_init(&attr);
-    pthread_barrier_init(&g_barrier, NULL, nproducers+nconsumers+1);
+    /* --quasi:  segmented only, whichever table it came from */
+    if(queue && strcmp(queue->name, "segmented") == 0) {
+        segmented = 1;
 
-    for(i=0,j=1; i < nproducers; i++) {
-        CPU_ZERO(&cpus);
-        obj = hwloc_get_obj_by_type(g_topo, HWLOC_OBJ_CORE, j);
-        hwloc_cpuset_to_glibc_sched_affinity(g_topo,obj->cpuset,
-                                             &cpus,sizeof(cpus));
-        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
-        producer_data[i].index               = i;
-        producer_data[i].obj                 = obj;
-        producer_data[i].nconsumers          = nconsumers;
-        producer_data[i].nproducers          = nproducers;
-        producer_data[i].messages_per_thread = messages_per_thread;
-        producer_data[i].total_messages      = total_messages;
-        producer_data[i].randomize           = randomize;
+        if(quasi < 0)
+            quasi = CDS_QUASI_FACTOR;
 
-        int ret = pthread_create(producers + i, &attr, do_produce, (void *)&producer_data[i]);
+        /* As the queue rounds it */
+        if(quasi > 0 && quasi <= QUASI_MAX) {
+            int factor = 2;
 
-        if(ret != 0) {
-            exit(1);
-        } else {
-            DEBUG_PRINT("Spawned producer thread %d\n", i);
+            while(factor < quasi)
+                factor <<= 1;
+
+            quasi = factor;
+        }
+    } else if(queue && (quasi >= 0 || quasi_sweep)) {
+        fprintf(stderr, "Queue `%s' has no --quasi, only segmented does.\n",
+                queue->name);
+        return 1;
+    } else
+        quasi = 0;
+
+    /* --eliminate:  the queue picked so far, behind the slots */
+    if(queue && g_elim_slots) {
+        const queue_entry_t *elim = NULL;
+
+        if(!queue->payload && gc != CDS_GC_DHP && g_fc_wait == FC_WAIT_BACKOFF)
+            elim = g_qstats && queue_lookup(g_elim_stat_queues, N_ELIM_STAT_QUEUES, queue->name) ?
+                   queue_lookup(g_elim_stat_queues, N_ELIM_STAT_QUEUES, queue->name) :
+                   queue_lookup(g_elim_queues, N_ELIM_QUEUES, queue->name);
+
+        if(!elim) {
+            fprintf(stderr, "Queue `%s' has no --eliminate here:  not by value, --gc dhp\n"
+                    "or --fc-wait other than backoff.\n", queue->name);
+            return 1;
         }
 
-        if(i<=(nconsumers-2)) j+=2;
-        else j+=1;
+        queue = elim;
     }
 
-    for(i=0, j=0; i < nconsumers; i++,j+=2) {
-        CPU_ZERO(&cpus);
-        obj = hwloc_get_obj_by_type(g_topo, HWLOC_OBJ_CORE, j);
-        hwloc_cpuset_to_glibc_sched_affinity(g_topo,obj->cpuset,
-                                             &cpus,sizeof(cpus));
-        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
-
-        consumer_data[i].index               = i;
-        consumer_data[i].obj                 = obj;
-        consumer_data[i].nconsumers          = nconsumers;
-        consumer_data[i].nproducers          = nproducers;
-        consumer_data[i].messages_per_thread = messages_per_thread;
-        consumer_data[i].total_messages      = total_messages;
-        consumer_data[i].randomize           = randomize;
-
-        int ret = pthread_create(consumers+i, &attr, do_consume, (void *)&consumer_data[i]);
-
-        if(ret != 0) {
-            exit(1);
-        } else {
-            DEBUG_PRINT("Spawned consumer thread %d\n", i);
-        }
+    /* --sweep covers every split of up to that many threads, as run.sh */
+    /* did:  c consumers and c <= p producers, with p + c <= threads     */
+    int maxp = sweep ? sweep-1 : nproducers;
+    int maxc = sweep ? sweep/2 : nconsumers;
+
+    if((sweep ? sweep < 2 : (nproducers < 1 || nconsumers < 1 ||
+                             nproducers < nconsumers)) ||
+       nmessages < maxc || batch < 1 || !queue ||
+       (int)g_fc_passes < 1 || (int)g_fc_compact < 1 ||
+       g_elim_slots < 0 || g_elim_slots > ELIM_SLOTS_MAX || (segmented && (quasi < 1 || quasi > QUASI_MAX)) ||
+       (reorder && (duration > 0.0 || pingpong)) ||
+       duration < 0.0 || rate < 0.0 || repeats < 1 || timeout < 0.0 ||
+       (timeout > 0.0 && timeout <= duration) ||
+       (wait == WAIT_BLOCKING && !queue->native_wait) ||
+       ((topology == TOPO_SHARED || topology == TOPO_STEAL) &&
+        (!queue->mpmc || wait != WAIT_SPIN)) ||
+       (queue->spsc && topology != TOPO_PAIRS) ||
+       (topology == TOPO_PAIRS && (randomize || (!sweep && nproducers != nconsumers))) ||
+       pingpong < 0 ||
+       capacity < 0 || capacity > CAPACITY_MAX ||
+       (capacity && (batch > capacity || pingpong)) ||
+       payload < 0 || payload > PAYLOAD_MAX || (byvalue && payload == 0) ||
+       (g_consumer_work.kind == SERVICE_TOUCH &&
+        g_consumer_work.arg * SERVICE_LINE > (uint64_t)payload) ||
+       (g_producer_work.kind == SERVICE_TOUCH &&
+        g_producer_work.arg * SERVICE_LINE > (uint64_t)payload) ||
+       (pingpong && (topology != TOPO_PAIRS || duration > 0.0 || rate > 0.0 ||
+                     batch > 1 || latency || wait != WAIT_SPIN)) ||
+       (duration > 0.0 && batch > nmessages/maxp)) {
+        fprintf(stderr, "Usage:  -q <queue> -p <num> -c <num> -m with (p <= c) and (m >= c)\n");
+        queue_usage(stderr, g_queues, N_QUEUES);
+        fprintf(stderr, "        -r randomize consumer queues, -l record latency\n");
+        fprintf(stderr, "        -b <num> producers enqueue batches of num messages\n");
+        fprintf(stderr, "        -d <sec> run for sec seconds; -m then bounds the messages in flight\n");
+        fprintf(stderr, "        -R <msgs/s> open loop: producers send at a combined msgs/s\n");
+        fprintf(stderr, "        -Q <nodes> bound every queue to nodes (up to %d, at least -b);\n", CAPACITY_MAX);
+        fprintf(stderr, "              producers retry refused enqueues; not with --pingpong\n");
+        fprintf(stderr, "        --numa build queues and node pools on their thread's NUMA node\n");
+        fprintf(stderr, "        --json <file>, --csv <file> append a results record to file\n");
+        fprintf(stderr, "        --sweep <threads> run every p/c split of up to threads instead of -p/-c\n");
+        fprintf(stderr, "        --repeat <num> run each point num times, report median and 95%% CI\n");
+        fprintf(stderr, "        --timeout <sec> stop a run after sec seconds (more than -d)\n");
+        wait_usage(stderr);
+        fprintf(stderr, "              blocking needs a queue with its own blocking dequeue (mcblock)\n");
+        backoff_usage(stderr);
+        fprintf(stderr, "        --topology <sharded|shared|steal> queue per consumer, one MPMC queue for all,\n");
+        fprintf(stderr, "              or per consumer with stealing; shared and steal need an MPMC queue\n");
+        fprintf(stderr, "              and --wait spin\n");
+        fprintf(stderr, "        --topology pairs p == c producer/consumer pairs, a queue each; the SPSC\n");
+        fprintf(stderr, "              queues (pcq, spsc) need it, and -r does not apply\n");
+        fprintf(stderr, "        --payload <bytes> carry bytes (up to %d, rounded up to a power of two)\n", PAYLOAD_MAX);
+        fprintf(stderr, "              after each node; producers write them, consumers read them\n");
+        fprintf(stderr, "        --by-value with --payload, the queue copies whole messages instead of\n");
+        fprintf(stderr, "              passing pointers (folly, mc, tbb)\n");
+        service_usage(stderr);
+        fprintf(stderr, "              touch needs --payload of at least 64 bytes per line\n");
+        fprintf(stderr, "        --pingpong <rounds> with pairs, each consumer sends every message back\n");
+        fprintf(stderr, "              and producers record round trips; not with -d, -R, -b, -l, --wait\n");
+        perf_usage(stderr);
+        fprintf(stderr, "        --seed <num> seed the -r queue order and the work draws, to replay a run\n");
+        cds_gc_usage(stderr);
+        fprintf(stderr, "              (msqueue, basket, moir, optimistic, segmented, treiber, treiberelim)\n");
+        qstats_usage(stderr);
+        fc_usage(stderr);
+        fprintf(stderr, "              (fcqueue)\n");
+        elim_usage(stderr);
+        fprintf(stderr, "              (pointer queues; treiber and treiberelim are LIFO outright)\n");
+        cds_quasi_usage(stderr);
+        fprintf(stderr, "        --reorder count the messages each consumer gets behind a later one\n");
+        fprintf(stderr, "              from the same producer, and by how many sends; not with -d\n");
+        fprintf(stderr, "              or --pingpong\n");
+        placement_usage(stderr);
+        return 1;
     }
 
-    /* staged printf Barrier */
-    for(i=0; i<nconsumers+nproducers+PRINT_BATCH; i+=PRINT_BATCH)
-        pthread_barrier_wait(&g_barrier);
+    config_t cfg;
+    cfg.queue     = queue;
+    cfg.nmessages = nmessages;
+    cfg.randomize = randomize;
+    cfg.latency   = latency;
+    cfg.batch     = batch;
+    cfg.placement = placement;
+    cfg.numa      = numa;
+    cfg.wait      = wait;
+    cfg.topology  = topology;
+    cfg.pingpong  = pingpong;
+    cfg.payload   = payload;
+    cfg.capacity  = capacity;
+    cfg.gc        = gc;
+    cfg.fc        = fc;
+    cfg.eliminate = g_elim_slots;
+    cfg.quasi     = quasi;
+    cfg.reorder   = reorder;
+
+    g_payload   = payload;
+    g_node_size = sizeof(work_node_t) + payload;
+    cfg.duration  = duration;
+    cfg.rate      = rate;
+    cfg.timeout   = timeout;
 
-    /* Start timer Barrier */
-    pthread_barrier_wait(&g_barrier);
-    pthread_barrier_wait(&g_barrier);
-    gettimeofday(&ti, NULL);
+    g_random_fd = urandom_init();
 
-    /* End timer Barrier */
-    pthread_barrier_wait(&g_barrier);
+    if(!seeded)
+        g_seed = urandom(g_random_fd);
 
-    /* End of job barrier for timing */
-    pthread_barrier_wait(&g_barrier);
-    gettimeofday(&tf, NULL);
+    printf("Seed %llu\n", (unsigned long long)g_seed);
+    hwloc_topology_init(&g_topo);
+    hwloc_topology_load(g_topo);
+    g_tsc_per_nsec = tsc_calibrate();
 
-    /* End of job barrier for printing */
-    pthread_barrier_wait(&g_barrier);
+    /* One topology and one set of threads for the whole sweep */
+    pool_t *pool = pool_create(g_topo, sweep ? sweep : nproducers+nconsumers);
 
-    for(i=0; i < nproducers; i++) {
-        pthread_join(producers[i], NULL);
+    /* The pool threads and main() attach to the libcds GCs */
+    if(gc >= 0) {
+        printf("GC %s\n", g_cds_gc_names[gc]);
+        cds_start((sweep ? sweep : nproducers+nconsumers) + 1);
     }
 
-    for(i=0; i < nconsumers; i++) {
-        pthread_join(consumers[i], NULL);
+    if(fc)
+        printf("FC passes=%u compact=%u wait=%s\n",
+               g_fc_passes, g_fc_compact, fc_wait_name(g_fc_wait));
+
+    if(g_elim_slots)
+        printf("Eliminate slots=%d\n", g_elim_slots);
+
+    /* --quasi-sweep:  every point again at each quasi factor, doubling */
+    /* from 2 up to --quasi                                             */
+    int quasis[32], nquasi = 0;
+
+    for(k = quasi_sweep ? 2 : quasi; k < quasi; k *= 2)
+        quasis[nquasi++] = k;
+
+    quasis[nquasi++] = quasi;
+
+    for(k = 0; k < nquasi; k++) {
+        cfg.quasi   = quasis[k];
+        g_cds_quasi = quasis[k];
+
+        if(segmented)
+            printf("Quasi factor %d\n", cfg.quasi);
+
+        /* pairs only has the p == c points */
+        for(j = maxc; j >= (sweep ? 1 : nconsumers); j--) {
+            int lastp = topology == TOPO_PAIRS ? j : sweep-j;
+
+            for(i = sweep ? j : nproducers; i <= (sweep ? lastp : nproducers); i++) {
+                hwloc_obj_t producer_obj[i];
+                hwloc_obj_t consumer_obj[j];
+                run_t       runs[repeats];
+                point_t     point;
+                int         median = -1;
+
+                placement_map(g_topo, placement, i, j, producer_obj, consumer_obj);
+                placement_print(stdout, g_topo, placement, i, j,
+                                producer_obj, consumer_obj);
+
+                point.repeats  = repeats;
+                point.timeouts = 0;
+                point.samples  = (double *)malloc(sizeof(double) * repeats);
+                point.nsamples = 0;
+
+                for(r = 0; r < repeats; r++) {
+                    run_once(pool, &cfg, i, j, producer_obj, consumer_obj, &runs[r]);
+
+                    if(runs[r].timed_out)
+                        point.timeouts++;
+                    else
+                        point.samples[point.nsamples++] = runs[r].received / runs[r].usecF;
+                }
+
+                stats_median_ci(point.samples, point.nsamples,
+                                &point.median, &point.lo, &point.hi);
+
+                /* Records carry the detail of the run closest to the median */
+                for(r = 0; r < repeats; r++)
+                    if(!runs[r].timed_out &&
+                       (median < 0 ||
+                        fabs(runs[r].received / runs[r].usecF - point.median) <
+                        fabs(runs[median].received / runs[median].usecF - point.median)))
+                        median = r;
+
+                if(repeats > 1 || sweep || quasi_sweep) {
+                    printf("Point P:%d C:%d runs=%d timeouts=%d mmsgs/s median=%f "
+                           "95%% CI=[%f, %f]\n", i, j, repeats, point.timeouts,
+                           point.median, point.lo, point.hi);
+                    printf("SWEEPOUT %d %d %d %d %f %f %f %d\n",
+                           i, j, repeats, point.timeouts,
+                           point.nsamples ? point.median : -1.0,
+                           point.nsamples ? point.lo : -1.0,
+                           point.nsamples ? point.hi : -1.0, batch);
+                }
+
+                if(json || csv)
+                    run_record(&cfg, &runs[median < 0 ? repeats-1 : median],
+                               &point, json, csv);
+
+                for(r = 0; r < repeats; r++) {
+                    free(runs[r].consumer_rate);
+                    free(runs[r].consumer_msgs);
+                }
+
+                free(point.samples);
+            }
+        }
     }
 
-    long usec = ((tf.tv_sec - ti.tv_sec)*1000000L+tf.tv_usec) - ti.tv_usec;
-    double usecF       = (double) usec;
-    double n_msgs      = (double) total_messages;
-    double n_producers = (double) nproducers;
-    printf("Time in microseconds: %f\n",usecF);
-    printf("n_msgs=%f n_producers=%f:  mmsgs/s=%f  mmsgs/s/producer=%f\n",
-           n_msgs, n_producers, n_msgs/usecF,
-           n_msgs/usecF/n_producers);
+    pool_destroy(pool);
 
-    printf("DATAOUT %d %d %d %f %f\n",
-           nproducers,nconsumers,total_messages,
-           n_msgs/usecF,n_msgs/usecF/n_producers);
+    if(gc >= 0)
+        cds_stop();
 
     return 0;
 }
@@ -0,0 +1,66 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <math.h>
+#include "qstats.h"
+
+int                g_qstats;
+__thread qstats_t  t_qstats;
+
+void qstats_usage(FILE *out)
+{
+    fprintf(out, "        --queue-stats count CAS failures, retries, empty pops and segment\n");
+    fprintf(out, "              allocations inside the queue, with the libcds stat policies on\n");
+}
+
+void qstats_sum(qstats_t *sum, const qstats_t *s)
+{
+    sum->enq_races  += s->enq_races;
+    sum->deq_races  += s->deq_races;
+    sum->retries    += s->retries;
+    sum->empty_pops += s->empty_pops;
+    sum->segments   += s->segments;
+    sum->left       += s->left;
+    sum->combines   += s->combines;
+    sum->eliminated += s->eliminated;
+    sum->sized      |= s->sized;
+}
+
+static double qstats_per_msg(uint64_t n, uint64_t msgs)
+{
+    return msgs ? (double)n / msgs : NAN;
+}
+
+void qstats_print(FILE *out, int p, int c, const qstats_t *s, uint64_t msgs)
+{
+    if(!g_qstats)
+        return;
+
+    fprintf(out, "Qstats per msg: enq_races=%.4f deq_races=%.4f retries=%.4f "
+            "empty_pops=%.4f segments=%.5f left=%ld combines=%.4f eliminated=%.4f\n",
+            qstats_per_msg(s->enq_races, msgs), qstats_per_msg(s->deq_races, msgs),
+            qstats_per_msg(s->retries, msgs), qstats_per_msg(s->empty_pops, msgs),
+            qstats_per_msg(s->segments, msgs), s->sized ? (long)s->left : -1L,
+            qstats_per_msg(s->combines, msgs), qstats_per_msg(s->eliminated, msgs));
+    fprintf(out, "QSTATOUT %d %d %lu %f %f %f %f %f %ld %f %f\n", p, c,
+            (unsigned long)msgs,
+            qstats_per_msg(s->enq_races, msgs), qstats_per_msg(s->deq_races, msgs),
+            qstats_per_msg(s->retries, msgs), qstats_per_msg(s->empty_pops, msgs),
+            qstats_per_msg(s->segments, msgs), s->sized ? (long)s->left : -1L,
+            qstats_per_msg(s->combines, msgs), qstats_per_msg(s->eliminated, msgs));
+}
+
+void qstats_record(result_t *res, const qstats_t *s, uint64_t msgs)
+{
+    if(!g_qstats)
+        return;
+
+    result_num(res, "qstat_enq_races_per_msg", qstats_per_msg(s->enq_races, msgs));
+    result_num(res, "qstat_deq_races_per_msg", qstats_per_msg(s->deq_races, msgs));
+    result_num(res, "qstat_retries_per_msg", qstats_per_msg(s->retries, msgs));
+    result_num(res, "qstat_empty_pops_per_msg", qstats_per_msg(s->empty_pops, msgs));
+    result_num(res, "qstat_segments_per_msg", qstats_per_msg(s->segments, msgs));
+    result_num(res, "qstat_combines_per_msg", qstats_per_msg(s->combines, msgs));
+    result_num(res, "qstat_eliminated_per_msg", qstats_per_msg(s->eliminated, msgs));
+
+    if(s->sized)
+        result_int(res, "qstat_left", s->left);
+}
@@ -0,0 +1,68 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __QSTATS_H__
+#define __QSTATS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "results.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What happened inside a queue (--queue-stats), so a slow queue shows */
+/* which of its steps the threads fought over:                         */
+/*                                                                     */
+/*   enq_races   failed CAS on the enqueue side                        */
+/*   deq_races   failed CAS on the dequeue side                        */
+/*   retries     other steps taken again:  a lagging tail fixed up, an */
+/*               inconsistent snapshot, a push found still in flight   */
+/*   empty_pops  dequeue calls that came back with nothing             */
+/*   segments    segments or blocks the queue allocated                */
+/*   left        items the queues' own item counters still held        */
+/*   combines    turns a flat combiner took (fcqueue), so a message    */
+/*               count over it is the operations per combine           */
+/*   eliminated  enqueues handed straight to a dequeue, by --eliminate */
+/*               or by an elimination stack (treiberelim)              */
+/*                                                                     */
+/* The libcds queues are rebuilt with their stat and item_counter      */
+/* policies and read once after the run.  The in-tree queues (natsys,  */
+/* cloudius, vyukov) count into the calling thread's t_qstats through */
+/* QSTAT, and the driver counts the empty pops for every queue.  The   */
+/* vendored folly, mc, tbb and boost queues have no hooks, so only     */
+/* their empty pops are seen.                                          */
+typedef struct qstats_t {
+    uint64_t enq_races;
+    uint64_t deq_races;
+    uint64_t retries;
+    uint64_t empty_pops;
+    uint64_t segments;
+    uint64_t left;
+    uint64_t combines;
+    uint64_t eliminated;
+    int      sized;             /* some queue had an item counter for left */
+} qstats_t;
+
+/* Set once from --queue-stats */
+extern int                g_qstats;
+/* The calling thread's counts, zeroed as its timed region starts */
+extern __thread qstats_t  t_qstats;
+
+/* An expression, so it also fits a loop condition */
+#define QSTAT(field) ((void)(g_qstats && ++t_qstats.field))
+
+extern void qstats_usage(FILE *out);
+/* Add s into sum */
+extern void qstats_sum(qstats_t *sum, const qstats_t *s);
+
+/* "Qstats: ..." and a QSTATOUT line, per message but for left */
+extern void qstats_print(FILE *out, int p, int c, const qstats_t *s,
+                         uint64_t msgs);
+/* qstat_<event>_per_msg fields and qstat_left */
+extern void qstats_record(result_t *res, const qstats_t *s, uint64_t msgs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __QSTATS_H__ */
@@ -0,0 +1,213 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __QUEUES_H__
+#define __QUEUES_H__
+
+/* ------------------------------------------------------------------- */
+/* Queue registry.  Every backend is compiled into the driver as a     */
+/* struct of static inline functions with the same shape:              */
+/*                                                                     */
+/*   Q_t, producer_token_t, consumer_token_t                           */
+/*   enum { mpmc };          1 when consumers may share a queue        */
+/*   enum { spsc };          1 when a queue takes one producer only    */
+/*   enum { bounded };       1 when try_enqueue refuses at the capacity */
+/*                           newQ was given; 0 when it never refuses   */
+/*                           and the driver counts -Q itself           */
+/*   static Q_t **Q;         one queue per consumer                    */
+/*   newQ(nconsumers, nproducers, nmessages)  construct one queue      */
+/*   thread_init(index)      called by every thread before it starts   */
+/*   enqueue(q, work), enqueue_tok(q, tok, work)                       */
+/*   try_enqueue(q, work)    enqueue, or false when the queue is full  */
+/*   enqueue_bulk(q, work, num), enqueue_bulk_tok(q, tok, work, num)   */
+/*   try_dequeue_bulk(q, head, num), try_dequeue_bulk_tok(...)         */
+/*                           store up to num nodes at &head, return n  */
+/*                                                                     */
+/* The by-value backends (--by-value) have the same shape but carry   */
+/* whole messages, value_node_t<N> from value_node.h, instead of node  */
+/* pointers.  N is fixed at compile time, so VALUE_QUEUE_LIST has one  */
+/* registry entry per backend and PAYLOAD_LIST size.                   */
+/*                                                                     */
+/* A queue that can put its consumer to sleep itself also specializes  */
+/* queue_wait (below) for --wait blocking, and one that keeps its own  */
+/* counters specializes queue_stats for --queue-stats.                 */
+/*                                                                     */
+/* The driver instantiates its thread functions once per backend, so   */
+/* the queue operations stay inlined in the hot loops and the -q       */
+/* selection only costs an indirect call when a thread starts.         */
+/*                                                                     */
+/* work_node_t must be defined before this header is included.         */
+/* ------------------------------------------------------------------- */
+#include <stdio.h>
+#include <string.h>
+#include "qstats.h"
+
+/* Blocking dequeue of up to num nodes, giving up after usec */
+template<class A>
+struct queue_wait {
+    enum { native = 0 };
+
+    static inline int dequeue(typename A::Q_t              &inQ,
+                              typename A::consumer_token_t &tok,
+                              work_node_t                 *&head,
+                              int                           num,
+                              long                          usec)
+    {
+        return 0;
+    }
+};
+
+/* Add the counters the queue keeps itself into s, after a run */
+template<class A>
+struct queue_stats {
+    static inline void read(typename A::Q_t &inQ, qstats_t *s) { }
+};
+
+#include "folly_q.h"
+#include "folly_pcq_q.h"
+#include "moody_camel_q.h"
+#include "moody_camel_blocking_q.h"
+#include "cloudius_q.h"
+#include "natsys_q.h"
+#include "vyukov_q.h"
+#include "tbb_q.h"
+#include "boost_q.h"
+#include "spsc_q.h"
+
+/*      -q name   adapter            description             */
+#define QUEUE_LIST(X)                                         \
+    X(folly,      folly_queue,       "Facebook Folly Queue")  \
+    X(mc,         moody_camel_queue, "Moody Camel Queue")     \
+    X(mcblock,    moody_camel_blocking_queue,                 \
+                                     "Moody Camel Blocking Queue") \
+    X(cloudius,   cloudius_queue,    "Cloudius Queue")        \
+    X(natsys,     natsys_queue,      "Natsys Queue")          \
+    X(vyukov,     vyukov_queue,      "Vyukov Queue")          \
+    X(tbb,        tbb_queue,         "Tbb Queue")             \
+    X(boost,      boost_queue,       "Boost Queue")           \
+    X(pcq,        folly_pcq_queue,   "Folly ProducerConsumerQueue") \
+    X(spsc,       spsc_queue,        "Cache Line SPSC Ring")
+
+/*      -q name   adapter                      description    */
+#define VALUE_QUEUE_LIST(X, N)                                \
+    X(folly,      folly_value_queue<N>,        "Facebook Folly Queue, by value", N) \
+    X(mc,         moody_camel_value_queue<N>,  "Moody Camel Queue, by value",    N) \
+    X(tbb,        tbb_value_queue<N>,          "Tbb Queue, by value",            N)
+
+/* Payload sizes the by-value backends are built for, in bytes */
+#define PAYLOAD_LIST(X)                                       \
+    X(8) X(16) X(32) X(64) X(128) X(256) X(512) X(1024) X(2048) X(4096)
+#define PAYLOAD_MAX 4096
+
+typedef struct queue_entry_t {
+    const char  *name;
+    const char  *description;
+    void       (*init)(int nconsumers);
+    void       (*create)(int index, int nconsumers, int nproducers, int nmessages);
+    void       (*destroy)(int nconsumers);
+    void       (*stats)(int nconsumers, qstats_t *s);
+    int          native_wait;       /* queue_wait<> is specialized */
+    int          mpmc;              /* consumers may share a queue */
+    int          spsc;              /* one producer per queue only */
+    int          payload;           /* by-value payload bytes, 0 for pointers */
+    void      *(*produce)(void *clientdata);
+    void      *(*consume)(void *clientdata);
+} queue_entry_t;
+
+/* Queues are constructed one at a time, so a driver can build each */
+/* one on the thread (and so the NUMA node) of the consumer that     */
+/* owns it instead of in main()                                      */
+template<class A>
+static void init_queues(int nconsumers)
+{
+    A::Q = new typename A::Q_t *[nconsumers]();
+}
+
+template<class A>
+static void create_queue(int index, int nconsumers, int nproducers, int nmessages)
+{
+    A::Q[index] = A::newQ(nconsumers, nproducers, nmessages);
+}
+
+/* Undo init_queues and create_queue between the runs of a sweep.    */
+/* Every newQ uses ::operator new plus placement new.                */
+template<class A>
+static void destroy_queues(int nconsumers)
+{
+    typedef typename A::Q_t Q_t;
+
+    for(int i = 0; i < nconsumers; i++) {
+        if(!A::Q[i])
+            continue;
+
+        A::Q[i]->~Q_t();
+        ::operator delete(A::Q[i]);
+    }
+
+    delete [] A::Q;
+    A::Q = NULL;
+}
+
+/* queue_stats of every queue, before destroy_queues */
+template<class A>
+static void stats_queues(int nconsumers, qstats_t *s)
+{
+    for(int i = 0; i < nconsumers; i++)
+        if(A::Q[i])
+            queue_stats<A>::read(*A::Q[i], s);
+}
+
+/* Expands to one registry entry per backend; the driver provides the */
+/* do_produce/do_consume templates                                    */
+#define QUEUE_ENTRY(name, adapter, description)                       \
+    { #name, description, init_queues<adapter>, create_queue<adapter>, \
+      destroy_queues<adapter>, stats_queues<adapter>,                \
+      queue_wait<adapter>::native,                                   \
+      adapter::mpmc, adapter::spsc, 0,                               \
+      do_produce<adapter>, do_consume<adapter> },
+
+#define VALUE_ENTRY(name, adapter, description, N)                    \
+    { #name, description, init_queues<adapter >, create_queue<adapter >, \
+      destroy_queues<adapter >, stats_queues<adapter >,              \
+      queue_wait<adapter >::native,                                  \
+      adapter::mpmc, adapter::spsc, N,                               \
+      do_produce<adapter >, do_consume<adapter > },
+
+#define VALUE_ENTRIES(N) VALUE_QUEUE_LIST(VALUE_ENTRY, N)
+
+static inline const queue_entry_t *queue_lookup(const queue_entry_t *table,
+                                                int                  n,
+                                                const char          *name)
+{
+    for(int i = 0; i < n; i++)
+        if(name && strcmp(table[i].name, name) == 0)
+            return &table[i];
+
+    return NULL;
+}
+
+/* The by-value entry for a name and payload size */
+static inline const queue_entry_t *value_queue_lookup(const queue_entry_t *table,
+                                                      int                  n,
+                                                      const char          *name,
+                                                      int                  payload)
+{
+    for(int i = 0; i < n; i++)
+        if(name && strcmp(table[i].name, name) == 0 &&
+           table[i].payload == payload)
+            return &table[i];
+
+    return NULL;
+}
+
+static inline void queue_usage(FILE                *out,
+                               const queue_entry_t *table,
+                               int                  n)
+{
+    fprintf(out, "        -q <queue> one of:");
+
+    for(int i = 0; i < n; i++)
+        fprintf(out, " %s", table[i].name);
+
+    fprintf(out, "\n");
+}
+
+#endif /* __QUEUES_H__ */
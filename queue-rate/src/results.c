@@ -0,0 +1,272 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "results.h"
+
+#define RESULT_MAX_FIELDS 128
+
+typedef enum field_type_t {
+    FIELD_STR,
+    FIELD_NUM,
+    FIELD_NUMS
+} field_type_t;
+
+typedef struct field_t {
+    char         *key;
+    field_type_t  type;
+    char         *str;      /* FIELD_STR, and FIELD_NUM already formatted */
+    double       *nums;     /* FIELD_NUMS                                  */
+    int           n;
+} field_t;
+
+struct result_t {
+    int     nfields;
+    field_t fields[RESULT_MAX_FIELDS];
+};
+
+static field_t *add(result_t *r, const char *key, field_type_t type)
+{
+    field_t *f;
+
+    if(r->nfields == RESULT_MAX_FIELDS)
+        return NULL;
+
+    f       = &r->fields[r->nfields++];
+    f->key  = strdup(key);
+    f->type = type;
+    f->str  = NULL;
+    f->nums = NULL;
+    f->n    = 0;
+    return f;
+}
+
+result_t *result_new(const char *driver)
+{
+    result_t *r = (result_t *)calloc(1, sizeof(result_t));
+
+    result_str(r, "driver", driver);
+    return r;
+}
+
+void result_free(result_t *r)
+{
+    int i;
+
+    for(i = 0; i < r->nfields; i++) {
+        free(r->fields[i].key);
+        free(r->fields[i].str);
+        free(r->fields[i].nums);
+    }
+
+    free(r);
+}
+
+void result_str(result_t *r, const char *key, const char *value)
+{
+    field_t *f = add(r, key, FIELD_STR);
+
+    if(f)
+        f->str = strdup(value ? value : "");
+}
+
+void result_int(result_t *r, const char *key, long value)
+{
+    field_t *f = add(r, key, FIELD_NUM);
+
+    if(f && asprintf(&f->str, "%ld", value) < 0)
+        f->str = NULL;
+}
+
+void result_num(result_t *r, const char *key, double value)
+{
+    field_t *f = add(r, key, FIELD_NUM);
+
+    /* No NaN or inf in JSON */
+    if(f && asprintf(&f->str, isfinite(value) ? "%.6g" : "null", value) < 0)
+        f->str = NULL;
+}
+
+void result_nums(result_t *r, const char *key, const double *values, int n)
+{
+    field_t *f = add(r, key, FIELD_NUMS);
+
+    if(f) {
+        f->nums = (double *)malloc(sizeof(double) * (n ? n : 1));
+        memcpy(f->nums, values, sizeof(double) * n);
+        f->n    = n;
+    }
+}
+
+static void cpu_model(char *buf, size_t len)
+{
+    char  line[512];
+    FILE *f = fopen("/proc/cpuinfo", "r");
+
+    snprintf(buf, len, "unknown");
+
+    if(!f)
+        return;
+
+    while(fgets(line, sizeof(line), f)) {
+        char *colon = strchr(line, ':');
+
+        if(strncmp(line, "model name", 10) == 0 && colon) {
+            colon += 2;
+            colon[strcspn(colon, "\n")] = '\0';
+            snprintf(buf, len, "%s", colon);
+            break;
+        }
+    }
+
+    fclose(f);
+}
+
+void result_host(result_t *r, hwloc_topology_t topo)
+{
+    char       buf[256];
+    time_t     now = time(NULL);
+    struct tm  tm;
+    int        l3  = hwloc_get_cache_type_depth(topo, 3, (hwloc_obj_cache_type_t)-1);
+
+    gethostname(buf, sizeof(buf));
+    buf[sizeof(buf)-1] = '\0';
+    result_str(r, "host", buf);
+
+    gmtime_r(&now, &tm);
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    result_str(r, "time", buf);
+
+    cpu_model(buf, sizeof(buf));
+    result_str(r, "cpu_model", buf);
+
+    result_int(r, "sockets",    hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_SOCKET));
+    result_int(r, "numa_nodes", hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_NUMANODE));
+    result_int(r, "l3_caches",  l3 < 0 ? 0 : hwloc_get_nbobjs_by_depth(topo, l3));
+    result_int(r, "cores",      hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_CORE));
+    result_int(r, "pus",        hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_PU));
+}
+
+static void json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+
+    for(; *s; s++) {
+        if(*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if((unsigned char)*s < 0x20)
+            fprintf(out, "\\u%04x", *s);
+        else
+            fputc(*s, out);
+    }
+
+    fputc('"', out);
+}
+
+static void write_json(FILE *out, const result_t *r)
+{
+    int i, j;
+
+    fputc('{', out);
+
+    for(i = 0; i < r->nfields; i++) {
+        const field_t *f = &r->fields[i];
+
+        if(i)
+            fputs(", ", out);
+
+        json_string(out, f->key);
+        fputs(": ", out);
+
+        switch(f->type) {
+            case FIELD_STR:
+                json_string(out, f->str);
+                break;
+
+            case FIELD_NUM:
+                fputs(f->str, out);
+                break;
+
+            case FIELD_NUMS:
+                fputc('[', out);
+
+                for(j = 0; j < f->n; j++)
+                    fprintf(out, isfinite(f->nums[j]) ? "%s%.6g" : "%snull",
+                            j ? ", " : "", f->nums[j]);
+
+                fputc(']', out);
+                break;
+        }
+    }
+
+    fputs("}\n", out);
+}
+
+/* Strings are quoted; arrays become one quoted ';' separated cell */
+static void write_csv(FILE *out, const result_t *r, int header)
+{
+    int i, j;
+
+    if(header)
+        for(i = 0; i < r->nfields; i++)
+            fprintf(out, "%s%s", r->fields[i].key,
+                    i == r->nfields-1 ? "\n" : ",");
+
+    for(i = 0; i < r->nfields; i++) {
+        const field_t *f = &r->fields[i];
+
+        switch(f->type) {
+            case FIELD_STR:
+                fputc('"', out);
+
+                for(j = 0; f->str[j]; j++) {
+                    if(f->str[j] == '"')
+                        fputc('"', out);
+
+                    fputc(f->str[j], out);
+                }
+
+                fputc('"', out);
+                break;
+
+            case FIELD_NUM:
+                fputs(f->str, out);
+                break;
+
+            case FIELD_NUMS:
+                fputc('"', out);
+
+                for(j = 0; j < f->n; j++)
+                    fprintf(out, "%s%.6g", j ? ";" : "", f->nums[j]);
+
+                fputc('"', out);
+                break;
+        }
+
+        fputc(i == r->nfields-1 ? '\n' : ',', out);
+    }
+}
+
+int result_write(const result_t *r, const char *path, result_format_t format)
+{
+    FILE *out = fopen(path, "a");
+
+    if(!out) {
+        perror(path);
+        return -1;
+    }
+
+    if(format == RESULT_CSV) {
+        fseek(out, 0, SEEK_END);
+        write_csv(out, r, ftell(out) == 0);
+    } else
+        write_json(out, r);
+
+    return fclose(out);
+}
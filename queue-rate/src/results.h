@@ -0,0 +1,46 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __RESULTS_H__
+#define __RESULTS_H__
+
+#include <hwloc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One record per run, written as a JSON line or a CSV row.  Fields   */
+/* keep the order they were added in, so CSV columns are stable for a */
+/* given driver and set of options; the header is written whenever    */
+/* the file is empty.                                                 */
+/*                                                                    */
+/*     result_t *r = result_new("qrate");                             */
+/*     result_str(r, "queue", "mc");                                  */
+/*     result_num(r, "mmsgs_per_sec", rate);                          */
+/*     result_host(r, g_topo);                                        */
+/*     result_write(r, path, RESULT_JSON);                            */
+/*     result_free(r);                                                */
+typedef enum result_format_t {
+    RESULT_JSON,
+    RESULT_CSV
+} result_format_t;
+
+typedef struct result_t result_t;
+
+extern result_t *result_new(const char *driver);
+extern void      result_free(result_t *r);
+extern void      result_str(result_t *r, const char *key, const char *value);
+extern void      result_int(result_t *r, const char *key, long value);
+extern void      result_num(result_t *r, const char *key, double value);
+extern void      result_nums(result_t *r, const char *key,
+                             const double *values, int n);
+/* Host name, time stamp, CPU model and an hwloc topology summary */
+extern void      result_host(result_t *r, hwloc_topology_t topo);
+/* Append the record to path; returns 0 on success */
+extern int       result_write(const result_t *r, const char *path,
+                              result_format_t format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RESULTS_H__ */
@@ -0,0 +1,59 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Seeded random numbers (--seed).  Every thread draws from its own    */
+/* xorshift64* stream, derived from the run's seed and the thread's    */
+/* role and index, so a run can be replayed exactly by passing the     */
+/* seed it printed, and a draw costs a few instructions instead of a   */
+/* read() of /dev/urandom.                                              */
+
+/* The run's seed, from --seed or drawn once from /dev/urandom */
+extern uint64_t g_seed;
+
+/* splitmix64, to spread seeds that differ in a few bits */
+static inline uint64_t rng_mix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x  = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x  = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/* State for thread index of role (0 producer, 1 consumer, ...) */
+static inline uint64_t rng_seed(uint64_t seed, int role, int index)
+{
+    uint64_t s = rng_mix(seed ^ rng_mix(((uint64_t)role << 32) | (uint32_t)index));
+
+    return s ? s : 1;   /* xorshift never leaves 0 */
+}
+
+/* xorshift64* */
+static inline uint64_t rng_next(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform in [0, n), by multiply and shift rather than a division */
+static inline uint32_t rng_below(uint64_t *state, uint32_t n)
+{
+    return (uint32_t)(((rng_next(state) >> 32) * (uint64_t)n) >> 32);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RNG_H__ */
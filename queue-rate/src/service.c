@@ -0,0 +1,56 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <stdlib.h>
+#include <string.h>
+#include "service.h"
+
+static const char *g_service_names[SERVICE_COUNT] = {
+    "none", "fixed", "exp", "touch"
+};
+
+int service_parse(const char *spec, service_t *s)
+{
+    const char *colon = strchr(spec, ':');
+    size_t      len   = colon ? (size_t)(colon - spec) : strlen(spec);
+    char       *end;
+    int         i;
+
+    for(i = 0; i < SERVICE_COUNT; i++)
+        if(strlen(g_service_names[i]) == len &&
+           strncmp(g_service_names[i], spec, len) == 0)
+            break;
+
+    if(i == SERVICE_COUNT)
+        return -1;
+
+    s->kind = i;
+    s->arg  = 0;
+
+    /* none takes no argument, the others need a positive one */
+    if(i == SERVICE_NONE)
+        return colon ? -1 : 0;
+
+    if(!colon)
+        return -1;
+
+    s->arg = strtoull(colon+1, &end, 10);
+
+    return (*end || s->arg == 0) ? -1 : 0;
+}
+
+const char *service_name(const service_t *s, char *buf, size_t len)
+{
+    if(s->kind == SERVICE_NONE)
+        snprintf(buf, len, "%s", g_service_names[s->kind]);
+    else
+        snprintf(buf, len, "%s:%llu", g_service_names[s->kind],
+                 (unsigned long long)s->arg);
+
+    return buf;
+}
+
+void service_usage(FILE *out)
+{
+    fprintf(out, "        --work <model>, --produce-work <model> per message work of consumers\n");
+    fprintf(out, "              and producers: none, fixed:<cycles>, exp:<mean cycles>,\n");
+    fprintf(out, "              touch:<cache lines of payload>\n");
+}
@@ -0,0 +1,91 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __SERVICE_H__
+#define __SERVICE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include "timing.h"
+#include "rng.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Synthetic per-message work (--work, --produce-work), so a queue is  */
+/* measured at the utilization a real service would give it instead of */
+/* with threads that do nothing but enqueue and dequeue.  A model is   */
+/* written <kind>:<arg>:                                                */
+/*                                                                      */
+/*   none          no work, the original behaviour                      */
+/*   fixed:<c>     spin c TSC cycles per message                        */
+/*   exp:<c>       spin an exponentially distributed time, mean c       */
+/*                 cycles, so service times vary as in an M/M/c queue   */
+/*   touch:<n>     read-modify-write one word in each of the first n    */
+/*                 cache lines of the payload (needs --payload >= 64n), */
+/*                 which moves those lines into this core's cache       */
+typedef enum service_kind_t {
+    SERVICE_NONE,
+    SERVICE_FIXED,
+    SERVICE_EXP,
+    SERVICE_TOUCH,
+    SERVICE_COUNT
+} service_kind_t;
+
+#define SERVICE_LINE 64
+
+typedef struct service_t {
+    int      kind;
+    uint64_t arg;       /* cycles, mean cycles or cache lines */
+} service_t;
+
+/* Parse <kind>[:<arg>] into *s, -1 when it is not a model */
+extern int         service_parse(const char *spec, service_t *s);
+/* "kind:arg" for reports, written to buf */
+extern const char *service_name(const service_t *s, char *buf, size_t len);
+extern void        service_usage(FILE *out);
+
+static inline void service_spin(uint64_t cycles)
+{
+    uint64_t end = rdtsc() + cycles;
+
+    while(rdtsc() < end)
+        __asm__ __volatile__("pause" ::: "memory");
+}
+
+/* Serve one message whose payload starts at payload; returns the      */
+/* cycles it was meant to take (0 for touch, which is not timed).      */
+/* state is the thread's rng.h stream, for the exponential draws       */
+static inline uint64_t service_run(const service_t *s, void *payload,
+                                   uint64_t *state)
+{
+    uint64_t cycles, i;
+
+    switch(s->kind) {
+        case SERVICE_FIXED:
+            service_spin(s->arg);
+            return s->arg;
+
+        case SERVICE_EXP:
+            /* Top 53 bits as a double in (0, 1] */
+            cycles = (uint64_t)(-(double)s->arg *
+                                log(((rng_next(state) >> 11) + 1) / 9007199254740992.0));
+            service_spin(cycles);
+            return cycles;
+
+        case SERVICE_TOUCH:
+            for(i = 0; i < s->arg; i++)
+                ((volatile uint64_t *)payload)[i * SERVICE_LINE/8]++;
+
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SERVICE_H__ */
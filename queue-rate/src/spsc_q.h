@@ -0,0 +1,201 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __SPSC_Q_H__
+#define __SPSC_Q_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "backoff.h"
+
+/* ------------------------------------------------------------------- */
+/* Single producer, single consumer ring after MCRingBuffer.  Each     */
+/* side keeps a private copy of the other side's index and rereads the */
+/* shared one only when its copy says the ring is full (empty), and    */
+/* the producer publishes its index once per cache line of slots       */
+/* instead of once per message.  The consumer publishes once per       */
+/* dequeue call, however many nodes it took.                           */
+/*                                                                     */
+/* enqueue_tok and enqueue_bulk_tok leave a partly filled line         */
+/* unpublished until it fills; enqueue and enqueue_bulk publish at     */
+/* once, so sentinels and ping-pong messages are never held back.      */
+/* ------------------------------------------------------------------- */
+#define SPSC_LINE       (64/sizeof(work_node_t *))
+#define SPSC_MAX_SLOTS  (1UL<<20)
+
+struct spsc_ring_t {
+    /* Shared:  each written by one side and read by the other */
+    uint64_t      head __attribute__((aligned(64)));  /* published writes */
+    uint64_t      tail __attribute__((aligned(64)));  /* published reads  */
+    /* Producer only */
+    uint64_t      write __attribute__((aligned(64)));
+    uint64_t      tail_cache;
+    /* Consumer only */
+    uint64_t      read __attribute__((aligned(64)));
+    uint64_t      head_cache;
+    /* Read only */
+    uint64_t      mask __attribute__((aligned(64)));
+    uint64_t      limit;        /* nodes the ring holds at most */
+    work_node_t **slots;
+
+    /* Room for nmessages plus a line, as a power of two, but full at */
+    /* nmessages so -Q gets the capacity it asked for                 */
+    spsc_ring_t(int nmessages)
+        : head(0), tail(0), write(0), tail_cache(0), read(0), head_cache(0)
+    {
+        uint64_t n = 2*SPSC_LINE;
+
+        while(n < (uint64_t)nmessages + SPSC_LINE && n < SPSC_MAX_SLOTS)
+            n <<= 1;
+
+        mask  = n-1;
+        limit = (uint64_t)nmessages < n ? (uint64_t)nmessages : n;
+        slots = (work_node_t **)calloc(n, sizeof(work_node_t *));
+    }
+
+    ~spsc_ring_t()
+    {
+        free(slots);
+    }
+};
+
+static inline void spsc_publish(spsc_ring_t *r)
+{
+    __atomic_store_n(&r->head, r->write, __ATOMIC_RELEASE);
+}
+
+static inline void spsc_push(spsc_ring_t *r, work_node_t *n, int publish)
+{
+    unsigned fails = 0;
+
+    while(r->write - r->tail_cache >= r->limit) {
+        r->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+        if(r->write - r->tail_cache < r->limit)
+            break;
+
+        /* The consumer only drains what it can see */
+        spsc_publish(r);
+        backoff(BACKOFF_PAUSE, &fails);
+    }
+
+    r->slots[r->write & r->mask] = n;
+    r->write++;
+
+    if(publish || (r->write & (SPSC_LINE-1)) == 0)
+        spsc_publish(r);
+}
+
+/* One node, published at once; 0 when the ring is full */
+static inline int spsc_try_push(spsc_ring_t *r, work_node_t *n)
+{
+    if(r->write - r->tail_cache >= r->limit) {
+        r->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+        if(r->write - r->tail_cache >= r->limit) {
+            spsc_publish(r);
+            return 0;
+        }
+    }
+
+    r->slots[r->write & r->mask] = n;
+    r->write++;
+    spsc_publish(r);
+    return 1;
+}
+
+static inline int spsc_pop_bulk(spsc_ring_t *r, work_node_t **out, int num)
+{
+    uint64_t avail = r->head_cache - r->read;
+    int      i;
+
+    if(avail == 0) {
+        r->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        avail         = r->head_cache - r->read;
+
+        if(avail == 0)
+            return 0;
+    }
+
+    if(avail > (uint64_t)num)
+        avail = num;
+
+    for(i = 0; i < (int)avail; i++)
+        out[i] = r->slots[(r->read + i) & r->mask];
+
+    r->read += avail;
+    __atomic_store_n(&r->tail, r->read, __ATOMIC_RELEASE);
+    return avail;
+}
+
+struct spsc_queue {
+    typedef spsc_ring_t Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 0 };      /* one consumer per queue */
+    enum { spsc = 1 };      /* and one producer:  --topology pairs */
+    enum { bounded = 1 };   /* try_enqueue refuses at capacity (-Q) */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t(nmessages);
+        return q;
+    }
+
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        spsc_push(&inQ, &work, 0);
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
+                               work_node_t            &work)
+    {
+        spsc_push(&inQ, &work, 1);
+    }
+
+    /* -Q:  false when the queue is at the capacity it was built with */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        return spsc_try_push(&inQ, &work);
+    }
+
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            spsc_push(&inQ, work[i], i == num-1);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            spsc_push(&inQ, work[i], 0);
+    }
+
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        return spsc_pop_bulk(&inQ, &head, num);
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return spsc_pop_bulk(&inQ, &head, num);
+    }
+};
+spsc_queue::Q_t **spsc_queue::Q;
+
+#endif /* __SPSC_Q_H__ */
@@ -0,0 +1,40 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+void stats_median_ci(const double *samples, int n,
+                     double *median, double *lo, double *hi)
+{
+    double *x;
+    int     k;
+
+    if(n < 1) {
+        *median = *lo = *hi = NAN;
+        return;
+    }
+
+    x = (double *)malloc(sizeof(double) * n);
+    memcpy(x, samples, sizeof(double) * n);
+    qsort(x, n, sizeof(double), cmp_double);
+
+    *median = n & 1 ? x[n/2] : (x[n/2-1] + x[n/2]) / 2.0;
+
+    /* Binomial(n, 1/2) normal approximation, 0-based lower rank */
+    k = (int)floor((n - 1.96*sqrt(n)) / 2.0);
+
+    if(k < 0)
+        k = 0;
+
+    *lo = x[k];
+    *hi = x[n-1-k];
+    free(x);
+}
@@ -0,0 +1,19 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Median of n samples with a distribution-free 95% confidence interval: */
+/* the order statistics at ranks n/2 -+ 0.98*sqrt(n), which is min..max  */
+/* up to seven samples.  With no samples every output is NaN.            */
+extern void stats_median_ci(const double *samples, int n,
+                            double *median, double *lo, double *hi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_H__ */
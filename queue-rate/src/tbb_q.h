@@ -3,57 +3,165 @@
 #define __TBB_Q_H__
 
 #include "concurrentqueue/benchmarks/tbb/concurrent_queue.h" /* TBB queue */
-#define QUEUE_NAME "Tbb Queue"
-typedef tbb::concurrent_queue<work_node_t *> Q_t;
-class token_t { public: token_t(Q_t &q) {} };
-typedef token_t producer_token_t;
-typedef token_t consumer_token_t;
-Q_t *Q;
-Q_t *initQ(int nconsumers, int nproducers, int nmessages)
-{
-    Q_t *arr = static_cast<Q_t *>(::operator new[](nconsumers*sizeof(Q_t)));
+#include "value_node.h"
+struct tbb_queue {
+    typedef tbb::concurrent_queue<work_node_t *> Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 1 };      /* several consumers may share one queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    enum { bounded = 0 };   /* -Q is counted by the driver */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t();
+        return q;
+    }
+
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        inQ.push(&work);
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
+                               work_node_t            &work)
+    {
+        inQ.push(&work);
+    }
+
+    /* Never refuses:  the driver keeps -Q for this queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+        return true;
+    }
+
+    /* concurrent_queue has no batched push */
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            inQ.push(work[i]);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    /* concurrent_queue has no batched pop:  drain item by item up to num */
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        work_node_t **out = &head;
+        int           n   = 0;
+
+        while(n < num && inQ.try_pop(out[n]))
+            n++;
+
+        return n;
+    }
 
-    for(int i = 0; i < nconsumers; i++) {
-        ::new(arr+i) Q_t();
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
     }
+};
+tbb_queue::Q_t **tbb_queue::Q;
 
-    return arr;
-}
+/* By value (--by-value):  the queue copies whole messages */
+template<int N>
+struct tbb_value_queue {
+    typedef tbb::concurrent_queue<value_node_t<N> > Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 1 };
+    enum { spsc = 0 };
+    enum { bounded = 0 };   /* -Q is counted by the driver */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t();
+        return q;
+    }
+
+    static inline void thread_init(int index) { value_buffer<N>::init(); }
 
-static inline void enqueue_tok(Q_t                    &inQ,
-                               const producer_token_t &token,
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+    }
+
+    static inline void enqueue(Q_t                    &inQ,
                                work_node_t            &work)
-{
-    inQ.push(&work);
-}
-
-static inline void enqueue(Q_t                    &inQ,
-                           work_node_t            &work)
-{
-    inQ.push(&work);
-}
-
-static inline int try_dequeue_bulk(Q_t                     &inQ,
-                                   work_node_t            *&head,
-                                   int                     num)
-{
-    bool good;
-    good = inQ.try_pop(head);
-
-    if(good) return 1;
-    else return 0;
-}
-
-static inline int try_dequeue_bulk_tok(Q_t               &inQ,
-                                       consumer_token_t  &tok,
-                                       work_node_t      *&head,
-                                       int                num)
-{
-    bool good;
-    good = inQ.try_pop(head);
-
-    if(good) return 1;
-    else return 0;
-}
+    {
+        inQ.push(*reinterpret_cast<value_node_t<N> *>(&work));
+    }
+
+    /* Never refuses:  the driver keeps -Q for this queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+        return true;
+    }
+
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        for(int i = 0; i < num; i++)
+            enqueue(inQ, *work[i]);
+    }
+
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
+
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        value_node_t<N> *buf = value_buffer<N>::buf;
+        int              n   = 0;
+
+        while(n < num && n < VALUE_BULK && inQ.try_pop(buf[n]))
+            n++;
+
+        return value_buffer<N>::hand_out(head, n);
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
+    }
+};
+template<int N> typename tbb_value_queue<N>::Q_t **tbb_value_queue<N>::Q;
 
 #endif /* __TBB_Q_H__ */
@@ -0,0 +1,85 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#include <time.h>
+#include "timing.h"
+
+#define CALIBRATE_NSEC 50000000L
+
+static inline uint64_t monotonic_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000UL + ts.tv_nsec;
+}
+
+double tsc_calibrate(void)
+{
+    uint64_t t0, tf, c0, cf;
+
+    t0 = monotonic_nsec();
+    c0 = rdtsc();
+
+    do {
+        tf = monotonic_nsec();
+    } while(tf - t0 < CALIBRATE_NSEC);
+
+    cf = rdtsc();
+    return (double)(cf - c0) / (double)(tf - t0);
+}
+
+void phase_summarize(phase_summary_t *sum,
+                     const phase_t   *prod, int nproducers,
+                     const phase_t   *cons, int nconsumers)
+{
+    uint64_t first = UINT64_MAX, last_start = 0, last = 0;
+    uint64_t pbusy = 0, pmsgs = 0, cbusy = 0, cempty = 0, cmsgs = 0;
+    int      i;
+
+    for(i = 0; i < nproducers + nconsumers; i++) {
+        const phase_t *p = i < nproducers ? &prod[i] : &cons[i-nproducers];
+
+        if(p->start < first)      first      = p->start;
+
+        if(p->start > last_start) last_start = p->start;
+
+        if(p->stop > last)        last       = p->stop;
+
+        if(i < nproducers) {
+            pbusy  += p->busy;
+            pmsgs  += p->msgs;
+        } else {
+            cbusy  += p->busy;
+            cempty += p->empty;
+            cmsgs  += p->msgs;
+        }
+    }
+
+    sum->window    = last - first;
+    sum->skew      = last_start - first;
+    sum->prod_cpm  = pmsgs ? (double)pbusy / pmsgs : 0.0;
+    sum->cons_cpm  = cmsgs ? (double)cbusy / cmsgs : 0.0;
+    sum->empty_pct = cbusy + cempty ? 100.0 * cempty / (cbusy + cempty) : 0.0;
+}
+
+void phase_print(FILE *out, const phase_summary_t *sum,
+                 int nproducers, int nconsumers, long nmessages,
+                 double tsc_per_nsec)
+{
+    /* Messages per microsecond each role could sustain if the other */
+    /* side never made it wait                                       */
+    double pcap = sum->prod_cpm > 0.0 ?
+                  nproducers * tsc_per_nsec * 1000.0 / sum->prod_cpm : 0.0;
+    double ccap = sum->cons_cpm > 0.0 ?
+                  nconsumers * tsc_per_nsec * 1000.0 / sum->cons_cpm : 0.0;
+
+    fprintf(out, "Cycles: window=%lu skew=%lu (%.0f nsec) producer cyc/msg=%.1f "
+            "consumer cyc/msg=%.1f empty=%.1f%%\n",
+            (unsigned long)sum->window, (unsigned long)sum->skew,
+            sum->skew / tsc_per_nsec, sum->prod_cpm, sum->cons_cpm,
+            sum->empty_pct);
+    fprintf(out, "Capacity (mmsgs/s): producers=%f consumers=%f bottleneck=%s\n",
+            pcap, ccap, pcap < ccap ? "producers" : "consumers");
+    fprintf(out, "CYCOUT %d %d %ld %f %f %f %f\n",
+            nproducers, nconsumers, nmessages,
+            sum->prod_cpm, sum->cons_cpm, sum->empty_pct,
+            sum->skew / tsc_per_nsec);
+}
@@ -0,0 +1,57 @@
+// -*- mode: c; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Raw time stamp counter.  Assumes an invariant TSC that is synchronized */
+/* across cores, so stamps taken on a producer can be compared with      */
+/* stamps taken on a consumer.                                            */
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Measure TSC ticks per nanosecond against CLOCK_MONOTONIC */
+extern double tsc_calibrate(void);
+
+/* Per-thread cycle accounting.  Every thread stamps start as it leaves */
+/* the last start barrier and stop when its own work is over, so the    */
+/* run window no longer includes the wake-up of the main thread.        */
+/* Counters are kept in locals by the hot loops and stored once.        */
+typedef struct phase_t {
+    uint64_t start;     /* left the start barrier                       */
+    uint64_t stop;      /* finished producing/consuming                 */
+    uint64_t busy;      /* cycles in calls that moved messages          */
+    uint64_t empty;     /* cycles in dequeue calls that found nothing   */
+    uint64_t msgs;      /* messages moved by this thread                */
+} phase_t;
+
+typedef struct phase_summary_t {
+    uint64_t window;    /* first start to last stop                     */
+    uint64_t skew;      /* spread of the start stamps (barrier skew)    */
+    double   prod_cpm;  /* producer busy cycles per message             */
+    double   cons_cpm;  /* consumer busy cycles per message             */
+    double   empty_pct; /* share of consumer cycles spent polling empty */
+} phase_summary_t;
+
+extern void phase_summarize(phase_summary_t *sum,
+                            const phase_t   *prod, int nproducers,
+                            const phase_t   *cons, int nconsumers);
+/* Human readable breakdown plus a CYCOUT line for the plot scripts */
+extern void phase_print(FILE *out, const phase_summary_t *sum,
+                        int nproducers, int nconsumers, long nmessages,
+                        double tsc_per_nsec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TIMING_H__ */
@@ -0,0 +1,67 @@
+// -*- mode: c++; c-basic-offset:4 ; indent-tabs-mode:nil ; -*-
+#ifndef __VALUE_NODE_H__
+#define __VALUE_NODE_H__
+
+#include <stdlib.h>
+
+/* ------------------------------------------------------------------- */
+/* By-value transport (--by-value).  The queue's element is the whole  */
+/* message, a work_node_t header and its N payload bytes, so enqueue   */
+/* copies it into the queue and dequeue copies it out again:  nothing  */
+/* is shared with the producer once the enqueue returns.               */
+/*                                                                     */
+/* A driver lays its nodes out the same way, payload right after the   */
+/* header, so a node can be read as a value_node_t<N> in place.        */
+/* Dequeued copies land in a per-thread buffer of VALUE_BULK messages  */
+/* and the driver gets pointers into it, valid until its next dequeue. */
+/* ------------------------------------------------------------------- */
+#define VALUE_BULK      256
+
+template<int N>
+struct value_node_t {
+    work_node_t node;
+    char        payload[N];
+};
+
+/* Where a thread's dequeued copies go */
+template<int N>
+struct value_buffer {
+    static __thread value_node_t<N> *buf;
+
+    static inline void init()
+    {
+        if(!buf)
+            buf = (value_node_t<N> *)malloc(sizeof(value_node_t<N>) * VALUE_BULK);
+    }
+
+    /* Pointers to the first n copies, for the driver */
+    static inline int hand_out(work_node_t *&head, int n)
+    {
+        work_node_t **out = &head;
+
+        for(int i = 0; i < n; i++)
+            out[i] = &buf[i].node;
+
+        return n;
+    }
+};
+template<int N> __thread value_node_t<N> *value_buffer<N>::buf;
+
+/* Walks an array of node pointers as the values they point to, for */
+/* the queues' bulk enqueues                                         */
+template<int N>
+struct value_iter {
+    work_node_t **p;
+
+    value_iter(work_node_t **work) : p(work) { }
+
+    const value_node_t<N> &operator*() const
+    {
+        return *reinterpret_cast<const value_node_t<N> *>(*p);
+    }
+
+    value_iter &operator++()    { ++p; return *this; }
+    value_iter  operator++(int) { value_iter it = *this; ++p; return it; }
+};
+
+#endif /* __VALUE_NODE_H__ */
@@ -2,8 +2,6 @@
 #ifndef __VYUKOV_Q_H__
 #define __VYUKOV_Q_H__
 
-#define QUEUE_NAME "Vyukov Queue"
-
 typedef union mpsc_node_t {
     mpsc_node_t   *volatile next;
     work_node_t  wn;
@@ -31,6 +29,20 @@ void mpscq_push(mpscq_t *self, work_node_t *in_n)
     prev->next = n;
 }
 
+/* Link the batch privately, then splice it in with one exchange */
+void mpscq_push_bulk(mpscq_t *self, work_node_t **in_n, int num)
+{
+    mpsc_node_t *first = (mpsc_node_t *)in_n[0];
+    mpsc_node_t *last  = (mpsc_node_t *)in_n[num-1];
+
+    for(int i = 0; i < num-1; i++)
+        ((mpsc_node_t *)in_n[i])->next = (mpsc_node_t *)in_n[i+1];
+
+    last->next = 0;
+    mpsc_node_t *prev = __sync_lock_test_and_set(&self->head, last);
+    prev->next = first;
+}
+
 work_node_t *mpscq_pop(mpscq_t *self)
 {
     mpsc_node_t *tail = self->tail;
@@ -52,8 +64,11 @@ work_node_t *mpscq_pop(mpscq_t *self)
 
     mpsc_node_t *head = self->head;
 
-    if(tail != head)
+    /* A producer has swapped head but not linked its node yet */
+    if(tail != head) {
+        QSTAT(retries);
         return 0;
+    }
 
     mpscq_push(self, &self->stub.wn);
     next = tail->next;
@@ -66,55 +81,83 @@ work_node_t *mpscq_pop(mpscq_t *self)
     return 0;
 }
 
-typedef struct mpscq_t Q_t;
-class token_t { public: token_t(Q_t &q) {} };
-typedef token_t producer_token_t;
-typedef token_t consumer_token_t;
-Q_t *Q;
-Q_t *initQ(int nconsumers, int nproducers, int nmessages)
-{
-    Q_t *arr = static_cast<Q_t *>(::operator new[](nconsumers*sizeof(Q_t)));
-
-    for(int i = 0; i < nconsumers; i++) {
-        ::new(arr+i) Q_t();
-        mpscq_create(arr+i);
+struct vyukov_queue {
+    typedef struct mpscq_t Q_t;
+    class token_t { public: token_t(Q_t &q) {} };
+    typedef token_t producer_token_t;
+    typedef token_t consumer_token_t;
+    enum { mpmc = 0 };      /* one consumer per queue */
+    enum { spsc = 0 };      /* any number of producers per queue */
+    enum { bounded = 0 };   /* -Q is counted by the driver */
+    static Q_t **Q;
+    static Q_t *newQ(int nconsumers, int nproducers, int nmessages)
+    {
+        Q_t *q = static_cast<Q_t *>(::operator new(sizeof(Q_t)));
+        ::new(q) Q_t();
+        mpscq_create(q);
+        return q;
     }
 
-    return arr;
-}
+    static inline void thread_init(int index) { }
+
+    static inline void enqueue_tok(Q_t                    &inQ,
+                                   const producer_token_t &token,
+                                   work_node_t            &work)
+    {
+        mpscq_push(&inQ,&work);
+    }
 
-static inline void enqueue_tok(Q_t                    &inQ,
-                               const producer_token_t &token,
+    static inline void enqueue(Q_t                    &inQ,
                                work_node_t            &work)
-{
-    mpscq_push(&inQ,&work);
-}
+    {
+        mpscq_push(&inQ,&work);
+    }
 
-static inline void enqueue(Q_t                    &inQ,
-                           work_node_t            &work)
-{
-    mpscq_push(&inQ,&work);
-}
+    /* Never refuses:  the driver keeps -Q for this queue */
+    static inline bool try_enqueue(Q_t                    &inQ,
+                                   work_node_t            &work)
+    {
+        enqueue(inQ, work);
+        return true;
+    }
 
-static inline int try_dequeue_bulk(Q_t                     &inQ,
-                                   work_node_t            *&head,
-                                   int                     num)
-{
-    head = mpscq_pop(&inQ);
+    static inline void enqueue_bulk(Q_t                    &inQ,
+                                    work_node_t           **work,
+                                    int                     num)
+    {
+        mpscq_push_bulk(&inQ, work, num);
+    }
 
-    if(head) return 1;
-    else return 0;
-}
+    static inline void enqueue_bulk_tok(Q_t                    &inQ,
+                                        const producer_token_t &token,
+                                        work_node_t           **work,
+                                        int                     num)
+    {
+        enqueue_bulk(inQ, work, num);
+    }
 
-static inline int try_dequeue_bulk_tok(Q_t               &inQ,
-                                       consumer_token_t  &tok,
-                                       work_node_t      *&head,
-                                       int                num)
-{
-    head = mpscq_pop(&inQ);
+    /* Walk the list until it is empty or num nodes have been taken */
+    static inline int try_dequeue_bulk(Q_t                     &inQ,
+                                       work_node_t            *&head,
+                                       int                     num)
+    {
+        work_node_t **out = &head;
+        int           n   = 0;
 
-    if(head) return 1;
-    else return 0;
-}
+        while(n < num && (out[n] = mpscq_pop(&inQ)) != NULL)
+            n++;
+
+        return n;
+    }
+
+    static inline int try_dequeue_bulk_tok(Q_t               &inQ,
+                                           consumer_token_t  &tok,
+                                           work_node_t      *&head,
+                                           int                num)
+    {
+        return try_dequeue_bulk(inQ, head, num);
+    }
+};
+vyukov_queue::Q_t **vyukov_queue::Q;
 
 #endif /* __VYUKOV_Q_H__ */